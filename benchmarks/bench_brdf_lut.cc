@@ -0,0 +1,106 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <clean-core/alloc_array.hh>
+#include <clean-core/utility.hh>
+#include <clean-core/vector.hh>
+
+#include <phantasm-renderer/Context.hh>
+#include <phantasm-renderer/Frame.hh>
+
+#include <arcana-incubator/asset-loading/brdf_lut.hh>
+#include <arcana-incubator/asset-loading/pixel_convert.hh>
+#include <arcana-incubator/device-abstraction/timer.hh>
+#include <arcana-incubator/pr-util/ibl_cache.hh>
+#include <arcana-incubator/pr-util/texture_processing.hh>
+
+// the CPU BRDF LUT (assets::compute_brdf_lut) against the brdf_lut_gen shader, both rg16f
+// fails if any texel differs by more than the tolerance, both integrate the same Hammersley samples,
+// differences come from float (shader) against double (CPU) math and the float16 rounding of either result
+// runs headless, for a software device point the Vulkan loader at lavapipe (ie. VK_ICD_FILENAMES=.../lvp_icd.x86_64.json)
+// usage: bench_brdf_lut <shader path prefix> [vulkan|d3d12] [tolerance]
+namespace
+{
+constexpr int gc_width_height = 256;
+constexpr float gc_default_tolerance = 4e-3f;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "usage: %s <shader path prefix> [vulkan|d3d12] [tolerance]\n", argv[0]);
+        return 1;
+    }
+
+    bool const use_d3d12 = argc > 2 && argv[2][0] == 'd';
+    float const tolerance = argc > 3 ? float(std::atof(argv[3])) : gc_default_tolerance;
+
+    inc::da::Timer timer;
+    auto const cpu_lut = inc::assets::compute_brdf_lut(gc_width_height, gc_width_height);
+    double const cpu_ms = timer.elapsedMillisecondsD();
+
+    pr::Context ctx;
+    ctx.initialize(use_d3d12 ? pr::backend::d3d12 : pr::backend::vulkan);
+
+    int res = 0;
+    {
+        inc::pre::texture_processing tex;
+        tex.init(ctx, argv[1]);
+
+        pr::auto_texture gpu_lut;
+        {
+            auto frame = ctx.make_frame();
+            gpu_lut = tex.create_brdf_lut(frame, gc_width_height, gc_width_height);
+            ctx.submit(cc::move(frame));
+        }
+
+        inc::pre::cooked_texture_header header;
+        cc::vector<std::byte> gpu_texels;
+        (void)inc::pre::read_back_cooked_texture(ctx, gpu_lut, header, gpu_texels);
+
+        size_t const num_values = cpu_lut.texels.size();
+        if (gpu_texels.size() != num_values * sizeof(uint16_t))
+        {
+            std::fprintf(stderr, "GPU LUT has an unexpected size (%zu bytes), is it rg16f?\n", gpu_texels.size());
+            res = 1;
+        }
+        else
+        {
+            auto gpu_halfs = cc::alloc_array<uint16_t>::uninitialized(num_values);
+            std::memcpy(gpu_halfs.data(), gpu_texels.data(), gpu_texels.size());
+
+            auto cpu_values = cc::alloc_array<float>::uninitialized(num_values);
+            auto gpu_values = cc::alloc_array<float>::uninitialized(num_values);
+            inc::assets::convert_half_to_float(cpu_lut.texels.data(), cpu_values.data(), num_values);
+            inc::assets::convert_half_to_float(gpu_halfs.data(), gpu_values.data(), num_values);
+
+            float max_error[2] = {0.f, 0.f};
+            double sum_error[2] = {0.0, 0.0};
+            for (size_t i = 0; i < num_values; ++i)
+            {
+                float const error = std::abs(cpu_values[i] - gpu_values[i]);
+                max_error[i % 2] = cc::max(max_error[i % 2], error);
+                sum_error[i % 2] += error;
+            }
+
+            double const num_texels = double(num_values / 2);
+            std::printf("%dx%d, CPU bake %.1f ms\n", gc_width_height, gc_width_height, cpu_ms);
+            std::printf("scale (R): max error %.5f, mean error %.6f\n", max_error[0], sum_error[0] / num_texels);
+            std::printf("bias (G):  max error %.5f, mean error %.6f\n", max_error[1], sum_error[1] / num_texels);
+
+            if (max_error[0] > tolerance || max_error[1] > tolerance)
+            {
+                std::fprintf(stderr, "CPU and GPU LUT differ by more than %.5f\n", tolerance);
+                res = 1;
+            }
+        }
+
+        tex.free();
+    }
+
+    ctx.destroy();
+    return res;
+}
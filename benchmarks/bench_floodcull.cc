@@ -0,0 +1,173 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <clean-core/alloc_vector.hh>
+#include <clean-core/vector.hh>
+
+#include <arcana-incubator/device-abstraction/timer.hh>
+#include <arcana-incubator/pr-util/framegraph/floodcull.hh>
+
+// run_floodcull (adjacency lists, linear) against the previous full-scan floodfill on synthetic graphs
+// each pass writes two resources and reads up to three written by earlier passes, some passes are roots,
+// the outputs of the others are only kept alive by later reads, the rest is culled
+// both must produce the same refcounts, the scan is skipped for the largest graphs
+namespace
+{
+using inc::frag::floodcull_relation;
+
+constexpr unsigned gc_num_iterations = 5;
+constexpr unsigned gc_max_scan_passes = 8000;
+
+struct synthetic_graph
+{
+    cc::vector<int> pass_refcounts;
+    cc::vector<int> resource_refcounts;
+    cc::vector<floodcull_relation> writes;
+    cc::vector<floodcull_relation> reads;
+};
+
+struct lcg
+{
+    uint32_t state;
+    uint32_t next(uint32_t bound)
+    {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 8) % bound;
+    }
+};
+
+synthetic_graph make_graph(unsigned num_passes)
+{
+    synthetic_graph res;
+    res.pass_refcounts.resize(num_passes, 0);
+    res.resource_refcounts.resize(num_passes * 2, 0);
+
+    lcg rng{num_passes};
+    for (auto p = 0u; p < num_passes; ++p)
+    {
+        res.writes.push_back({p, p * 2});
+        res.writes.push_back({p, p * 2 + 1});
+
+        // reads from a window of recent passes, like a chain of post-processing steps with side inputs
+        if (p > 0)
+        {
+            unsigned const window = p < 32 ? p : 32;
+            unsigned const num_reads = 1 + rng.next(3);
+            for (auto r = 0u; r < num_reads; ++r)
+                res.reads.push_back({p, (p - 1 - rng.next(window)) * 2 + rng.next(2)});
+        }
+
+        // every 16th pass is a root (ie. writes the backbuffer)
+        if (p % 16 == 15)
+            res.pass_refcounts[p] = 1;
+    }
+
+    return res;
+}
+
+// the previous implementation, scans all relations for each popped resource and each retired producer
+void run_floodcull_scan(cc::span<int> producers, cc::span<int> resources, cc::span<floodcull_relation const> writes, cc::span<floodcull_relation const> reads)
+{
+    for (auto const& write : writes)
+        producers[write.producer_index]++;
+
+    for (auto const& read : reads)
+        if (producers[read.producer_index] != 0)
+            resources[read.resource_index]++;
+
+    cc::vector<unsigned> stack;
+    for (auto i = 0u; i < resources.size(); ++i)
+        if (resources[i] == 0)
+            stack.push_back(i);
+
+    while (!stack.empty())
+    {
+        unsigned const popped = stack.back();
+        stack.pop_back();
+
+        for (auto const& write : writes)
+        {
+            if (write.resource_index != popped)
+                continue;
+
+            if (--producers[write.producer_index] != 0)
+                continue;
+
+            for (auto const& read : reads)
+                if (read.producer_index == write.producer_index && --resources[read.resource_index] == 0)
+                    stack.push_back(read.resource_index);
+        }
+    }
+
+    for (auto const& write : writes)
+        if (producers[write.producer_index] != 0 && resources[write.resource_index] == 0)
+            resources[write.resource_index] = 1;
+}
+
+template <class F>
+double measure_best_ms(synthetic_graph const& graph, cc::vector<int>& out_passes, cc::vector<int>& out_resources, F&& f_cull)
+{
+    double best_ms = 1e30;
+    for (auto i = 0u; i < gc_num_iterations; ++i)
+    {
+        out_passes = graph.pass_refcounts;
+        out_resources = graph.resource_refcounts;
+
+        inc::da::Timer timer;
+        f_cull(cc::span<int>(out_passes), cc::span<int>(out_resources));
+        double const ms = timer.elapsedMillisecondsD();
+        best_ms = ms < best_ms ? ms : best_ms;
+    }
+    return best_ms;
+}
+
+unsigned count_zero(cc::vector<int> const& refcounts)
+{
+    unsigned res = 0;
+    for (int const rc : refcounts)
+        res += rc == 0 ? 1 : 0;
+    return res;
+}
+}
+
+int main()
+{
+    unsigned const pass_counts[] = {100, 1000, 4000, 8000, 32000, 128000};
+
+    std::printf("%10s %10s %10s %10s %14s %14s\n", "passes", "relations", "culled", "culled res", "adjacency ms", "scan ms");
+
+    for (unsigned const num_passes : pass_counts)
+    {
+        auto const graph = make_graph(num_passes);
+
+        cc::vector<int> passes;
+        cc::vector<int> resources;
+        double const adjacency_ms = measure_best_ms(graph, passes, resources, [&](cc::span<int> p, cc::span<int> r) {
+            inc::frag::run_floodcull(p, r, graph.writes, graph.reads);
+        });
+
+        std::printf("%10u %10zu %10u %10u %14.3f", num_passes, graph.writes.size() + graph.reads.size(), count_zero(passes), count_zero(resources), adjacency_ms);
+
+        if (num_passes > gc_max_scan_passes)
+        {
+            std::printf(" %14s\n", "-");
+            continue;
+        }
+
+        cc::vector<int> ref_passes;
+        cc::vector<int> ref_resources;
+        double const scan_ms = measure_best_ms(graph, ref_passes, ref_resources, [&](cc::span<int> p, cc::span<int> r) {
+            run_floodcull_scan(p, r, graph.writes, graph.reads);
+        });
+
+        bool const is_equal = std::memcmp(passes.data(), ref_passes.data(), passes.size() * sizeof(int)) == 0
+                              && std::memcmp(resources.data(), ref_resources.data(), resources.size() * sizeof(int)) == 0;
+
+        std::printf(" %14.3f%s\n", scan_ms, is_equal ? "" : "  MISMATCH");
+        if (!is_equal)
+            return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,176 @@
+#include <cstdint>
+#include <cstdio>
+
+#include <clean-core/allocator.hh>
+#include <clean-core/span.hh>
+
+#include <phantasm-renderer/Context.hh>
+
+#include <arcana-incubator/device-abstraction/timer.hh>
+#include <arcana-incubator/pr-util/framegraph/framegraph.hh>
+#include <arcana-incubator/pr-util/framegraph/resource_cache.hh>
+
+// GraphBuilder setup (reset and addPass) for graphs of 1k to 100k resource accesses
+// each pass creates two buffers, reads six and writes two resources created by earlier passes
+// the guid lookup is hashed, the time per access should stay flat as the graph grows
+// with a backend argument, also the compile of the same graphs, full and in steady state (re-recorded, structure unchanged)
+// a steady compile restores all results including the queue schedule, it fails if the compile was not reused
+// nothing is executed, the transient buffers are created but never used
+// usage: bench_guid_setup [vulkan|d3d12]
+namespace
+{
+using inc::frag::res_guid_t;
+
+constexpr unsigned gc_num_iterations = 5;
+constexpr unsigned gc_accesses_per_pass = 10;
+
+struct empty_pass_data
+{
+};
+
+// spreads the guids like hashed resource names would
+res_guid_t make_guid(unsigned index)
+{
+    uint64_t z = uint64_t(index) + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+void record_graph(inc::frag::GraphBuilder& builder, unsigned num_passes)
+{
+    builder.reset();
+
+    uint32_t rng = 12345;
+    auto const f_earlier_guid = [&](unsigned pass) {
+        rng = rng * 1664525u + 1013904223u;
+        return make_guid((rng >> 8) % (pass * 2));
+    };
+
+    for (auto p = 0u; p < num_passes; ++p)
+    {
+        builder.addPass<empty_pass_data>(
+            "bench",
+            [&](empty_pass_data&, inc::frag::setup_context& ctx) {
+                ctx.create_buffer(make_guid(p * 2), 256, 16);
+                ctx.create_buffer(make_guid(p * 2 + 1), 256, 16);
+
+                // the first pass has nothing to read
+                if (p > 0)
+                {
+                    for (auto i = 0u; i < 6; ++i)
+                        ctx.read(f_earlier_guid(p));
+                    for (auto i = 0u; i < 2; ++i)
+                        ctx.write(f_earlier_guid(p));
+                }
+
+                if (p + 1 == num_passes)
+                    ctx.set_root();
+            },
+            [](empty_pass_data const&, inc::frag::exec_context&) {});
+    }
+}
+
+// best time of compile, each iteration is a new frame with the graph recorded again
+// returns false if reuse was enabled but a compile was not reused
+bool measure_compile(inc::frag::GraphBuilder& builder, inc::frag::GraphCache& cache, unsigned num_passes, bool reuse, double& out_best_ms)
+{
+    builder.setCompileReuseEnabled(reuse);
+
+    // warmup, creates the transient buffers and stores the results to reuse
+    cache.onNewFrame();
+    record_graph(builder, num_passes);
+    builder.compile(cache, cc::system_allocator);
+
+    bool all_reused = true;
+    out_best_ms = 1e30;
+    for (auto i = 0u; i < gc_num_iterations; ++i)
+    {
+        cache.onNewFrame();
+        record_graph(builder, num_passes);
+
+        inc::da::Timer timer;
+        builder.compile(cache, cc::system_allocator);
+        double const ms = timer.elapsedMillisecondsD();
+        out_best_ms = ms < out_best_ms ? ms : out_best_ms;
+
+        all_reused = all_reused && builder.wasCompileReused();
+    }
+
+    return !reuse || all_reused;
+}
+
+int run_compile_cases(cc::span<unsigned const> access_counts, bool use_d3d12)
+{
+    pr::Context ctx;
+    ctx.initialize(use_d3d12 ? pr::backend::d3d12 : pr::backend::vulkan);
+
+    int res = 0;
+    {
+        std::printf("\n%10s %10s %12s %12s %9s\n", "accesses", "passes", "full ms", "steady ms", "speedup");
+
+        for (unsigned const num_accesses : access_counts)
+        {
+            unsigned const num_passes = num_accesses / gc_accesses_per_pass;
+
+            inc::frag::GraphCache cache(&ctx);
+            inc::frag::GraphBuilder builder;
+            builder.initialize(cc::system_allocator, num_passes, num_passes * 2);
+
+            double full_ms = 0;
+            double steady_ms = 0;
+            (void)measure_compile(builder, cache, num_passes, false, full_ms);
+            bool const reused = measure_compile(builder, cache, num_passes, true, steady_ms);
+
+            std::printf("%10u %10u %12.3f %12.3f %8.1fx\n", num_accesses, num_passes, full_ms, steady_ms, full_ms / steady_ms);
+
+            if (!reused)
+            {
+                std::fprintf(stderr, "compile of an unchanged graph with %u passes was not reused\n", num_passes);
+                res = 1;
+            }
+
+            builder.destroy();
+            cache.destroy();
+        }
+
+        ctx.flush();
+    }
+
+    ctx.destroy();
+    return res;
+}
+}
+
+int main(int argc, char** argv)
+{
+    unsigned const access_counts[] = {1000, 10000, 100000};
+
+    std::printf("%10s %10s %12s %14s\n", "accesses", "passes", "setup ms", "ns / access");
+
+    for (unsigned const num_accesses : access_counts)
+    {
+        unsigned const num_passes = num_accesses / gc_accesses_per_pass;
+
+        inc::frag::GraphBuilder builder;
+        builder.initialize(cc::system_allocator, num_passes, num_passes * 2);
+
+        double best_ms = 1e30;
+        for (auto i = 0u; i < gc_num_iterations; ++i)
+        {
+            inc::da::Timer timer;
+            record_graph(builder, num_passes);
+            double const ms = timer.elapsedMillisecondsD();
+            best_ms = ms < best_ms ? ms : best_ms;
+        }
+
+        std::printf("%10u %10u %12.3f %14.1f\n", num_accesses, num_passes, best_ms, best_ms * 1e6 / num_accesses);
+
+        builder.destroy();
+    }
+
+    if (argc > 1)
+        return run_compile_cases(access_counts, argv[1][0] == 'd');
+
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include <cstdio>
+
+#include <clean-core/utility.hh>
+
+#include <phantasm-renderer/Context.hh>
+#include <phantasm-renderer/Frame.hh>
+
+#include <arcana-incubator/pr-util/texture_processing.hh>
+
+// barriers and dispatches of texture_processing::generate_mips, per-level path against the mipgen_spd single pass path
+// runs headless, for a software device point the Vulkan loader at lavapipe (ie. VK_ICD_FILENAMES=.../lvp_icd.x86_64.json)
+// usage: bench_mipgen_barriers <shader path prefix> [vulkan|d3d12]
+namespace
+{
+struct mip_case
+{
+    char const* name;
+    int width;
+    int height;
+    int num_mips;
+    bool per_level_supported; // square power of two
+};
+
+inc::pre::mipgen_stats run_case(pr::Context& ctx, inc::pre::texture_processing& tex, mip_case const& c, bool single_pass)
+{
+    auto texture = ctx.make_texture({c.width, c.height}, pr::format::rgba8un, c.num_mips, true);
+
+    tex.set_single_pass_mipgen_enabled(single_pass);
+    tex.reset_mipgen_stats();
+
+    auto frame = ctx.make_frame();
+    tex.generate_mips(frame, texture);
+    ctx.submit(cc::move(frame));
+    ctx.flush();
+
+    return tex.get_mipgen_stats();
+}
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "usage: %s <shader path prefix> [vulkan|d3d12]\n", argv[0]);
+        return 1;
+    }
+
+    bool const use_d3d12 = argc > 2 && argv[2][0] == 'd';
+
+    pr::Context ctx;
+    ctx.initialize(use_d3d12 ? pr::backend::d3d12 : pr::backend::vulkan);
+
+    int res = 0;
+    {
+        inc::pre::texture_processing tex;
+        tex.init(ctx, argv[1]);
+
+        mip_case const cases[] = {
+            {"1024x1024, 11 mips", 1024, 1024, 11, true}, //
+            {"4096x4096, 13 mips", 4096, 4096, 13, true}, //
+            {"1000x600, 10 mips", 1000, 600, 10, false},  //
+        };
+
+        std::printf("%-22s %-11s %10s %10s %10s\n", "case", "path", "dispatch", "barriers", "slices");
+
+        for (auto const& c : cases)
+        {
+            if (c.per_level_supported)
+            {
+                auto const stats = run_case(ctx, tex, c, false);
+                std::printf("%-22s %-11s %10u %10u %10u\n", c.name, "per level", stats.num_dispatches, stats.num_barrier_commands, stats.num_slice_transitions);
+            }
+
+            auto const stats = run_case(ctx, tex, c, true);
+            std::printf("%-22s %-11s %10u %10u %10u\n", c.name, "single pass", stats.num_dispatches, stats.num_barrier_commands, stats.num_slice_transitions);
+
+            // one dispatch with a batched transition before and after it, unless the mips exceed gc_spd_max_num_mips
+            bool const expects_single_pass = c.num_mips - 1 <= 12;
+            if (expects_single_pass && stats.num_dispatches != 1)
+            {
+                std::fprintf(stderr, "  single pass path not taken, is the mipgen_spd shader present?\n");
+                res = 1;
+            }
+        }
+
+        tex.free();
+    }
+
+    ctx.destroy();
+    return res;
+}
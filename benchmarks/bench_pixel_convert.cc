@@ -0,0 +1,244 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#include <clean-core/alloc_array.hh>
+
+#include <arcana-incubator/asset-loading/pixel_convert.hh>
+#include <arcana-incubator/device-abstraction/timer.hh>
+
+// every pixel_convert kernel on each supported instruction set against the scalar reference
+// the outputs must be bit-identical (including NaN payloads), float inputs include out of range values, infinities,
+// NaNs, denormals and negative zero, conversions in place include copying their input
+// float32 to float16 is additionally checked for all 2^32 inputs, float16 to float32 for all 2^16
+namespace
+{
+using inc::assets::pixel_isa;
+
+constexpr unsigned gc_num_iterations = 10;
+constexpr size_t gc_num_pixels = 1024 * 1024;
+constexpr size_t gc_exhaustive_chunk_size = 1 << 20;
+
+pixel_isa const gc_isas[] = {pixel_isa::scalar, pixel_isa::ssse3, pixel_isa::avx2};
+char const* const gc_isa_names[] = {"scalar", "ssse3", "avx2"};
+
+struct lcg
+{
+    uint32_t state;
+    uint32_t next()
+    {
+        state = state * 1664525u + 1013904223u;
+        return state;
+    }
+};
+
+struct inputs
+{
+    cc::alloc_array<uint8_t> unorm8; // gc_num_pixels * 4
+    cc::alloc_array<float> floats;   // gc_num_pixels * 4
+    cc::alloc_array<uint16_t> halfs; // gc_num_pixels * 4
+};
+
+float from_bits(uint32_t bits)
+{
+    float res;
+    std::memcpy(&res, &bits, sizeof(res));
+    return res;
+}
+
+inputs make_inputs()
+{
+    inputs res;
+    res.unorm8 = cc::alloc_array<uint8_t>::uninitialized(gc_num_pixels * 4);
+    res.floats = cc::alloc_array<float>::uninitialized(gc_num_pixels * 4);
+    res.halfs = cc::alloc_array<uint16_t>::uninitialized(gc_num_pixels * 4);
+
+    lcg rng{1};
+    for (auto& v : res.unorm8)
+        v = uint8_t(rng.next() >> 24);
+
+    // mostly [-0.25, 1.25], every 16th value a special one
+    float const specials[] = {
+        std::numeric_limits<float>::quiet_NaN(), -std::numeric_limits<float>::quiet_NaN(), from_bits(0x7f800001u), from_bits(0xffc12345u),
+        std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), -0.f, 0.f, from_bits(0x00000001u), from_bits(0x807fffffu),
+        65504.f, 65520.f, 1e-8f, -1e30f, 0.5f / 255.f, 1.f - 0.5f / 255.f,
+    };
+    for (auto i = 0u; i < res.floats.size(); ++i)
+    {
+        uint32_t const r = rng.next();
+        res.floats[i] = i % 16 == 15 ? specials[(r >> 8) % (sizeof(specials) / sizeof(specials[0]))] : float(r >> 8) / float(1 << 24) * 1.5f - 0.25f;
+    }
+
+    for (auto i = 0u; i < res.halfs.size(); ++i)
+        res.halfs[i] = uint16_t(i * 40503u); // odd multiplier, cycles through all 2^16 values
+
+    return res;
+}
+
+template <class F>
+double measure_best_ms(F&& f_convert)
+{
+    double best_ms = 1e30;
+    for (auto i = 0u; i < gc_num_iterations; ++i)
+    {
+        inc::da::Timer timer;
+        f_convert();
+        double const ms = timer.elapsedMillisecondsD();
+        best_ms = ms < best_ms ? ms : best_ms;
+    }
+    return best_ms;
+}
+
+// runs f_convert(std::byte* dest) with each supported instruction set, returns false on a mismatch with scalar
+template <class F>
+bool run_case(char const* name, size_t output_size_bytes, F&& f_convert)
+{
+    // untouched bytes are caught as well, both buffers start out with the same pattern
+    auto reference = cc::alloc_array<std::byte>::uninitialized(output_size_bytes);
+    auto result = cc::alloc_array<std::byte>::uninitialized(output_size_bytes);
+
+    bool is_equal = true;
+    double scalar_ms = 0;
+    for (auto i = 0u; i < sizeof(gc_isas) / sizeof(gc_isas[0]); ++i)
+    {
+        inc::assets::set_pixel_isa(gc_isas[i]);
+        if (inc::assets::get_pixel_isa() != gc_isas[i])
+            continue; // unsupported
+
+        std::byte* const dest = i == 0 ? reference.data() : result.data();
+        std::memset(dest, 0xCD, output_size_bytes);
+
+        double const ms = measure_best_ms([&] { f_convert(dest); });
+        if (i == 0)
+            scalar_ms = ms;
+
+        bool const matches = i == 0 || std::memcmp(reference.data(), result.data(), output_size_bytes) == 0;
+        is_equal = is_equal && matches;
+
+        std::printf("%-30s %-7s %9.3f %8.2fx%s\n", name, gc_isa_names[i], ms, scalar_ms / ms, matches ? "" : "  MISMATCH");
+    }
+
+    return is_equal;
+}
+
+// converts all inputs in chunks with the best instruction set and with scalar, returns false on a mismatch
+template <class Src, class Dest, class F>
+bool run_exhaustive(char const* name, uint64_t num_inputs, F&& f_convert)
+{
+    inc::assets::set_pixel_isa(inc::assets::get_supported_pixel_isa());
+    pixel_isa const isa = inc::assets::get_pixel_isa();
+    if (isa == pixel_isa::scalar)
+        return true;
+
+    size_t const chunk_size = size_t(num_inputs < gc_exhaustive_chunk_size ? num_inputs : gc_exhaustive_chunk_size);
+    auto src = cc::alloc_array<Src>::uninitialized(chunk_size);
+    auto reference = cc::alloc_array<Dest>::uninitialized(chunk_size);
+    auto result = cc::alloc_array<Dest>::uninitialized(chunk_size);
+
+    inc::da::Timer timer;
+    uint64_t num_mismatches = 0;
+    for (uint64_t start = 0; start < num_inputs; start += chunk_size)
+    {
+        for (auto i = 0u; i < chunk_size; ++i)
+        {
+            auto const bits = std::conditional_t<sizeof(Src) == 4, uint32_t, uint16_t>(start + i);
+            std::memcpy(&src[i], &bits, sizeof(Src));
+        }
+
+        inc::assets::set_pixel_isa(pixel_isa::scalar);
+        f_convert(src.data(), reference.data(), chunk_size);
+        inc::assets::set_pixel_isa(isa);
+        f_convert(src.data(), result.data(), chunk_size);
+
+        if (std::memcmp(reference.data(), result.data(), chunk_size * sizeof(Dest)) != 0)
+        {
+            for (auto i = 0u; i < chunk_size; ++i)
+            {
+                if (std::memcmp(&reference[i], &result[i], sizeof(Dest)) == 0)
+                    continue;
+
+                if (num_mismatches < 8)
+                    std::printf("  input 0x%08llx: scalar and %s differ\n", (unsigned long long)(start + i), gc_isa_names[int(isa)]);
+                ++num_mismatches;
+            }
+        }
+    }
+
+    std::printf("%-30s %-7s %9.1f ms for %llu inputs, %llu mismatches\n", name, gc_isa_names[int(isa)], timer.elapsedMillisecondsD(),
+                (unsigned long long)num_inputs, (unsigned long long)num_mismatches);
+    return num_mismatches == 0;
+}
+}
+
+int main()
+{
+    auto const in = make_inputs();
+    size_t const n = gc_num_pixels;
+    bool ok = true;
+
+    std::printf("%-30s %-7s %9s %9s\n", "conversion", "isa", "ms", "speedup");
+
+    ok &= run_case("rgb8 to rgba8", n * 4, [&](std::byte* d) { inc::assets::convert_rgb_to_rgba(in.unorm8.data(), reinterpret_cast<uint8_t*>(d), n); });
+
+    ok &= run_case("swizzle rgba8", n * 4, [&](std::byte* d) { inc::assets::swizzle_rgba_bgra(in.unorm8.data(), reinterpret_cast<uint8_t*>(d), n); });
+
+    ok &= run_case("swizzle rgba8 in place", n * 4, [&](std::byte* d) {
+        std::memcpy(d, in.unorm8.data(), n * 4);
+        inc::assets::swizzle_rgba_bgra(reinterpret_cast<uint8_t*>(d), reinterpret_cast<uint8_t*>(d), n);
+    });
+
+    char name[64];
+    for (unsigned channels = 1; channels <= 4; ++channels)
+    {
+        for (bool const srgb : {false, true})
+        {
+            std::snprintf(name, sizeof(name), "unorm8 to float, %u ch%s", channels, srgb ? ", srgb" : "");
+            ok &= run_case(name, n * channels * sizeof(float), [&](std::byte* d) {
+                inc::assets::convert_unorm8_to_float(in.unorm8.data(), reinterpret_cast<float*>(d), n, channels, srgb);
+            });
+
+            std::snprintf(name, sizeof(name), "float to unorm8, %u ch%s", channels, srgb ? ", srgb" : "");
+            ok &= run_case(name, n * channels, [&](std::byte* d) {
+                inc::assets::convert_float_to_unorm8(in.floats.data(), reinterpret_cast<uint8_t*>(d), n, channels, srgb);
+            });
+        }
+    }
+
+    ok &= run_case("float to half", n * 4 * sizeof(uint16_t),
+                   [&](std::byte* d) { inc::assets::convert_float_to_half(in.floats.data(), reinterpret_cast<uint16_t*>(d), n * 4); });
+
+    ok &= run_case("half to float", n * 4 * sizeof(float),
+                   [&](std::byte* d) { inc::assets::convert_half_to_float(in.halfs.data(), reinterpret_cast<float*>(d), n * 4); });
+
+    ok &= run_case("reconstruct normal z", n * 4,
+                   [&](std::byte* d) { inc::assets::reconstruct_normal_z(in.unorm8.data(), reinterpret_cast<uint8_t*>(d), n); });
+
+    for (bool const srgb : {false, true})
+    {
+        ok &= run_case(srgb ? "premultiply rgba8, srgb" : "premultiply rgba8", n * 4, [&](std::byte* d) {
+            std::memcpy(d, in.unorm8.data(), n * 4);
+            inc::assets::premultiply_alpha(reinterpret_cast<uint8_t*>(d), n, srgb);
+        });
+    }
+
+    ok &= run_case("premultiply float", n * 4 * sizeof(float), [&](std::byte* d) {
+        std::memcpy(d, in.floats.data(), n * 4 * sizeof(float));
+        inc::assets::premultiply_alpha(reinterpret_cast<float*>(d), n);
+    });
+
+    std::printf("\n");
+    ok &= run_exhaustive<float, uint16_t>("float to half, exhaustive", uint64_t(1) << 32, inc::assets::convert_float_to_half);
+    ok &= run_exhaustive<uint16_t, float>("half to float, exhaustive", uint64_t(1) << 16, inc::assets::convert_half_to_float);
+
+    inc::assets::set_pixel_isa(inc::assets::get_supported_pixel_isa());
+
+    if (!ok)
+    {
+        std::fprintf(stderr, "instruction set paths differ from the scalar reference\n");
+        return 1;
+    }
+
+    return 0;
+}
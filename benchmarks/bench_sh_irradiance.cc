@@ -0,0 +1,339 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <clean-core/alloc_array.hh>
+#include <clean-core/utility.hh>
+#include <clean-core/vector.hh>
+
+#include <phantasm-renderer/Context.hh>
+#include <phantasm-renderer/Frame.hh>
+
+#include <arcana-incubator/asset-loading/image_loader.hh>
+#include <arcana-incubator/asset-loading/pixel_convert.hh>
+#include <arcana-incubator/asset-loading/sh_irradiance.hh>
+#include <arcana-incubator/device-abstraction/timer.hh>
+#include <arcana-incubator/pr-util/ibl_cache.hh>
+#include <arcana-incubator/pr-util/texture_processing.hh>
+
+// project_sh9_irradiance against a brute-force cosine convolution of the same equirectangular environment on the CPU,
+// and against the cube of texture_processing::create_diffuse_irradiance_map if a shader path prefix is given
+//
+// environments:
+//   band limited  bands 0 to 2 only (r: 1, g: y, b: 3y^2 - 1 + xz), the SH result is exact up to discretization
+//   sun and sky   a small bright disk over a gradient, SH9 truncates it, the error is bounded but not small
+//   <path>        an HDR equirect file, if given
+//
+// errors are relative to the largest reference irradiance of the environment, all channels
+// fails if the band limited error exceeds 1e-3, or any other error exceeds the tolerance
+// the GPU comparison runs headless, for a software device point the Vulkan loader at lavapipe (ie. VK_ICD_FILENAMES=.../lvp_icd.x86_64.json)
+// usage: bench_sh_irradiance [hdr equirect path] [shader path prefix] [vulkan|d3d12] [tolerance]
+namespace
+{
+constexpr unsigned gc_num_iterations = 5;
+constexpr unsigned gc_num_normals = 128;
+constexpr unsigned gc_irradiance_cube_size = 32;
+constexpr float gc_band_limited_tolerance = 1e-3f;
+constexpr float gc_default_tolerance = 0.1f;
+constexpr double gc_pi = 3.14159265358979323846;
+
+struct environment
+{
+    char const* name;
+    cc::alloc_array<float> texels; // rgba float
+    unsigned width = 0;
+    unsigned height = 0;
+};
+
+// the direction of an equirect texel, the mapping of project_sh9_irradiance
+tg::vec3 get_texel_direction(unsigned x, unsigned y, unsigned width, unsigned height)
+{
+    double const theta = gc_pi * (y + 0.5) / height;
+    double const phi = 2 * gc_pi * ((x + 0.5) / width - 0.5);
+    return {float(std::sin(theta) * std::cos(phi)), float(std::cos(theta)), float(std::sin(theta) * std::sin(phi))};
+}
+
+template <class F>
+environment make_environment(char const* name, unsigned width, unsigned height, F&& f_radiance)
+{
+    environment res;
+    res.name = name;
+    res.width = width;
+    res.height = height;
+    res.texels = cc::alloc_array<float>::uninitialized(size_t(width) * height * 4);
+
+    for (auto y = 0u; y < height; ++y)
+        for (auto x = 0u; x < width; ++x)
+        {
+            tg::vec3 const rgb = f_radiance(get_texel_direction(x, y, width, height));
+            float* const texel = res.texels.data() + (size_t(y) * width + x) * 4;
+            texel[0] = rgb.x;
+            texel[1] = rgb.y;
+            texel[2] = rgb.z;
+            texel[3] = 1.f;
+        }
+
+    return res;
+}
+
+// normals spread evenly over the sphere (Fibonacci lattice)
+tg::vec3 get_normal(unsigned i)
+{
+    double const y = 1 - 2 * (i + 0.5) / gc_num_normals;
+    double const r = std::sqrt(1 - y * y);
+    double const phi = gc_pi * (3 - std::sqrt(5.0)) * i;
+    return {float(r * std::cos(phi)), float(y), float(r * std::sin(phi))};
+}
+
+// irradiance / pi at normal, the integral of radiance times the clamped cosine over all texels
+tg::vec3 convolve_brute_force(environment const& env, tg::vec3 normal)
+{
+    double sum[3] = {};
+    for (auto y = 0u; y < env.height; ++y)
+    {
+        double const theta = gc_pi * (y + 0.5) / env.height;
+        double const texel_angle = (2 * gc_pi / env.width) * (gc_pi / env.height) * std::sin(theta);
+
+        for (auto x = 0u; x < env.width; ++x)
+        {
+            tg::vec3 const dir = get_texel_direction(x, y, env.width, env.height);
+            double const cos_angle = double(normal.x) * dir.x + double(normal.y) * dir.y + double(normal.z) * dir.z;
+            if (cos_angle <= 0)
+                continue;
+
+            float const* const texel = env.texels.data() + (size_t(y) * env.width + x) * 4;
+            for (auto c = 0u; c < 3; ++c)
+                sum[c] += texel[c] * cos_angle * texel_angle;
+        }
+    }
+
+    return {float(sum[0] / gc_pi), float(sum[1] / gc_pi), float(sum[2] / gc_pi)};
+}
+
+struct error_stats
+{
+    float max_reference = 0.f;
+    float max_error = 0.f;
+    double sum_error = 0.0;
+    unsigned num_values = 0;
+
+    void add(tg::vec3 reference, tg::vec3 result)
+    {
+        float const ref[3] = {reference.x, reference.y, reference.z};
+        float const res[3] = {result.x, result.y, result.z};
+        for (auto c = 0u; c < 3; ++c)
+        {
+            max_reference = cc::max(max_reference, std::abs(ref[c]));
+            max_error = cc::max(max_error, std::abs(ref[c] - res[c]));
+            sum_error += std::abs(ref[c] - res[c]);
+            ++num_values;
+        }
+    }
+
+    float get_relative_max() const { return max_reference > 0.f ? max_error / max_reference : max_error; }
+    float get_relative_mean() const { return max_reference > 0.f ? float(sum_error / num_values) / max_reference : float(sum_error / num_values); }
+};
+
+inc::assets::sh9_irradiance project_timed(environment const& env, double& out_best_ms)
+{
+    inc::assets::sh9_irradiance res;
+    out_best_ms = 1e30;
+    for (auto i = 0u; i < gc_num_iterations; ++i)
+    {
+        inc::da::Timer timer;
+        res = inc::assets::project_sh9_irradiance(env.texels.data(), env.width, env.height, 4);
+        double const ms = timer.elapsedMillisecondsD();
+        out_best_ms = ms < out_best_ms ? ms : out_best_ms;
+    }
+    return res;
+}
+
+// returns the relative max error
+float compare_brute_force(environment const& env, inc::assets::sh9_irradiance const& sh, double project_ms)
+{
+    inc::da::Timer timer;
+    error_stats stats;
+    for (auto i = 0u; i < gc_num_normals; ++i)
+    {
+        tg::vec3 const n = get_normal(i);
+        stats.add(convolve_brute_force(env, n), inc::assets::evaluate_sh9_irradiance(sh, n));
+    }
+    double const brute_force_ms = timer.elapsedMillisecondsD();
+
+    std::printf("%-14s %5ux%-5u %12.2f %14.1f %10.5f %10.5f\n", env.name, env.width, env.height, project_ms, brute_force_ms, stats.get_relative_max(),
+                stats.get_relative_mean());
+    return stats.get_relative_max();
+}
+
+// direction through the center of a cube texel, D3D / Vulkan face order and orientation (+x, -x, +y, -y, +z, -z)
+tg::vec3 get_cube_texel_direction(unsigned face, unsigned x, unsigned y, unsigned size)
+{
+    float const u = 2.f * (x + 0.5f) / size - 1.f;
+    float const v = 2.f * (y + 0.5f) / size - 1.f;
+
+    tg::vec3 dir;
+    switch (face)
+    {
+    case 0: dir = {1.f, -v, -u}; break;
+    case 1: dir = {-1.f, -v, u}; break;
+    case 2: dir = {u, 1.f, v}; break;
+    case 3: dir = {u, -1.f, -v}; break;
+    case 4: dir = {u, -v, 1.f}; break;
+    default: dir = {-u, -v, -1.f}; break;
+    }
+
+    float const len = std::sqrt(dir.x * dir.x + dir.y * dir.y + dir.z * dir.z);
+    return {dir.x / len, dir.y / len, dir.z / len};
+}
+
+// returns the relative max error, or a negative value if the readback has an unexpected layout
+float compare_gpu(pr::Context& ctx, inc::pre::texture_processing& tex, char const* path, inc::assets::sh9_irradiance const& sh)
+{
+    pr::auto_texture irradiance;
+    {
+        auto frame = ctx.make_frame();
+        auto specular = tex.load_filtered_specular_map_from_file(frame, path);
+        irradiance = tex.create_diffuse_irradiance_map(frame, specular.unfiltered_env, gc_irradiance_cube_size);
+        ctx.submit(cc::move(frame));
+    }
+
+    inc::pre::cooked_texture_header header;
+    cc::vector<std::byte> texels;
+    (void)inc::pre::read_back_cooked_texture(ctx, irradiance, header, texels);
+
+    if (header.array_size != 6 || header.width != header.height || header.fmt != uint32_t(pr::format::rgba16f))
+        return -1.f;
+
+    // slice-major, then mips, only mip 0 of each face is compared
+    size_t slice_size_bytes = 0;
+    for (auto m = 0u; m < header.num_mips; ++m)
+        slice_size_bytes += size_t(cc::max(1u, header.width >> m)) * cc::max(1u, header.height >> m) * 8;
+
+    if (texels.size() < slice_size_bytes * 6)
+        return -1.f;
+
+    unsigned const size = header.width;
+    auto halfs = cc::alloc_array<uint16_t>::uninitialized(size_t(size) * size * 4);
+    auto values = cc::alloc_array<float>::uninitialized(halfs.size());
+
+    error_stats stats;
+    for (auto face = 0u; face < 6; ++face)
+    {
+        std::memcpy(halfs.data(), texels.data() + face * slice_size_bytes, halfs.size() * sizeof(uint16_t));
+        inc::assets::convert_half_to_float(halfs.data(), values.data(), values.size());
+
+        for (auto y = 0u; y < size; ++y)
+            for (auto x = 0u; x < size; ++x)
+            {
+                float const* const texel = values.data() + (size_t(y) * size + x) * 4;
+                tg::vec3 const n = get_cube_texel_direction(face, x, y, size);
+                stats.add({texel[0], texel[1], texel[2]}, inc::assets::evaluate_sh9_irradiance(sh, n));
+            }
+    }
+
+    std::printf("%-14s %5ux%-5u %12s %14s %10.5f %10.5f\n", "GPU cube", size, size, "-", "-", stats.get_relative_max(), stats.get_relative_mean());
+    return stats.get_relative_max();
+}
+}
+
+int main(int argc, char** argv)
+{
+    char const* const env_path = argc > 1 ? argv[1] : nullptr;
+    char const* const shader_prefix = argc > 2 ? argv[2] : nullptr;
+    bool const use_d3d12 = argc > 3 && argv[3][0] == 'd';
+    float const tolerance = argc > 4 ? float(std::atof(argv[4])) : gc_default_tolerance;
+
+    if (shader_prefix != nullptr && env_path == nullptr)
+    {
+        std::fprintf(stderr, "usage: %s [hdr equirect path] [shader path prefix] [vulkan|d3d12] [tolerance]\n", argv[0]);
+        return 1;
+    }
+
+    int res = 0;
+    std::printf("%-14s %11s %12s %14s %10s %10s\n", "environment", "size", "project ms", "reference ms", "max error", "mean error");
+
+    {
+        auto const env = make_environment("band limited", 512, 256, [](tg::vec3 d) { return tg::vec3(1.f, d.y, 3 * d.y * d.y - 1 + d.x * d.z); });
+
+        double project_ms;
+        auto const sh = project_timed(env, project_ms);
+        if (compare_brute_force(env, sh, project_ms) > gc_band_limited_tolerance)
+        {
+            std::fprintf(stderr, "  exceeds %.5f, the projection or the cosine lobe constants are wrong\n", gc_band_limited_tolerance);
+            res = 1;
+        }
+    }
+
+    {
+        // a disk of about 3 degrees radius, 500 times brighter than the sky
+        tg::vec3 const sun_dir = {0.48f, 0.6f, 0.64f};
+        auto const env = make_environment("sun and sky", 512, 256, [&](tg::vec3 d) {
+            float const sky = 0.3f + 0.2f * cc::max(0.f, d.y);
+            bool const is_sun = d.x * sun_dir.x + d.y * sun_dir.y + d.z * sun_dir.z > 0.9986f;
+            return is_sun ? tg::vec3(500.f, 480.f, 450.f) : tg::vec3(sky * 0.6f, sky * 0.8f, sky);
+        });
+
+        double project_ms;
+        auto const sh = project_timed(env, project_ms);
+        if (compare_brute_force(env, sh, project_ms) > tolerance)
+        {
+            std::fprintf(stderr, "  exceeds %.5f\n", tolerance);
+            res = 1;
+        }
+    }
+
+    if (env_path == nullptr)
+        return res;
+
+    inc::assets::image_size img_size;
+    auto const img = inc::assets::load_image(env_path, img_size, 4, true);
+    if (!inc::assets::is_valid(img))
+    {
+        std::fprintf(stderr, "failed to load %s\n", env_path);
+        return 1;
+    }
+
+    environment env;
+    env.name = "file";
+    env.width = img_size.width;
+    env.height = img_size.height;
+    env.texels = cc::alloc_array<float>::uninitialized(size_t(env.width) * env.height * 4);
+    std::memcpy(env.texels.data(), img.raw, env.texels.size() * sizeof(float));
+    inc::assets::free(img);
+
+    double project_ms;
+    auto const sh = project_timed(env, project_ms);
+    if (compare_brute_force(env, sh, project_ms) > tolerance)
+    {
+        std::fprintf(stderr, "  exceeds %.5f\n", tolerance);
+        res = 1;
+    }
+
+    if (shader_prefix == nullptr)
+        return res;
+
+    pr::Context ctx;
+    ctx.initialize(use_d3d12 ? pr::backend::d3d12 : pr::backend::vulkan);
+    {
+        inc::pre::texture_processing tex;
+        tex.init(ctx, shader_prefix);
+
+        float const gpu_error = compare_gpu(ctx, tex, env_path, sh);
+        if (gpu_error < 0.f)
+        {
+            std::fprintf(stderr, "irradiance map readback has an unexpected layout, expected an rgba16f cube\n");
+            res = 1;
+        }
+        else if (gpu_error > tolerance)
+        {
+            std::fprintf(stderr, "  exceeds %.5f\n", tolerance);
+            res = 1;
+        }
+
+        tex.free();
+    }
+    ctx.destroy();
+
+    return res;
+}
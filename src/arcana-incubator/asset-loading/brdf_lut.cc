@@ -0,0 +1,206 @@
+#include "brdf_lut.hh"
+
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+#include <clean-core/assert.hh>
+#include <clean-core/capped_vector.hh>
+#include <clean-core/utility.hh>
+
+#include "pixel_convert.hh"
+
+namespace
+{
+constexpr unsigned gc_max_num_threads = 32;
+constexpr double gc_pi = 3.14159265358979323846;
+
+constexpr uint32_t gc_brdf_lut_magic = 0x46445242; // "BRDF"
+constexpr uint32_t gc_brdf_lut_version = 1;
+
+struct brdf_lut_header
+{
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+double radical_inverse_vdc(uint32_t bits)
+{
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return double(bits) * 2.3283064365386963e-10; // / 0x100000000
+}
+
+// a point of the Hammersley sequence, phi precomputed
+struct hammersley_sample
+{
+    double cos_phi;
+    double v;
+};
+
+// V has no y component, H.y is never needed
+struct half_vector
+{
+    double x;
+    double z;
+};
+}
+
+inc::assets::brdf_lut_data inc::assets::compute_brdf_lut(unsigned width, unsigned height, unsigned num_samples, unsigned max_num_threads, cc::allocator* alloc)
+{
+    CC_ASSERT(width > 0 && height > 0 && num_samples > 0 && "invalid BRDF LUT size");
+
+    brdf_lut_data res;
+    res.width = width;
+    res.height = height;
+    res.texels = cc::alloc_array<uint16_t>::uninitialized(size_t(width) * height * 2, alloc);
+
+    auto samples = cc::alloc_array<hammersley_sample>::uninitialized(num_samples, alloc);
+    for (auto i = 0u; i < num_samples; ++i)
+    {
+        double const phi = 2 * gc_pi * (double(i) / num_samples);
+        samples[i] = {std::cos(phi), radical_inverse_vdc(i)};
+    }
+
+    auto const f_compute_rows = [&](unsigned start, unsigned end) {
+        // thread-local scratch, from the system allocator as the caller's allocator may not be thread safe
+        // per row, the importance sampled half vectors only depend on the roughness
+        auto half_vectors = cc::alloc_array<half_vector>::uninitialized(num_samples);
+        auto row = cc::alloc_array<float>::uninitialized(size_t(width) * 2);
+
+        for (auto y = start; y < end; ++y)
+        {
+            double const roughness = (y + 0.5) / height;
+            double const a = roughness * roughness;
+            double const k = a / 2;
+
+            for (auto i = 0u; i < num_samples; ++i)
+            {
+                double const cos_theta = std::sqrt((1 - samples[i].v) / (1 + (a * a - 1) * samples[i].v));
+                double const sin_theta = std::sqrt(1 - cos_theta * cos_theta);
+                half_vectors[i] = {sin_theta * samples[i].cos_phi, cos_theta};
+            }
+
+            for (auto x = 0u; x < width; ++x)
+            {
+                // V in the xz plane, N = +z
+                double const n_dot_v = (x + 0.5) / width;
+                double const v_x = std::sqrt(1 - n_dot_v * n_dot_v);
+                double const g1_v = n_dot_v / (n_dot_v * (1 - k) + k);
+
+                double scale = 0;
+                double bias = 0;
+                for (auto const& h : half_vectors)
+                {
+                    double const v_dot_h = cc::max(v_x * h.x + n_dot_v * h.z, 0.0);
+                    double const n_dot_l = 2 * v_dot_h * h.z - n_dot_v;
+                    if (n_dot_l <= 0)
+                        continue;
+
+                    double const g = g1_v * n_dot_l / (n_dot_l * (1 - k) + k);
+                    double const g_vis = g * v_dot_h / (h.z * n_dot_v);
+                    double const one_minus_v_dot_h = 1 - v_dot_h;
+                    double const fc_2 = one_minus_v_dot_h * one_minus_v_dot_h;
+                    double const fc = fc_2 * fc_2 * one_minus_v_dot_h;
+
+                    scale += (1 - fc) * g_vis;
+                    bias += fc * g_vis;
+                }
+
+                row[x * 2 + 0] = float(scale / num_samples);
+                row[x * 2 + 1] = float(bias / num_samples);
+            }
+
+            convert_float_to_half(row.data(), res.texels.data() + size_t(y) * width * 2, size_t(width) * 2);
+        }
+    };
+
+    unsigned num_threads = max_num_threads > 0 ? max_num_threads : cc::max(1u, std::thread::hardware_concurrency());
+    num_threads = cc::min(cc::min(num_threads, height), gc_max_num_threads);
+
+    if (num_threads == 1)
+    {
+        f_compute_rows(0, height);
+    }
+    else
+    {
+        cc::capped_vector<std::thread, gc_max_num_threads> threads;
+        unsigned const rows_per_thread = (height + num_threads - 1) / num_threads;
+
+        for (auto i = 1u; i < num_threads; ++i)
+        {
+            unsigned const start = cc::min(height, i * rows_per_thread);
+            unsigned const end = cc::min(height, start + rows_per_thread);
+            threads.emplace_back([&, start, end] { f_compute_rows(start, end); });
+        }
+
+        f_compute_rows(0, cc::min(height, rows_per_thread));
+
+        for (auto& t : threads)
+            t.join();
+    }
+
+    return res;
+}
+
+bool inc::assets::write_brdf_lut(const char* path, const inc::assets::brdf_lut_data& lut)
+{
+    std::FILE* const file = std::fopen(path, "wb");
+    if (file == nullptr)
+        return false;
+
+    brdf_lut_header header;
+    header.magic = gc_brdf_lut_magic;
+    header.version = gc_brdf_lut_version;
+    header.width = lut.width;
+    header.height = lut.height;
+
+    size_t const num_texel_values = size_t(lut.width) * lut.height * 2;
+    bool const success = std::fwrite(&header, sizeof(header), 1, file) == 1 //
+                         && std::fwrite(lut.texels.data(), sizeof(uint16_t), num_texel_values, file) == num_texel_values;
+
+    std::fclose(file);
+    return success;
+}
+
+bool inc::assets::read_brdf_lut(const char* path, inc::assets::brdf_lut_data& out_lut, cc::allocator* alloc)
+{
+    std::FILE* const file = std::fopen(path, "rb");
+    if (file == nullptr)
+        return false;
+
+    brdf_lut_header header;
+    bool success = std::fread(&header, sizeof(header), 1, file) == 1 && header.magic == gc_brdf_lut_magic && header.version == gc_brdf_lut_version
+                   && header.width > 0 && header.height > 0;
+
+    if (success)
+    {
+        size_t const num_texel_values = size_t(header.width) * header.height * 2;
+        out_lut.texels = cc::alloc_array<uint16_t>::uninitialized(num_texel_values, alloc);
+        out_lut.width = header.width;
+        out_lut.height = header.height;
+        success = std::fread(out_lut.texels.data(), sizeof(uint16_t), num_texel_values, file) == num_texel_values;
+    }
+
+    std::fclose(file);
+    return success;
+}
+
+inc::assets::brdf_lut_data inc::assets::load_or_compute_brdf_lut(const char* path, unsigned width, unsigned height, cc::allocator* alloc)
+{
+    brdf_lut_data res;
+    if (read_brdf_lut(path, res, alloc) && res.width == width && res.height == height)
+        return res;
+
+    res = compute_brdf_lut(width, height, 1024, 0, alloc);
+
+    if (!write_brdf_lut(path, res))
+        std::fprintf(stderr, "[brdf_lut] failed to write cooked BRDF LUT %s\n", path);
+
+    return res;
+}
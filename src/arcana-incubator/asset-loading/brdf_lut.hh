@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+#include <clean-core/alloc_array.hh>
+
+namespace inc::assets
+{
+/// split-sum environment BRDF (Karis 2013), the scale (R) and bias (G) to F0 for GGX specular IBL
+/// x: N dot V, y: perceptual roughness, both at texel centers, (x + 0.5) / width and (y + 0.5) / height
+/// same parameterization as the brdf_lut_gen shader (importance sampled GGX, Smith-Schlick with k = roughness^2 / 2)
+struct brdf_lut_data
+{
+    cc::alloc_array<uint16_t> texels; // RG float16 (ie. format::rg16f), row-major, tightly packed
+    unsigned width = 0;
+    unsigned height = 0;
+};
+
+/// integrates the LUT on the CPU, rows are split across threads (0: hardware concurrency)
+/// the intended use is baking a cooked file once (offline or on first start), see write_brdf_lut
+/// alloc is only used on the calling thread (texels and samples), the per-thread scratch comes from the system allocator
+[[nodiscard]] brdf_lut_data compute_brdf_lut(
+    unsigned width, unsigned height, unsigned num_samples = 1024, unsigned max_num_threads = 0, cc::allocator* alloc = cc::system_allocator);
+
+/// cooked LUT file: a small header followed by the RG float16 texels
+[[nodiscard]] bool write_brdf_lut(char const* path, brdf_lut_data const& lut);
+
+/// returns false if the file is missing or invalid
+[[nodiscard]] bool read_brdf_lut(char const* path, brdf_lut_data& out_lut, cc::allocator* alloc = cc::system_allocator);
+
+/// reads the cooked file if it exists with the given size, otherwise computes the LUT and writes the file (best effort)
+[[nodiscard]] brdf_lut_data load_or_compute_brdf_lut(char const* path, unsigned width, unsigned height, cc::allocator* alloc = cc::system_allocator);
+}
@@ -1,10 +1,17 @@
 #include "image_loader.hh"
 
+#include <atomic>
+#include <cmath>
 #include <cstdint>
+#include <cstdio>
 #include <cstring>
+#include <thread>
+#include <type_traits>
 
+#include <clean-core/alloc_array.hh>
 #include <clean-core/assert.hh>
 #include <clean-core/bit_cast.hh>
+#include <clean-core/capped_vector.hh>
 #include <clean-core/utility.hh>
 
 #include <typed-geometry/tg.hh>
@@ -13,12 +20,34 @@
 
 #include <phantasm-hardware-interface/util.hh>
 
+#include "pixel_convert.hh"
+
 namespace
 {
-inc::assets::image_data load_image_internal(void* stbi_data, int w, int h, inc::assets::image_size& out_size, int desired_channels, bool use_hdr_float)
+// the allocator used by stb_image on this thread, nullptr for the system allocator
+thread_local cc::allocator* tl_stbi_allocator = nullptr;
+
+// allocations are prefixed with their size, STBI_REALLOC does not provide the previous size
+constexpr size_t gc_stbi_alloc_header_size = 16;
+
+constexpr unsigned gc_max_num_probe_threads = 32;
+
+cc::allocator* get_stbi_allocator() { return tl_stbi_allocator != nullptr ? tl_stbi_allocator : cc::system_allocator; }
+
+void fill_image_size(int w, int h, inc::assets::image_size& out_size)
+{
+    out_size.width = unsigned(w);
+    out_size.height = unsigned(h);
+    out_size.num_mipmaps = phi::util::get_num_mips(out_size.width, out_size.height);
+    out_size.array_size = 1;
+}
+
+inc::assets::image_data load_image_internal(
+    void* stbi_data, int w, int h, inc::assets::image_size& out_size, int desired_channels, bool use_hdr_float, cc::allocator* alloc)
 {
     inc::assets::image_data res;
     res.raw = stbi_data;
+    res.alloc = alloc;
     res.is_hdr = use_hdr_float;
     res.raw_size_bytes = w * h * desired_channels * (use_hdr_float ? sizeof(float) : sizeof(uint8_t));
 
@@ -26,40 +55,352 @@ inc::assets::image_data load_image_internal(void* stbi_data, int w, int h, inc::
         return res;
 
     res.num_channels = uint8_t(desired_channels);
-
-    out_size.width = unsigned(w);
-    out_size.height = unsigned(h);
-    out_size.num_mipmaps = phi::util::get_num_mips(out_size.width, out_size.height);
-    out_size.array_size = 1;
+    fill_image_size(w, h, out_size);
 
     return res;
 }
+
+// an image decoded by stb in its native channel count
+struct native_image
+{
+    void* data = nullptr;
+    int width = 0;
+    int height = 0;
+    int num_channels = 0;
+    bool is_float = false;
+};
+
+// identical to stbi__compute_y
+constexpr uint8_t compute_luminance(uint8_t r, uint8_t g, uint8_t b) { return uint8_t(((r * 77) + (g * 150) + (29 * b)) >> 8); }
+constexpr float compute_luminance(float r, float g, float b) { return (r * 77.f + g * 150.f + b * 29.f) / 256.f; }
+
+template <class T>
+constexpr T channel_max()
+{
+    if constexpr (std::is_same_v<T, float>)
+        return 1.f;
+    else
+        return T(255);
+}
+
+// converts a single pixel between channel counts with the same semantics as stbi__convert_format
+template <class T>
+void convert_pixel(T const* __restrict src, int src_channels, T* __restrict dest, int dest_channels)
+{
+    T r, g, b, a = channel_max<T>();
+    if (src_channels >= 3)
+    {
+        r = src[0];
+        g = src[1];
+        b = src[2];
+        if (src_channels == 4)
+            a = src[3];
+    }
+    else
+    {
+        r = g = b = src[0];
+        if (src_channels == 2)
+            a = src[1];
+    }
+
+    switch (dest_channels)
+    {
+    case 1:
+        dest[0] = src_channels >= 3 ? compute_luminance(r, g, b) : r;
+        break;
+    case 2:
+        dest[0] = src_channels >= 3 ? compute_luminance(r, g, b) : r;
+        dest[1] = a;
+        break;
+    case 3:
+        dest[0] = r;
+        dest[1] = g;
+        dest[2] = b;
+        break;
+    default:
+        dest[0] = r;
+        dest[1] = g;
+        dest[2] = b;
+        dest[3] = a;
+        break;
+    }
+}
+
+template <class T>
+void write_rows_converted(native_image const& img, std::byte* dest, unsigned dest_row_stride_bytes, int dest_channels)
+{
+    auto const* const src = static_cast<T const*>(img.data);
+    size_t const src_row_num_elems = size_t(img.width) * img.num_channels;
+
+    for (auto y = 0; y < img.height; ++y)
+    {
+        T const* const src_row = src + y * src_row_num_elems;
+        T* const dest_row = reinterpret_cast<T*>(dest + size_t(y) * dest_row_stride_bytes);
+
+        if (img.num_channels == dest_channels)
+        {
+            std::memcpy(dest_row, src_row, src_row_num_elems * sizeof(T));
+            continue;
+        }
+
+        if constexpr (std::is_same_v<T, uint8_t>)
+        {
+            // the common case for JPEGs and opaque PNGs
+            if (img.num_channels == 3 && dest_channels == 4)
+            {
+                inc::assets::convert_rgb_to_rgba(src_row, dest_row, size_t(img.width));
+                continue;
+            }
+        }
+
+        for (auto x = 0; x < img.width; ++x)
+            convert_pixel<T>(src_row + x * img.num_channels, img.num_channels, dest_row + x * dest_channels, dest_channels);
+    }
+}
+
+// LDR to float conversion, identical to stbi__ldr_to_hdr with default gamma and scale
+// color channels are linearized, alpha is kept linear
+void write_rows_ldr_to_float(native_image const& img, std::byte* dest, unsigned dest_row_stride_bytes, int dest_channels)
+{
+    struct ldr_to_hdr_lut
+    {
+        float values[256];
+
+        ldr_to_hdr_lut()
+        {
+            for (auto i = 0; i < 256; ++i)
+                values[i] = std::pow(float(i) / 255.f, 2.2f);
+        }
+    };
+    static ldr_to_hdr_lut const lut;
+
+    auto const* const src = static_cast<uint8_t const*>(img.data);
+    bool const dest_has_alpha = (dest_channels & 1) == 0;
+
+    for (auto y = 0; y < img.height; ++y)
+    {
+        uint8_t const* const src_row = src + size_t(y) * img.width * img.num_channels;
+        float* const dest_row = reinterpret_cast<float*>(dest + size_t(y) * dest_row_stride_bytes);
+
+        for (auto x = 0; x < img.width; ++x)
+        {
+            uint8_t pixel[4];
+            convert_pixel<uint8_t>(src_row + x * img.num_channels, img.num_channels, pixel, dest_channels);
+
+            float* const dest_pixel = dest_row + x * dest_channels;
+            for (auto c = 0; c < dest_channels; ++c)
+                dest_pixel[c] = lut.values[pixel[c]];
+
+            if (dest_has_alpha)
+                dest_pixel[dest_channels - 1] = float(pixel[dest_channels - 1]) / 255.f;
+        }
+    }
 }
 
-inc::assets::image_data inc::assets::load_image(cc::span<const std::byte> data, inc::assets::image_size& out_size, int desired_channels, bool use_hdr_float)
+template <class DecodeF>
+bool load_image_to_internal(DecodeF&& decode,
+                            bool src_is_hdr,
+                            std::byte* dest,
+                            unsigned dest_row_stride_bytes,
+                            inc::assets::image_size& out_size,
+                            int desired_channels,
+                            bool use_hdr_float,
+                            cc::allocator* scratch_alloc)
+{
+    CC_ASSERT(desired_channels >= 1 && desired_channels <= 4 && "invalid amount of channels");
+    inc::assets::detail::scoped_stbi_allocator const scoped_alloc(scratch_alloc);
+
+    native_image img;
+    if (use_hdr_float == src_is_hdr)
+    {
+        // decode in the native channel count, convert during the write
+        img = decode(0, use_hdr_float);
+    }
+    else
+    {
+        // HDR to LDR, rare case - let stb convert
+        // LDR to float is converted during the write
+        img = decode(use_hdr_float ? 0 : desired_channels, false);
+    }
+
+    if (img.data == nullptr)
+        return false;
+
+    if (img.is_float)
+        write_rows_converted<float>(img, dest, dest_row_stride_bytes, desired_channels);
+    else if (use_hdr_float)
+        write_rows_ldr_to_float(img, dest, dest_row_stride_bytes, desired_channels);
+    else
+        write_rows_converted<uint8_t>(img, dest, dest_row_stride_bytes, desired_channels);
+
+    ::stbi_image_free(img.data);
+    fill_image_size(img.width, img.height, out_size);
+    return true;
+}
+}
+
+inc::assets::image_data inc::assets::load_image(
+    cc::span<const std::byte> data, inc::assets::image_size& out_size, int desired_channels, bool use_hdr_float, cc::allocator* alloc)
 {
     int w, h, num_ch;
     void* stbi_data;
+    detail::scoped_stbi_allocator const scoped_alloc(alloc);
 
     if (use_hdr_float)
         stbi_data = ::stbi_loadf_from_memory(reinterpret_cast<stbi_uc const*>(data.data()), int(data.size()), &w, &h, &num_ch, desired_channels);
     else
         stbi_data = ::stbi_load_from_memory(reinterpret_cast<stbi_uc const*>(data.data()), int(data.size()), &w, &h, &num_ch, desired_channels);
 
-    return load_image_internal(stbi_data, w, h, out_size, desired_channels, use_hdr_float);
+    return load_image_internal(stbi_data, w, h, out_size, desired_channels, use_hdr_float, alloc);
 }
 
-inc::assets::image_data inc::assets::load_image(const char* filename, inc::assets::image_size& out_size, int desired_channels, bool use_hdr_float)
+inc::assets::image_data inc::assets::load_image(
+    const char* filename, inc::assets::image_size& out_size, int desired_channels, bool use_hdr_float, cc::allocator* alloc)
 {
     int w, h, num_ch;
     void* stbi_data;
+    detail::scoped_stbi_allocator const scoped_alloc(alloc);
 
     if (use_hdr_float)
         stbi_data = ::stbi_loadf(filename, &w, &h, &num_ch, desired_channels);
     else
         stbi_data = ::stbi_load(filename, &w, &h, &num_ch, desired_channels);
 
-    return load_image_internal(stbi_data, w, h, out_size, desired_channels, use_hdr_float);
+    return load_image_internal(stbi_data, w, h, out_size, desired_channels, use_hdr_float, alloc);
+}
+
+bool inc::assets::get_image_size(cc::span<const std::byte> data, inc::assets::image_size& out_size)
+{
+    image_info info;
+    if (!probe_image(data, info))
+        return false;
+
+    out_size = info.size;
+    return true;
+}
+
+bool inc::assets::get_image_size(const char* filename, inc::assets::image_size& out_size)
+{
+    image_info info;
+    if (!probe_image(filename, info))
+        return false;
+
+    out_size = info.size;
+    return true;
+}
+
+bool inc::assets::probe_image(cc::span<const std::byte> data, inc::assets::image_info& out_info)
+{
+    auto const* const buffer = reinterpret_cast<stbi_uc const*>(data.data());
+    int const buffer_size = int(data.size());
+
+    int w, h, num_ch;
+    if (!::stbi_info_from_memory(buffer, buffer_size, &w, &h, &num_ch))
+        return false;
+
+    fill_image_size(w, h, out_info.size);
+    out_info.num_channels = unsigned(num_ch);
+    out_info.is_hdr = ::stbi_is_hdr_from_memory(buffer, buffer_size) != 0;
+    out_info.is_16_bit = ::stbi_is_16_bit_from_memory(buffer, buffer_size) != 0;
+    return true;
+}
+
+bool inc::assets::probe_image(const char* filename, inc::assets::image_info& out_info)
+{
+    // a single open, the stbi_*_from_file functions restore the file position
+    std::FILE* const file = std::fopen(filename, "rb");
+    if (!file)
+        return false;
+
+    int w, h, num_ch;
+    bool const success = ::stbi_info_from_file(file, &w, &h, &num_ch) != 0;
+    if (success)
+    {
+        fill_image_size(w, h, out_info.size);
+        out_info.num_channels = unsigned(num_ch);
+        out_info.is_hdr = ::stbi_is_hdr_from_file(file) != 0;
+        out_info.is_16_bit = ::stbi_is_16_bit_from_file(file) != 0;
+    }
+
+    std::fclose(file);
+    return success;
+}
+
+unsigned inc::assets::probe_images(cc::span<char const* const> filenames, cc::span<inc::assets::image_info> out_infos, unsigned max_num_threads)
+{
+    CC_ASSERT(filenames.size() == out_infos.size() && "one output info per file required");
+
+    // files are picked one by one, probe times vary a lot with the file system
+    std::atomic<size_t> next_index = {0};
+    std::atomic<unsigned> num_successful = {0};
+
+    auto const f_worker = [&] {
+        for (auto i = next_index++; i < filenames.size(); i = next_index++)
+        {
+            out_infos[i] = image_info{};
+            if (probe_image(filenames[i], out_infos[i]))
+                ++num_successful;
+        }
+    };
+
+    unsigned num_threads = max_num_threads > 0 ? max_num_threads : cc::max(1u, std::thread::hardware_concurrency());
+    num_threads = unsigned(cc::min<size_t>(cc::min(num_threads, gc_max_num_probe_threads), filenames.size()));
+
+    cc::capped_vector<std::thread, gc_max_num_probe_threads> workers;
+    for (auto i = 1u; i < num_threads; ++i)
+        workers.emplace_back(f_worker);
+
+    f_worker();
+
+    for (auto& worker : workers)
+        worker.join();
+
+    return num_successful;
+}
+
+bool inc::assets::load_image_to(
+    cc::span<const std::byte> data, std::byte* dest, unsigned dest_row_stride_bytes, inc::assets::image_size& out_size, int desired_channels, bool use_hdr_float, cc::allocator* scratch_alloc)
+{
+    auto const* const buffer = reinterpret_cast<stbi_uc const*>(data.data());
+    int const buffer_size = int(data.size());
+
+    auto const f_decode = [&](int req_channels, bool as_float) -> native_image
+    {
+        native_image res;
+        res.is_float = as_float;
+        if (as_float)
+            res.data = ::stbi_loadf_from_memory(buffer, buffer_size, &res.width, &res.height, &res.num_channels, req_channels);
+        else
+            res.data = ::stbi_load_from_memory(buffer, buffer_size, &res.width, &res.height, &res.num_channels, req_channels);
+
+        if (req_channels != 0)
+            res.num_channels = req_channels;
+        return res;
+    };
+
+    bool const is_hdr = ::stbi_is_hdr_from_memory(buffer, buffer_size) != 0;
+    return load_image_to_internal(f_decode, is_hdr, dest, dest_row_stride_bytes, out_size, desired_channels, use_hdr_float, scratch_alloc);
+}
+
+bool inc::assets::load_image_to(
+    const char* filename, std::byte* dest, unsigned dest_row_stride_bytes, inc::assets::image_size& out_size, int desired_channels, bool use_hdr_float, cc::allocator* scratch_alloc)
+{
+    auto const f_decode = [&](int req_channels, bool as_float) -> native_image
+    {
+        native_image res;
+        res.is_float = as_float;
+        if (as_float)
+            res.data = ::stbi_loadf(filename, &res.width, &res.height, &res.num_channels, req_channels);
+        else
+            res.data = ::stbi_load(filename, &res.width, &res.height, &res.num_channels, req_channels);
+
+        if (req_channels != 0)
+            res.num_channels = req_channels;
+        return res;
+    };
+
+    bool const is_hdr = ::stbi_is_hdr(filename) != 0;
+    return load_image_to_internal(f_decode, is_hdr, dest, dest_row_stride_bytes, out_size, desired_channels, use_hdr_float, scratch_alloc);
 }
 
 void inc::assets::rowwise_copy(std::byte const* __restrict src, std::byte* __restrict dest, unsigned dest_row_stride_bytes, unsigned row_size_bytes, unsigned height_pixels)
@@ -73,35 +414,87 @@ void inc::assets::rowwise_copy(std::byte const* __restrict src, std::byte* __res
 void inc::assets::free(const inc::assets::image_data& data)
 {
     if (data.raw)
+    {
+        detail::scoped_stbi_allocator const scoped_alloc(data.alloc);
         ::stbi_image_free(data.raw);
+    }
+}
+
+inc::assets::detail::scoped_stbi_allocator::scoped_stbi_allocator(cc::allocator* alloc) : _prev_alloc(tl_stbi_allocator)
+{
+    tl_stbi_allocator = alloc;
+}
+
+inc::assets::detail::scoped_stbi_allocator::~scoped_stbi_allocator() { tl_stbi_allocator = _prev_alloc; }
+
+void* inc::assets::detail::stbi_hook_malloc(size_t size)
+{
+    std::byte* const header = get_stbi_allocator()->alloc(size + gc_stbi_alloc_header_size, gc_stbi_alloc_header_size);
+    if (header == nullptr)
+        return nullptr;
+
+    std::memcpy(header, &size, sizeof(size));
+    return header + gc_stbi_alloc_header_size;
+}
+
+void* inc::assets::detail::stbi_hook_realloc(void* ptr, size_t new_size)
+{
+    if (ptr == nullptr)
+        return stbi_hook_malloc(new_size);
+
+    std::byte* const old_header = static_cast<std::byte*>(ptr) - gc_stbi_alloc_header_size;
+    size_t old_size;
+    std::memcpy(&old_size, old_header, sizeof(old_size));
+
+    std::byte* const new_header
+        = get_stbi_allocator()->realloc(old_header, old_size + gc_stbi_alloc_header_size, new_size + gc_stbi_alloc_header_size, gc_stbi_alloc_header_size);
+    if (new_header == nullptr)
+        return nullptr;
+
+    std::memcpy(new_header, &new_size, sizeof(new_size));
+    return new_header + gc_stbi_alloc_header_size;
+}
+
+void inc::assets::detail::stbi_hook_free(void* ptr)
+{
+    if (ptr == nullptr)
+        return;
+
+    get_stbi_allocator()->free(static_cast<std::byte*>(ptr) - gc_stbi_alloc_header_size);
 }
 
 void inc::assets::write_mipmap(image_data& src_and_dest, unsigned width, unsigned height)
 {
     CC_RUNTIME_ASSERT(!src_and_dest.is_hdr && "HDR mipmap generation unimplemented");
-    constexpr unsigned offsetsX[] = {0, 1, 0, 1};
-    constexpr unsigned offsetsY[] = {0, 0, 1, 1};
+    CC_ASSERT(width >= 2 && height >= 2 && "mip too small");
+
+    unsigned const num_channels = unsigned(src_and_dest.num_channels);
+    unsigned const dest_width = width / 2;
+    size_t const num_row_values = size_t(width) * num_channels;
 
-    auto const get_byte = [](auto color, int component) { return (color >> (8 * component)) & 0xff; };
-    auto const get_color = [width](auto const* img_data, unsigned x, unsigned y) -> uint32_t { return img_data[x + y * width]; };
-    auto const set_color = [width](auto* img_data, unsigned x, unsigned y, auto color) -> void { img_data[x + y * width / 2] = color; };
+    // two source rows in float, the destination row reuses the first one
+    auto rows = cc::alloc_array<float>::uninitialized(num_row_values * 2, cc::system_allocator);
+    float* const row_a = rows.data();
+    float* const row_b = rows.data() + num_row_values;
 
-    auto* const image_data = static_cast<uint32_t*>(src_and_dest.raw);
+    auto* const image_data = static_cast<uint8_t*>(src_and_dest.raw);
 
-    for (auto y = 0u; y < height; y += 2)
+    for (auto y = 0u; y + 1 < height; y += 2)
     {
-        for (auto x = 0u; x < width; x += 2)
+        convert_unorm8_to_float(image_data + y * num_row_values, row_a, width, num_channels);
+        convert_unorm8_to_float(image_data + (y + 1) * num_row_values, row_b, width, num_channels);
+
+        // average over the four pixels, in place in row_a: source pixels 2x and 2x+1 are read before pixel x is overwritten
+        for (auto x = 0u; x < dest_width; ++x)
         {
-            uint32_t color = 0;
-            for (auto c = 0; c < src_and_dest.num_channels; ++c)
+            for (auto c = 0u; c < num_channels; ++c)
             {
-                // average over the four pixels
-                uint32_t color_component = 0;
-                for (auto i = 0; i < 4; ++i)
-                    color_component += get_byte(get_color(image_data, x + offsetsX[i], y + offsetsY[i]), (src_and_dest.num_channels - 1) - c);
-                color = (color << 8) | (color_component / 4);
+                size_t const i = size_t(x) * 2 * num_channels + c;
+                row_a[x * num_channels + c] = (row_a[i] + row_a[i + num_channels] + row_b[i] + row_b[i + num_channels]) * 0.25f;
             }
-            set_color(image_data, x / 2, y / 2, color);
         }
+
+        // the destination row lies before the source rows just read, writing in place is safe
+        convert_float_to_unorm8(row_a, image_data + (y / 2) * size_t(dest_width) * num_channels, dest_width, num_channels);
     }
 }
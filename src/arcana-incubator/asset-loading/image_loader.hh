@@ -3,6 +3,7 @@
 #include <cstddef>
 #include <cstdint>
 
+#include <clean-core/allocator.hh>
 #include <clean-core/span.hh>
 
 namespace inc::assets
@@ -21,20 +22,90 @@ struct image_data
     size_t raw_size_bytes;
     uint8_t num_channels;
     bool is_hdr;
+    cc::allocator* alloc = cc::system_allocator; // the allocator used to decode this image, and to free it
 };
 
 [[nodiscard]] constexpr inline bool is_valid(image_data const& data) { return data.raw != nullptr; }
 
-[[nodiscard]] image_data load_image(cc::span<std::byte const> data, image_size& out_size, int desired_channels = 4, bool use_hdr_float = false);
+/// decodes an image, all allocations of the decoder (temporaries and the result) are made from alloc
+/// a linear allocator absorbs all decoder temporaries and can be reset in one go after the image is consumed
+[[nodiscard]] image_data load_image(
+    cc::span<std::byte const> data, image_size& out_size, int desired_channels = 4, bool use_hdr_float = false, cc::allocator* alloc = cc::system_allocator);
 
-[[nodiscard]] image_data load_image(char const* filename, image_size& out_size, int desired_channels = 4, bool use_hdr_float = false);
+[[nodiscard]] image_data load_image(
+    char const* filename, image_size& out_size, int desired_channels = 4, bool use_hdr_float = false, cc::allocator* alloc = cc::system_allocator);
+
+/// reads the dimensions of an encoded image without decoding it
+[[nodiscard]] bool get_image_size(cc::span<std::byte const> data, image_size& out_size);
+[[nodiscard]] bool get_image_size(char const* filename, image_size& out_size);
+
+struct image_info
+{
+    image_size size = {};      // num_mipmaps is the full chain
+    unsigned num_channels = 0; // channels stored in the file
+    bool is_hdr = false;       // stored as float (ie. .hdr), decode with use_hdr_float
+    bool is_16_bit = false;    // stored with 16 bit per channel
+};
+
+/// reads size, channel count and HDR-ness from the header of an encoded image, without decoding it
+/// only the header is parsed, for files this reads the first few KB
+[[nodiscard]] bool probe_image(cc::span<std::byte const> data, image_info& out_info);
+[[nodiscard]] bool probe_image(char const* filename, image_info& out_info);
+
+/// probes many image files across threads (0: hardware concurrency)
+/// out_infos must have one element per path, failed probes result in a default image_info (width 0)
+/// returns the amount of successfully probed images
+unsigned probe_images(cc::span<char const* const> filenames, cc::span<image_info> out_infos, unsigned max_num_threads = 0);
+
+/// decodes an image directly to a destination pointer, with a stride per row (ie. a mapped upload buffer)
+/// conversion to desired_channels and to float are fused into the row writes, no intermediate full-image copy is made
+/// dest must hold height rows of dest_row_stride_bytes (query the size with get_image_size)
+/// decoder temporaries are allocated from scratch_alloc
+[[nodiscard]] bool load_image_to(cc::span<std::byte const> data,
+                                 std::byte* dest,
+                                 unsigned dest_row_stride_bytes,
+                                 image_size& out_size,
+                                 int desired_channels = 4,
+                                 bool use_hdr_float = false,
+                                 cc::allocator* scratch_alloc = cc::system_allocator);
+
+[[nodiscard]] bool load_image_to(char const* filename,
+                                 std::byte* dest,
+                                 unsigned dest_row_stride_bytes,
+                                 image_size& out_size,
+                                 int desired_channels = 4,
+                                 bool use_hdr_float = false,
+                                 cc::allocator* scratch_alloc = cc::system_allocator);
 
 /// copy an image row-by-row to a destination pointer, with a stride per row
 /// (usually equal to row_size_bytes, but not in D3D12)
 void rowwise_copy(const std::byte* __restrict src, std::byte* __restrict dest, unsigned dest_row_stride_bytes, unsigned row_size_bytes, unsigned height_pixels);
 
+/// halves an LDR image of any channel count in place with a 2x2 box filter, width and height are of the source level
 void write_mipmap(inc::assets::image_data& src_and_dest, unsigned width, unsigned height);
 
+// frees the image to the allocator it was decoded with
 void free(image_data const& data);
 
+namespace detail
+{
+// sets the allocator used by stb_image on this thread for the lifetime of this object
+struct scoped_stbi_allocator
+{
+    explicit scoped_stbi_allocator(cc::allocator* alloc);
+    ~scoped_stbi_allocator();
+
+    scoped_stbi_allocator(scoped_stbi_allocator const&) = delete;
+    scoped_stbi_allocator& operator=(scoped_stbi_allocator const&) = delete;
+
+private:
+    cc::allocator* _prev_alloc;
+};
+
+// STBI_MALLOC, STBI_REALLOC and STBI_FREE
+void* stbi_hook_malloc(size_t size);
+void* stbi_hook_realloc(void* ptr, size_t new_size);
+void stbi_hook_free(void* ptr);
+}
+
 }
@@ -0,0 +1,391 @@
+#include "image_resize.hh"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+#include <clean-core/alloc_array.hh>
+#include <clean-core/assert.hh>
+#include <clean-core/capped_vector.hh>
+#include <clean-core/utility.hh>
+
+#include <phantasm-hardware-interface/util.hh>
+
+#include "pixel_convert.hh"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define INC_IMAGE_RESIZE_SSE 1
+#include <xmmintrin.h>
+#else
+#define INC_IMAGE_RESIZE_SSE 0
+#endif
+
+namespace
+{
+constexpr unsigned gc_max_num_threads = 32;
+constexpr size_t gc_min_pixels_per_thread = 64 * 1024;
+constexpr double gc_pi = 3.14159265358979323846;
+constexpr double gc_filter_radius = 3.0;
+constexpr double gc_kaiser_beta = 4.0;
+
+double sinc(double x)
+{
+    if (std::abs(x) < 1e-8)
+        return 1.0;
+
+    return std::sin(gc_pi * x) / (gc_pi * x);
+}
+
+// modified bessel function of the first kind, order 0
+double bessel_i0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (auto k = 1; k < 32; ++k)
+    {
+        double const t = x / (2.0 * k);
+        term *= t * t;
+        sum += term;
+        if (term < sum * 1e-12)
+            break;
+    }
+
+    return sum;
+}
+
+double evaluate_filter(inc::assets::resample_filter filter, double x)
+{
+    x = std::abs(x);
+    if (x >= gc_filter_radius)
+        return 0.0;
+
+    switch (filter)
+    {
+    case inc::assets::resample_filter::lanczos3:
+        return sinc(x) * sinc(x / gc_filter_radius);
+    case inc::assets::resample_filter::kaiser:
+    {
+        double const r = x / gc_filter_radius;
+        return sinc(x) * bessel_i0(gc_kaiser_beta * std::sqrt(1.0 - r * r)) / bessel_i0(gc_kaiser_beta);
+    }
+    }
+
+    return 0.0;
+}
+
+// the filter taps of each destination texel along one axis
+struct axis_weights
+{
+    cc::alloc_array<unsigned> first_tap;
+    cc::alloc_array<unsigned> num_taps;
+    cc::alloc_array<float> weights; // max_num_taps per destination texel
+    unsigned max_num_taps = 0;
+
+    float const* get_weights(unsigned i) const { return weights.data() + size_t(i) * max_num_taps; }
+};
+
+void compute_axis_weights(axis_weights& out, unsigned src_size, unsigned dest_size, inc::assets::resample_filter filter, cc::allocator* alloc)
+{
+    double const scale = double(dest_size) / src_size;
+
+    // when minifying, the filter is stretched to cover the source texels of each destination texel
+    double const filter_scale = cc::min(scale, 1.0);
+    double const support = gc_filter_radius / filter_scale;
+
+    out.max_num_taps = unsigned(std::ceil(support * 2)) + 2;
+    out.first_tap = cc::alloc_array<unsigned>::uninitialized(dest_size, alloc);
+    out.num_taps = cc::alloc_array<unsigned>::uninitialized(dest_size, alloc);
+    out.weights = cc::alloc_array<float>::filled(size_t(dest_size) * out.max_num_taps, 0.f, alloc);
+
+    for (auto i = 0u; i < dest_size; ++i)
+    {
+        double const center = (i + 0.5) / scale;
+        int const first = cc::max(0, int(std::floor(center - support)));
+        int const last = cc::min(int(src_size) - 1, int(std::ceil(center + support)));
+
+        float* const weights = out.weights.data() + size_t(i) * out.max_num_taps;
+        double weight_sum = 0.0;
+        unsigned num_taps = 0;
+
+        for (auto j = first; j <= last && num_taps < out.max_num_taps; ++j)
+        {
+            double const w = evaluate_filter(filter, (j + 0.5 - center) * filter_scale);
+            weights[num_taps++] = float(w);
+            weight_sum += w;
+        }
+
+        // renormalize, this also clamps the filter at the image borders
+        CC_ASSERT(weight_sum > 0.0 && "degenerate filter");
+        for (auto k = 0u; k < num_taps; ++k)
+            weights[k] = float(weights[k] / weight_sum);
+
+        out.first_tap[i] = unsigned(first);
+        out.num_taps[i] = num_taps;
+    }
+}
+
+struct resize_job
+{
+    std::byte const* src = nullptr;
+    std::byte* dest = nullptr;
+    unsigned src_width = 0;
+    unsigned src_height = 0;
+    unsigned dest_width = 0;
+    unsigned dest_height = 0;
+    unsigned num_channels = 0;
+    bool is_hdr = false;
+    bool is_srgb = false;
+
+    axis_weights weights_x;
+    axis_weights weights_y;
+};
+
+// converts a source row to float
+void load_row(resize_job const& job, unsigned y, float* out_row)
+{
+    size_t const num_values = size_t(job.src_width) * job.num_channels;
+
+    if (job.is_hdr)
+    {
+        std::memcpy(out_row, job.src + y * num_values * sizeof(float), num_values * sizeof(float));
+        return;
+    }
+
+    auto const* const src = reinterpret_cast<uint8_t const*>(job.src) + y * num_values;
+    inc::assets::convert_unorm8_to_float(src, out_row, job.src_width, job.num_channels, job.is_srgb);
+}
+
+// converts a float row to the destination format
+void store_row(resize_job const& job, unsigned y, float const* row)
+{
+    size_t const num_values = size_t(job.dest_width) * job.num_channels;
+
+    if (job.is_hdr)
+    {
+        std::memcpy(job.dest + y * num_values * sizeof(float), row, num_values * sizeof(float));
+        return;
+    }
+
+    auto* const dest = reinterpret_cast<uint8_t*>(job.dest) + y * num_values;
+    inc::assets::convert_float_to_unorm8(row, dest, job.dest_width, job.num_channels, job.is_srgb);
+}
+
+void filter_row_horizontal(resize_job const& job, float const* src_row, float* dest_row)
+{
+    unsigned const num_channels = job.num_channels;
+
+#if INC_IMAGE_RESIZE_SSE
+    if (num_channels == 4)
+    {
+        for (auto x = 0u; x < job.dest_width; ++x)
+        {
+            float const* const weights = job.weights_x.get_weights(x);
+            float const* src = src_row + size_t(job.weights_x.first_tap[x]) * 4;
+
+            __m128 acc = _mm_setzero_ps();
+            for (auto k = 0u; k < job.weights_x.num_taps[x]; ++k, src += 4)
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(src), _mm_set1_ps(weights[k])));
+
+            _mm_storeu_ps(dest_row + size_t(x) * 4, acc);
+        }
+        return;
+    }
+#endif
+
+    for (auto x = 0u; x < job.dest_width; ++x)
+    {
+        float const* const weights = job.weights_x.get_weights(x);
+        float const* const src = src_row + size_t(job.weights_x.first_tap[x]) * num_channels;
+
+        for (auto c = 0u; c < num_channels; ++c)
+        {
+            float acc = 0.f;
+            for (auto k = 0u; k < job.weights_x.num_taps[x]; ++k)
+                acc += src[k * num_channels + c] * weights[k];
+
+            dest_row[size_t(x) * num_channels + c] = acc;
+        }
+    }
+}
+
+// dest_row += src_row * weight
+void accumulate_row(float* __restrict dest_row, float const* __restrict src_row, float weight, size_t num_values)
+{
+    size_t i = 0;
+
+#if INC_IMAGE_RESIZE_SSE
+    __m128 const w = _mm_set1_ps(weight);
+    for (; i + 4 <= num_values; i += 4)
+        _mm_storeu_ps(dest_row + i, _mm_add_ps(_mm_loadu_ps(dest_row + i), _mm_mul_ps(_mm_loadu_ps(src_row + i), w)));
+#endif
+
+    for (; i < num_values; ++i)
+        dest_row[i] += src_row[i] * weight;
+}
+
+// resamples destination rows [row_start, row_end)
+// the horizontally filtered source rows are kept in a ring of weights_y.max_num_taps rows, the taps of a destination row
+// are consecutive and never move backwards, so each source row is filtered once per thread (rows at range borders twice)
+void run_rows(resize_job const& job, unsigned row_start, unsigned row_end)
+{
+    if (row_start >= row_end)
+        return;
+
+    size_t const src_row_size = size_t(job.src_width) * job.num_channels;
+    size_t const row_size = size_t(job.dest_width) * job.num_channels;
+    unsigned const ring_size = job.weights_y.max_num_taps;
+
+    // thread-local scratch, from the system allocator as the caller's allocator may not be thread safe
+    auto src_row = cc::alloc_array<float>::uninitialized(src_row_size);
+    auto ring = cc::alloc_array<float>::uninitialized(size_t(ring_size) * row_size);
+    auto row = cc::alloc_array<float>::uninitialized(row_size);
+
+    auto const f_get_ring_row = [&](unsigned src_y) { return ring.data() + size_t(src_y % ring_size) * row_size; };
+
+    // source rows below next_src_row have been filtered, the last ring_size of them are in the ring
+    unsigned next_src_row = job.weights_y.first_tap[row_start];
+
+    for (auto y = row_start; y < row_end; ++y)
+    {
+        unsigned const first_tap = job.weights_y.first_tap[y];
+        unsigned const num_taps = job.weights_y.num_taps[y];
+        CC_ASSERT(num_taps <= ring_size && first_tap + ring_size >= next_src_row && "taps moved backwards");
+
+        next_src_row = cc::max(next_src_row, first_tap);
+        for (; next_src_row < first_tap + num_taps; ++next_src_row)
+        {
+            load_row(job, next_src_row, src_row.data());
+            filter_row_horizontal(job, src_row.data(), f_get_ring_row(next_src_row));
+        }
+
+        std::memset(row.data(), 0, row_size * sizeof(float));
+
+        float const* const weights = job.weights_y.get_weights(y);
+        for (auto k = 0u; k < num_taps; ++k)
+            accumulate_row(row.data(), f_get_ring_row(first_tap + k), weights[k], row_size);
+
+        store_row(job, y, row.data());
+    }
+}
+
+unsigned floor_pow2(unsigned value)
+{
+    unsigned res = 1;
+    while (res <= value / 2)
+        res *= 2;
+    return res;
+}
+
+template <class F>
+void run_parallel(unsigned num_rows, unsigned num_threads, F&& f)
+{
+    num_threads = cc::max(1u, cc::min(num_threads, num_rows));
+    if (num_threads == 1)
+    {
+        f(0u, num_rows);
+        return;
+    }
+
+    unsigned const rows_per_thread = (num_rows + num_threads - 1) / num_threads;
+
+    cc::capped_vector<std::thread, gc_max_num_threads> workers;
+    for (auto i = 1u; i < num_threads; ++i)
+    {
+        unsigned const start = i * rows_per_thread;
+        unsigned const end = cc::min(start + rows_per_thread, num_rows);
+        if (start >= end)
+            break;
+
+        workers.emplace_back([&f, start, end] { f(start, end); });
+    }
+
+    // the calling thread takes the first range
+    f(0u, cc::min(rows_per_thread, num_rows));
+
+    for (auto& worker : workers)
+        worker.join();
+}
+}
+
+inc::assets::image_size inc::assets::get_capped_image_size(const inc::assets::image_size& size, unsigned max_dimension, bool round_down_to_pow2)
+{
+    unsigned const largest_side = cc::max(size.width, size.height);
+
+    image_size res = size;
+    if (max_dimension > 0 && largest_side > max_dimension)
+    {
+        double const scale = double(max_dimension) / largest_side;
+        res.width = cc::max(1u, unsigned(size.width * scale + 0.5));
+        res.height = cc::max(1u, unsigned(size.height * scale + 0.5));
+    }
+
+    if (round_down_to_pow2)
+    {
+        res.width = floor_pow2(res.width);
+        res.height = floor_pow2(res.height);
+    }
+
+    if (res.width != size.width || res.height != size.height)
+        res.num_mipmaps = phi::util::get_num_mips(res.width, res.height);
+
+    return res;
+}
+
+inc::assets::image_data inc::assets::resize_image(const inc::assets::image_data& src,
+                                                  const inc::assets::image_size& src_size,
+                                                  unsigned dest_width,
+                                                  unsigned dest_height,
+                                                  inc::assets::image_size& out_size,
+                                                  inc::assets::resample_filter filter,
+                                                  bool is_srgb,
+                                                  unsigned max_num_threads,
+                                                  cc::allocator* alloc)
+{
+    CC_ASSERT(is_valid(src) && src_size.array_size <= 1 && "invalid source image");
+    CC_ASSERT(dest_width > 0 && dest_height > 0 && "invalid destination size");
+
+    size_t const value_size = src.is_hdr ? sizeof(float) : sizeof(uint8_t);
+
+    image_data res;
+    res.num_channels = src.num_channels;
+    res.is_hdr = src.is_hdr;
+    res.alloc = alloc;
+    res.raw_size_bytes = size_t(dest_width) * dest_height * src.num_channels * value_size;
+    {
+        // allocated like decoder results, so assets::free applies
+        detail::scoped_stbi_allocator const scoped_alloc(alloc);
+        res.raw = detail::stbi_hook_malloc(res.raw_size_bytes);
+    }
+
+    if (!res.raw)
+        return res;
+
+    out_size.width = dest_width;
+    out_size.height = dest_height;
+    out_size.num_mipmaps = phi::util::get_num_mips(dest_width, dest_height);
+    out_size.array_size = 1;
+
+    resize_job job;
+    job.src = static_cast<std::byte const*>(src.raw);
+    job.dest = static_cast<std::byte*>(res.raw);
+    job.src_width = src_size.width;
+    job.src_height = src_size.height;
+    job.dest_width = dest_width;
+    job.dest_height = dest_height;
+    job.num_channels = src.num_channels;
+    job.is_hdr = src.is_hdr;
+    job.is_srgb = is_srgb;
+
+    compute_axis_weights(job.weights_x, src_size.width, dest_width, filter, alloc);
+    compute_axis_weights(job.weights_y, src_size.height, dest_height, filter, alloc);
+
+    unsigned num_threads = max_num_threads > 0 ? max_num_threads : cc::max(1u, std::thread::hardware_concurrency());
+    num_threads = cc::min(num_threads, gc_max_num_threads);
+    num_threads = unsigned(cc::min<size_t>(num_threads, cc::max<size_t>(1, size_t(src_size.width) * src_size.height / gc_min_pixels_per_thread)));
+
+    // both passes per destination row, no full-size intermediate image
+    run_parallel(dest_height, num_threads, [&](unsigned start, unsigned end) { run_rows(job, start, end); });
+
+    return res;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <clean-core/allocator.hh>
+
+#include "image_loader.hh"
+
+namespace inc::assets
+{
+enum class resample_filter
+{
+    lanczos3, // sharp, slight ringing
+    kaiser,   // kaiser-windowed sinc, less ringing
+};
+
+/// the largest size with neither side above max_dimension, keeping the aspect ratio (0: no limit)
+/// round_down_to_pow2: each side is rounded down to a power of two afterwards, ie. for mip generation that requires it
+/// (square power of two sizes stay square)
+[[nodiscard]] image_size get_capped_image_size(image_size const& size, unsigned max_dimension, bool round_down_to_pow2 = false);
+
+/// resamples an image to a new size using a separable windowed sinc filter, destination rows are split across threads
+/// each thread keeps a small ring of horizontally filtered rows (the vertical filter taps), not a full-size intermediate
+/// works for LDR and float images with any amount of channels, the result has the same format as the source
+/// is_srgb: filter LDR color channels in linear space (alpha is always linear)
+/// the result is allocated from alloc, free it with assets::free
+[[nodiscard]] image_data resize_image(image_data const& src,
+                                      image_size const& src_size,
+                                      unsigned dest_width,
+                                      unsigned dest_height,
+                                      image_size& out_size,
+                                      resample_filter filter = resample_filter::lanczos3,
+                                      bool is_srgb = false,
+                                      unsigned max_num_threads = 0,
+                                      cc::allocator* alloc = cc::system_allocator);
+}
@@ -2,6 +2,13 @@
 
 #define STBI_ASSERT(_arg_) CC_ASSERT(_arg_)
 
+// route allocations through the allocator set by inc::assets::detail::scoped_stbi_allocator
+#include <arcana-incubator/asset-loading/image_loader.hh>
+
+#define STBI_MALLOC(_size_) inc::assets::detail::stbi_hook_malloc(_size_)
+#define STBI_REALLOC(_ptr_, _new_size_) inc::assets::detail::stbi_hook_realloc(_ptr_, _new_size_)
+#define STBI_FREE(_ptr_) inc::assets::detail::stbi_hook_free(_ptr_)
+
 #include "stb_image.hh"
 
 #if defined(STBI_ONLY_JPEG) || defined(STBI_ONLY_PNG) || defined(STBI_ONLY_BMP) || defined(STBI_ONLY_TGA) || defined(STBI_ONLY_GIF) \
@@ -0,0 +1,7 @@
+#include <clean-core/assert.hh>
+
+#define STBRP_ASSERT(_arg_) CC_ASSERT(_arg_)
+
+// the instance in imgui_draw.cpp is static, this one is used by inc::assets
+#define STB_RECT_PACK_IMPLEMENTATION
+#include <arcana-incubator/imgui/lib/imstb_rectpack.h>
@@ -0,0 +1,833 @@
+#include "pixel_convert.hh"
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define INC_PIXEL_CONVERT_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define INC_TARGET_SSSE3
+#define INC_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define INC_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define INC_TARGET_AVX2 __attribute__((target("avx2,f16c")))
+#endif
+#else
+#define INC_PIXEL_CONVERT_X86 0
+#endif
+
+namespace
+{
+using inc::assets::pixel_isa;
+
+inc::assets::pixel_isa detect_isa()
+{
+#if INC_PIXEL_CONVERT_X86
+    // eax, ebx, ecx, edx of cpuid leaf 1 and 7
+    unsigned leaf1[4] = {};
+    unsigned leaf7[4] = {};
+    unsigned long long xcr0 = 0;
+
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    int const max_leaf = info[0];
+
+    __cpuid(info, 1);
+    std::memcpy(leaf1, info, sizeof(leaf1));
+
+    if (max_leaf >= 7)
+    {
+        __cpuidex(info, 7, 0);
+        std::memcpy(leaf7, info, sizeof(leaf7));
+    }
+
+    if ((leaf1[2] >> 27) & 1)
+        xcr0 = _xgetbv(0);
+#else
+    unsigned const max_leaf = __get_cpuid_max(0, nullptr);
+    __cpuid(1, leaf1[0], leaf1[1], leaf1[2], leaf1[3]);
+
+    if (max_leaf >= 7)
+        __cpuid_count(7, 0, leaf7[0], leaf7[1], leaf7[2], leaf7[3]);
+
+    if ((leaf1[2] >> 27) & 1)
+    {
+        unsigned xcr0_lo, xcr0_hi;
+        __asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+        xcr0 = (static_cast<unsigned long long>(xcr0_hi) << 32) | xcr0_lo;
+    }
+#endif
+
+    bool const has_ssse3 = (leaf1[2] >> 9) & 1;
+    bool const has_avx = (leaf1[2] >> 28) & 1;
+    bool const has_f16c = (leaf1[2] >> 29) & 1;
+    bool const has_avx2 = (leaf7[1] >> 5) & 1;
+    bool const os_saves_ymm = (xcr0 & 0x6) == 0x6;
+
+    if (has_avx && has_avx2 && has_f16c && os_saves_ymm)
+        return pixel_isa::avx2;
+
+    if (has_ssse3)
+        return pixel_isa::ssse3;
+#endif
+
+    return pixel_isa::scalar;
+}
+
+struct isa_state
+{
+    pixel_isa supported;
+    std::atomic<pixel_isa> active;
+
+    isa_state() : supported(detect_isa()), active(supported) {}
+};
+
+isa_state& get_isa_state()
+{
+    static isa_state state;
+    return state;
+}
+
+pixel_isa get_active_isa() { return get_isa_state().active.load(std::memory_order_relaxed); }
+
+struct srgb_tables
+{
+    float to_linear[256];
+    int32_t to_srgb[4096]; // int32 to allow gathers
+
+    srgb_tables()
+    {
+        for (auto i = 0; i < 256; ++i)
+        {
+            double const v = i / 255.0;
+            to_linear[i] = float(v <= 0.04045 ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4));
+        }
+
+        for (auto i = 0; i < 4096; ++i)
+        {
+            double const v = i / 4095.0;
+            double const s = v <= 0.0031308 ? v * 12.92 : 1.055 * std::pow(v, 1.0 / 2.4) - 0.055;
+            int const q = int(s * 255.0 + 0.5);
+            to_srgb[i] = q < 0 ? 0 : q > 255 ? 255 : q;
+        }
+    }
+};
+
+srgb_tables const& get_srgb_tables()
+{
+    static srgb_tables const tables;
+    return tables;
+}
+
+// the channel which is linear in sRGB images, equal to num_channels if there is none
+unsigned get_alpha_channel(unsigned num_channels) { return (num_channels & 1) == 0 ? num_channels - 1 : num_channels; }
+
+// clamps to [0, 1], NaN becomes 0
+float saturate(float v) { return v > 0.f ? (v < 1.f ? v : 1.f) : 0.f; }
+
+//
+// scalar reference
+//
+
+void rgb_to_rgba_scalar(uint8_t const* __restrict src, uint8_t* __restrict dest, size_t num_pixels, uint8_t alpha)
+{
+    for (size_t i = 0; i < num_pixels; ++i)
+    {
+        dest[i * 4 + 0] = src[i * 3 + 0];
+        dest[i * 4 + 1] = src[i * 3 + 1];
+        dest[i * 4 + 2] = src[i * 3 + 2];
+        dest[i * 4 + 3] = alpha;
+    }
+}
+
+void swizzle_rgba_bgra_scalar(uint8_t const* src, uint8_t* dest, size_t num_pixels)
+{
+    for (size_t i = 0; i < num_pixels; ++i)
+    {
+        uint8_t const r = src[i * 4 + 0];
+        uint8_t const g = src[i * 4 + 1];
+        uint8_t const b = src[i * 4 + 2];
+        uint8_t const a = src[i * 4 + 3];
+        dest[i * 4 + 0] = b;
+        dest[i * 4 + 1] = g;
+        dest[i * 4 + 2] = r;
+        dest[i * 4 + 3] = a;
+    }
+}
+
+// works on values, num_values must start at a pixel boundary if there is an alpha channel
+void unorm8_to_float_scalar(uint8_t const* __restrict src, float* __restrict dest, size_t num_values, unsigned num_channels, bool is_srgb)
+{
+    auto const& tables = get_srgb_tables();
+    unsigned const alpha_channel = get_alpha_channel(num_channels);
+
+    unsigned c = 0;
+    for (size_t i = 0; i < num_values; ++i)
+    {
+        dest[i] = is_srgb && c != alpha_channel ? tables.to_linear[src[i]] : float(src[i]) * (1.f / 255.f);
+
+        if (++c == num_channels)
+            c = 0;
+    }
+}
+
+void float_to_unorm8_scalar(float const* __restrict src, uint8_t* __restrict dest, size_t num_values, unsigned num_channels, bool is_srgb)
+{
+    auto const& tables = get_srgb_tables();
+    unsigned const alpha_channel = get_alpha_channel(num_channels);
+
+    unsigned c = 0;
+    for (size_t i = 0; i < num_values; ++i)
+    {
+        float const v = saturate(src[i]);
+        dest[i] = uint8_t(is_srgb && c != alpha_channel ? tables.to_srgb[int(v * 4095.f + 0.5f)] : int(v * 255.f + 0.5f));
+
+        if (++c == num_channels)
+            c = 0;
+    }
+}
+
+uint16_t float_to_half(float f)
+{
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+
+    uint32_t const sign = (x >> 16) & 0x8000;
+    uint32_t const abs = x & 0x7FFFFFFF;
+
+    // inf / nan, NaNs are quieted and keep the upper payload bits (like F16C)
+    if (abs >= 0x7F800000)
+        return uint16_t(sign | 0x7C00 | (abs > 0x7F800000 ? 0x200 | ((abs >> 13) & 0x3FF) : 0));
+
+    // rounds to above the largest half (65504)
+    if (abs >= 0x477FF000)
+        return uint16_t(sign | 0x7C00);
+
+    // below the smallest normal half, becomes denormal
+    if (abs < 0x38800000)
+    {
+        if (abs < 0x33000000)
+            return uint16_t(sign);
+
+        uint32_t const exponent = abs >> 23;
+        uint32_t const mantissa = (abs & 0x7FFFFF) | 0x800000;
+        uint32_t const shift = 126 - exponent;
+
+        uint32_t res = mantissa >> shift;
+        uint32_t const rem = mantissa & ((1u << shift) - 1);
+        uint32_t const halfway = 1u << (shift - 1);
+        if (rem > halfway || (rem == halfway && (res & 1)))
+            ++res;
+
+        return uint16_t(sign | res);
+    }
+
+    // rebias the exponent, round to nearest even
+    uint32_t const rounded = abs + 0xC8000FFF + ((abs >> 13) & 1);
+    return uint16_t(sign | (rounded >> 13));
+}
+
+float half_to_float(uint16_t h)
+{
+    uint32_t const sign = uint32_t(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1F;
+    uint32_t mantissa = h & 0x3FF;
+
+    uint32_t bits;
+    if (exponent == 0x1F)
+    {
+        // inf / nan, NaNs are quieted and keep their payload (like F16C)
+        bits = sign | 0x7F800000 | (mantissa != 0 ? 0x400000 | (mantissa << 13) : 0);
+    }
+    else if (exponent == 0)
+    {
+        if (mantissa == 0)
+        {
+            bits = sign;
+        }
+        else
+        {
+            // denormal, normalize
+            exponent = 127 - 15 + 1;
+            while ((mantissa & 0x400) == 0)
+            {
+                mantissa <<= 1;
+                --exponent;
+            }
+            bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+        }
+    }
+    else
+    {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+
+    float res;
+    std::memcpy(&res, &bits, sizeof(res));
+    return res;
+}
+
+void float_to_half_scalar(float const* __restrict src, uint16_t* __restrict dest, size_t num_values)
+{
+    for (size_t i = 0; i < num_values; ++i)
+        dest[i] = float_to_half(src[i]);
+}
+
+void half_to_float_scalar(uint16_t const* __restrict src, float* __restrict dest, size_t num_values)
+{
+    for (size_t i = 0; i < num_values; ++i)
+        dest[i] = half_to_float(src[i]);
+}
+
+void reconstruct_normal_z_scalar(uint8_t const* __restrict src_rg, uint8_t* __restrict dest_rgba, size_t num_pixels)
+{
+    for (size_t i = 0; i < num_pixels; ++i)
+    {
+        uint8_t const r = src_rg[i * 2 + 0];
+        uint8_t const g = src_rg[i * 2 + 1];
+
+        float const x = float(r) * (2.f / 255.f) - 1.f;
+        float const y = float(g) * (2.f / 255.f) - 1.f;
+        float const zz = 1.f - x * x - y * y;
+        float const z = std::sqrt(zz > 0.f ? zz : 0.f);
+
+        dest_rgba[i * 4 + 0] = r;
+        dest_rgba[i * 4 + 1] = g;
+        dest_rgba[i * 4 + 2] = uint8_t(int(z * 127.5f + 128.f));
+        dest_rgba[i * 4 + 3] = 255;
+    }
+}
+
+// round(c * a / 255), exact for all inputs
+uint8_t multiply_unorm8(unsigned c, unsigned a)
+{
+    unsigned const t = c * a + 128;
+    return uint8_t((t + (t >> 8)) >> 8);
+}
+
+void premultiply_alpha_scalar(uint8_t* rgba, size_t num_pixels, bool is_srgb)
+{
+    auto const& tables = get_srgb_tables();
+
+    for (size_t i = 0; i < num_pixels; ++i)
+    {
+        uint8_t* const pixel = rgba + i * 4;
+        unsigned const a = pixel[3];
+
+        if (is_srgb)
+        {
+            float const alpha = float(a) * (1.f / 255.f);
+            for (auto c = 0; c < 3; ++c)
+                pixel[c] = uint8_t(tables.to_srgb[int(tables.to_linear[pixel[c]] * alpha * 4095.f + 0.5f)]);
+        }
+        else
+        {
+            for (auto c = 0; c < 3; ++c)
+                pixel[c] = multiply_unorm8(pixel[c], a);
+        }
+    }
+}
+
+void premultiply_alpha_scalar(float* rgba, size_t num_pixels)
+{
+    for (size_t i = 0; i < num_pixels; ++i)
+    {
+        float* const pixel = rgba + i * 4;
+        pixel[0] *= pixel[3];
+        pixel[1] *= pixel[3];
+        pixel[2] *= pixel[3];
+    }
+}
+
+#if INC_PIXEL_CONVERT_X86
+
+//
+// SSSE3
+// there are no gathers, the sRGB table lookups and the float16 conversion stay scalar
+//
+
+INC_TARGET_SSSE3 void rgb_to_rgba_ssse3(uint8_t const* __restrict src, uint8_t* __restrict dest, size_t num_pixels, uint8_t alpha)
+{
+    __m128i const shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    __m128i const alpha_bits = _mm_set1_epi32(int(uint32_t(alpha) << 24));
+
+    // 16 byte loads for 4 pixels (12 bytes), stay clear of the end
+    size_t i = 0;
+    for (; i + 6 <= num_pixels; i += 4)
+    {
+        __m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i * 3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i * 4), _mm_or_si128(_mm_shuffle_epi8(v, shuffle), alpha_bits));
+    }
+
+    rgb_to_rgba_scalar(src + i * 3, dest + i * 4, num_pixels - i, alpha);
+}
+
+INC_TARGET_SSSE3 void swizzle_rgba_bgra_ssse3(uint8_t const* src, uint8_t* dest, size_t num_pixels)
+{
+    __m128i const shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+    size_t i = 0;
+    for (; i + 4 <= num_pixels; i += 4)
+    {
+        __m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i * 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i * 4), _mm_shuffle_epi8(v, shuffle));
+    }
+
+    swizzle_rgba_bgra_scalar(src + i * 4, dest + i * 4, num_pixels - i);
+}
+
+INC_TARGET_SSSE3 void unorm8_to_float_ssse3(uint8_t const* __restrict src, float* __restrict dest, size_t num_pixels, unsigned num_channels, bool is_srgb)
+{
+    size_t const num_values = num_pixels * num_channels;
+    if (is_srgb)
+        return unorm8_to_float_scalar(src, dest, num_values, num_channels, true);
+
+    __m128i const zero = _mm_setzero_si128();
+    __m128 const scale = _mm_set1_ps(1.f / 255.f);
+
+    size_t i = 0;
+    for (; i + 16 <= num_values; i += 16)
+    {
+        __m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+        __m128i const lo = _mm_unpacklo_epi8(v, zero);
+        __m128i const hi = _mm_unpackhi_epi8(v, zero);
+
+        _mm_storeu_ps(dest + i + 0, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), scale));
+        _mm_storeu_ps(dest + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), scale));
+        _mm_storeu_ps(dest + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), scale));
+        _mm_storeu_ps(dest + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), scale));
+    }
+
+    unorm8_to_float_scalar(src + i, dest + i, num_values - i, num_channels, false);
+}
+
+INC_TARGET_SSSE3 __m128i quantize_unorm8_ssse3(float const* src)
+{
+    __m128 const v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src), _mm_setzero_ps()), _mm_set1_ps(1.f));
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(255.f)), _mm_set1_ps(0.5f)));
+}
+
+INC_TARGET_SSSE3 void float_to_unorm8_ssse3(float const* __restrict src, uint8_t* __restrict dest, size_t num_pixels, unsigned num_channels, bool is_srgb)
+{
+    size_t const num_values = num_pixels * num_channels;
+    if (is_srgb)
+        return float_to_unorm8_scalar(src, dest, num_values, num_channels, true);
+
+    size_t i = 0;
+    for (; i + 16 <= num_values; i += 16)
+    {
+        __m128i const lo = _mm_packs_epi32(quantize_unorm8_ssse3(src + i + 0), quantize_unorm8_ssse3(src + i + 4));
+        __m128i const hi = _mm_packs_epi32(quantize_unorm8_ssse3(src + i + 8), quantize_unorm8_ssse3(src + i + 12));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_packus_epi16(lo, hi));
+    }
+
+    float_to_unorm8_scalar(src + i, dest + i, num_values - i, num_channels, false);
+}
+
+INC_TARGET_SSSE3 void reconstruct_normal_z_ssse3(uint8_t const* __restrict src_rg, uint8_t* __restrict dest_rgba, size_t num_pixels)
+{
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const byte_mask = _mm_set1_epi32(0xFF);
+    __m128i const alpha_bits = _mm_set1_epi32(int(0xFF000000u));
+    __m128 const scale = _mm_set1_ps(2.f / 255.f);
+    __m128 const one = _mm_set1_ps(1.f);
+
+    size_t i = 0;
+    for (; i + 4 <= num_pixels; i += 4)
+    {
+        // one RG pair per 32 bit lane
+        __m128i const rg = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(src_rg + i * 2)), zero);
+
+        __m128 const x = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(rg, byte_mask)), scale), one);
+        __m128 const y = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(rg, 8)), scale), one);
+        __m128 const zz = _mm_sub_ps(_mm_sub_ps(one, _mm_mul_ps(x, x)), _mm_mul_ps(y, y));
+        __m128 const z = _mm_sqrt_ps(_mm_max_ps(zz, _mm_setzero_ps()));
+        __m128i const b = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(127.5f)), _mm_set1_ps(128.f)));
+
+        __m128i const rgba = _mm_or_si128(_mm_or_si128(rg, _mm_slli_epi32(b, 16)), alpha_bits);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest_rgba + i * 4), rgba);
+    }
+
+    reconstruct_normal_z_scalar(src_rg + i * 2, dest_rgba + i * 4, num_pixels - i);
+}
+
+// pixels as 16 bit values, multiplies RGB by A, keeps A
+INC_TARGET_SSSE3 __m128i premultiply_u16_ssse3(__m128i px)
+{
+    __m128i const alpha_lanes = _mm_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1);
+    __m128i const alpha_one = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(px, 0xFF), 0xFF);
+    a = _mm_or_si128(_mm_andnot_si128(alpha_lanes, a), alpha_one);
+
+    __m128i const t = _mm_add_epi16(_mm_mullo_epi16(px, a), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+INC_TARGET_SSSE3 void premultiply_alpha_ssse3(uint8_t* rgba, size_t num_pixels, bool is_srgb)
+{
+    if (is_srgb)
+        return premultiply_alpha_scalar(rgba, num_pixels, true);
+
+    __m128i const zero = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 4 <= num_pixels; i += 4)
+    {
+        __m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(rgba + i * 4));
+        __m128i const lo = premultiply_u16_ssse3(_mm_unpacklo_epi8(v, zero));
+        __m128i const hi = premultiply_u16_ssse3(_mm_unpackhi_epi8(v, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + i * 4), _mm_packus_epi16(lo, hi));
+    }
+
+    premultiply_alpha_scalar(rgba + i * 4, num_pixels - i, false);
+}
+
+INC_TARGET_SSSE3 void premultiply_alpha_ssse3(float* rgba, size_t num_pixels)
+{
+    __m128 const alpha_lane = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+
+    for (size_t i = 0; i < num_pixels; ++i)
+    {
+        // alpha keeps its bits, multiplying it by one would quiet signaling NaNs
+        __m128 const v = _mm_loadu_ps(rgba + i * 4);
+        __m128 const product = _mm_mul_ps(v, _mm_shuffle_ps(v, v, 0xFF));
+        _mm_storeu_ps(rgba + i * 4, _mm_or_ps(_mm_andnot_ps(alpha_lane, product), _mm_and_ps(alpha_lane, v)));
+    }
+}
+
+//
+// AVX2 + F16C
+//
+
+// lanes of an 8 value block that are converted linearly, blocks start at pixel boundaries if there is an alpha channel
+INC_TARGET_AVX2 __m256i get_linear_lanes_avx2(unsigned num_channels, bool is_srgb)
+{
+    if (!is_srgb)
+        return _mm256_set1_epi32(-1);
+
+    switch (num_channels)
+    {
+    case 2:
+        return _mm256_setr_epi32(0, -1, 0, -1, 0, -1, 0, -1);
+    case 4:
+        return _mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1);
+    default:
+        return _mm256_setzero_si256();
+    }
+}
+
+INC_TARGET_AVX2 void rgb_to_rgba_avx2(uint8_t const* __restrict src, uint8_t* __restrict dest, size_t num_pixels, uint8_t alpha)
+{
+    __m256i const shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1, //
+                                             0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    __m256i const alpha_bits = _mm256_set1_epi32(int(uint32_t(alpha) << 24));
+
+    // two 16 byte loads for 8 pixels (24 bytes), stay clear of the end
+    size_t i = 0;
+    for (; i + 10 <= num_pixels; i += 8)
+    {
+        __m128i const lo = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i * 3));
+        __m128i const hi = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i * 3 + 12));
+        __m256i const v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), alpha_bits));
+    }
+
+    rgb_to_rgba_scalar(src + i * 3, dest + i * 4, num_pixels - i, alpha);
+}
+
+INC_TARGET_AVX2 void swizzle_rgba_bgra_avx2(uint8_t const* src, uint8_t* dest, size_t num_pixels)
+{
+    __m256i const shuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15, //
+                                             2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+    size_t i = 0;
+    for (; i + 8 <= num_pixels; i += 8)
+    {
+        __m256i const v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i * 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i * 4), _mm256_shuffle_epi8(v, shuffle));
+    }
+
+    swizzle_rgba_bgra_scalar(src + i * 4, dest + i * 4, num_pixels - i);
+}
+
+INC_TARGET_AVX2 void unorm8_to_float_avx2(uint8_t const* __restrict src, float* __restrict dest, size_t num_pixels, unsigned num_channels, bool is_srgb)
+{
+    auto const& tables = get_srgb_tables();
+    size_t const num_values = num_pixels * num_channels;
+    __m256 const linear_lanes = _mm256_castsi256_ps(get_linear_lanes_avx2(num_channels, is_srgb));
+    __m256 const scale = _mm256_set1_ps(1.f / 255.f);
+
+    size_t i = 0;
+    for (; i + 8 <= num_values; i += 8)
+    {
+        __m256i const v = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(src + i)));
+        __m256 res = _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale);
+
+        if (is_srgb)
+            res = _mm256_blendv_ps(_mm256_i32gather_ps(tables.to_linear, v, 4), res, linear_lanes);
+
+        _mm256_storeu_ps(dest + i, res);
+    }
+
+    unorm8_to_float_scalar(src + i, dest + i, num_values - i, num_channels, is_srgb);
+}
+
+INC_TARGET_AVX2 void float_to_unorm8_avx2(float const* __restrict src, uint8_t* __restrict dest, size_t num_pixels, unsigned num_channels, bool is_srgb)
+{
+    auto const& tables = get_srgb_tables();
+    size_t const num_values = num_pixels * num_channels;
+    __m256i const linear_lanes = get_linear_lanes_avx2(num_channels, is_srgb);
+    __m256 const half = _mm256_set1_ps(0.5f);
+
+    size_t i = 0;
+    for (; i + 8 <= num_values; i += 8)
+    {
+        __m256 const v = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), _mm256_setzero_ps()), _mm256_set1_ps(1.f));
+        __m256i res = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, _mm256_set1_ps(255.f)), half));
+
+        if (is_srgb)
+        {
+            __m256i const index = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, _mm256_set1_ps(4095.f)), half));
+            res = _mm256_blendv_epi8(_mm256_i32gather_epi32(tables.to_srgb, index, 4), res, linear_lanes);
+        }
+
+        __m128i const packed = _mm_packs_epi32(_mm256_castsi256_si128(res), _mm256_extracti128_si256(res, 1));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dest + i), _mm_packus_epi16(packed, packed));
+    }
+
+    float_to_unorm8_scalar(src + i, dest + i, num_values - i, num_channels, is_srgb);
+}
+
+INC_TARGET_AVX2 void float_to_half_avx2(float const* __restrict src, uint16_t* __restrict dest, size_t num_values)
+{
+    size_t i = 0;
+    for (; i + 8 <= num_values; i += 8)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+
+    float_to_half_scalar(src + i, dest + i, num_values - i);
+}
+
+INC_TARGET_AVX2 void half_to_float_avx2(uint16_t const* __restrict src, float* __restrict dest, size_t num_values)
+{
+    size_t i = 0;
+    for (; i + 8 <= num_values; i += 8)
+        _mm256_storeu_ps(dest + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i))));
+
+    half_to_float_scalar(src + i, dest + i, num_values - i);
+}
+
+INC_TARGET_AVX2 void reconstruct_normal_z_avx2(uint8_t const* __restrict src_rg, uint8_t* __restrict dest_rgba, size_t num_pixels)
+{
+    __m256i const byte_mask = _mm256_set1_epi32(0xFF);
+    __m256i const alpha_bits = _mm256_set1_epi32(int(0xFF000000u));
+    __m256 const scale = _mm256_set1_ps(2.f / 255.f);
+    __m256 const one = _mm256_set1_ps(1.f);
+
+    size_t i = 0;
+    for (; i + 8 <= num_pixels; i += 8)
+    {
+        // one RG pair per 32 bit lane
+        __m256i const rg = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const*>(src_rg + i * 2)));
+
+        __m256 const x = _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(rg, byte_mask)), scale), one);
+        __m256 const y = _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(rg, 8)), scale), one);
+        __m256 const zz = _mm256_sub_ps(_mm256_sub_ps(one, _mm256_mul_ps(x, x)), _mm256_mul_ps(y, y));
+        __m256 const z = _mm256_sqrt_ps(_mm256_max_ps(zz, _mm256_setzero_ps()));
+        __m256i const b = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(127.5f)), _mm256_set1_ps(128.f)));
+
+        __m256i const rgba = _mm256_or_si256(_mm256_or_si256(rg, _mm256_slli_epi32(b, 16)), alpha_bits);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest_rgba + i * 4), rgba);
+    }
+
+    reconstruct_normal_z_scalar(src_rg + i * 2, dest_rgba + i * 4, num_pixels - i);
+}
+
+INC_TARGET_AVX2 __m256i premultiply_u16_avx2(__m256i px)
+{
+    __m256i const alpha_lanes = _mm256_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1);
+    __m256i const alpha_one = _mm256_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255);
+
+    __m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(px, 0xFF), 0xFF);
+    a = _mm256_or_si256(_mm256_andnot_si256(alpha_lanes, a), alpha_one);
+
+    __m256i const t = _mm256_add_epi16(_mm256_mullo_epi16(px, a), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+INC_TARGET_AVX2 void premultiply_alpha_avx2(uint8_t* rgba, size_t num_pixels, bool is_srgb)
+{
+    if (is_srgb)
+        return premultiply_alpha_scalar(rgba, num_pixels, true);
+
+    __m256i const zero = _mm256_setzero_si256();
+
+    // unpack and pack both work per 128 bit lane, the pixel order is preserved
+    size_t i = 0;
+    for (; i + 8 <= num_pixels; i += 8)
+    {
+        __m256i const v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(rgba + i * 4));
+        __m256i const lo = premultiply_u16_avx2(_mm256_unpacklo_epi8(v, zero));
+        __m256i const hi = premultiply_u16_avx2(_mm256_unpackhi_epi8(v, zero));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba + i * 4), _mm256_packus_epi16(lo, hi));
+    }
+
+    premultiply_alpha_scalar(rgba + i * 4, num_pixels - i, false);
+}
+
+INC_TARGET_AVX2 void premultiply_alpha_avx2(float* rgba, size_t num_pixels)
+{
+    size_t i = 0;
+    for (; i + 2 <= num_pixels; i += 2)
+    {
+        // alpha keeps its bits, multiplying it by one would quiet signaling NaNs
+        __m256 const v = _mm256_loadu_ps(rgba + i * 4);
+        __m256 const product = _mm256_mul_ps(v, _mm256_permute_ps(v, 0xFF));
+        _mm256_storeu_ps(rgba + i * 4, _mm256_blend_ps(product, v, 0x88));
+    }
+
+    premultiply_alpha_scalar(rgba + i * 4, num_pixels - i);
+}
+
+#endif
+}
+
+inc::assets::pixel_isa inc::assets::get_supported_pixel_isa() { return get_isa_state().supported; }
+
+inc::assets::pixel_isa inc::assets::get_pixel_isa() { return get_active_isa(); }
+
+void inc::assets::set_pixel_isa(pixel_isa isa)
+{
+    auto& state = get_isa_state();
+    state.active.store(isa < state.supported ? isa : state.supported);
+}
+
+void inc::assets::convert_rgb_to_rgba(const uint8_t* src, uint8_t* dest, size_t num_pixels, uint8_t alpha)
+{
+    switch (get_active_isa())
+    {
+#if INC_PIXEL_CONVERT_X86
+    case pixel_isa::avx2:
+        return rgb_to_rgba_avx2(src, dest, num_pixels, alpha);
+    case pixel_isa::ssse3:
+        return rgb_to_rgba_ssse3(src, dest, num_pixels, alpha);
+#endif
+    default:
+        return rgb_to_rgba_scalar(src, dest, num_pixels, alpha);
+    }
+}
+
+void inc::assets::swizzle_rgba_bgra(const uint8_t* src, uint8_t* dest, size_t num_pixels)
+{
+    switch (get_active_isa())
+    {
+#if INC_PIXEL_CONVERT_X86
+    case pixel_isa::avx2:
+        return swizzle_rgba_bgra_avx2(src, dest, num_pixels);
+    case pixel_isa::ssse3:
+        return swizzle_rgba_bgra_ssse3(src, dest, num_pixels);
+#endif
+    default:
+        return swizzle_rgba_bgra_scalar(src, dest, num_pixels);
+    }
+}
+
+void inc::assets::convert_unorm8_to_float(const uint8_t* src, float* dest, size_t num_pixels, unsigned num_channels, bool is_srgb)
+{
+    switch (get_active_isa())
+    {
+#if INC_PIXEL_CONVERT_X86
+    case pixel_isa::avx2:
+        return unorm8_to_float_avx2(src, dest, num_pixels, num_channels, is_srgb);
+    case pixel_isa::ssse3:
+        return unorm8_to_float_ssse3(src, dest, num_pixels, num_channels, is_srgb);
+#endif
+    default:
+        return unorm8_to_float_scalar(src, dest, num_pixels * num_channels, num_channels, is_srgb);
+    }
+}
+
+void inc::assets::convert_float_to_unorm8(const float* src, uint8_t* dest, size_t num_pixels, unsigned num_channels, bool is_srgb)
+{
+    switch (get_active_isa())
+    {
+#if INC_PIXEL_CONVERT_X86
+    case pixel_isa::avx2:
+        return float_to_unorm8_avx2(src, dest, num_pixels, num_channels, is_srgb);
+    case pixel_isa::ssse3:
+        return float_to_unorm8_ssse3(src, dest, num_pixels, num_channels, is_srgb);
+#endif
+    default:
+        return float_to_unorm8_scalar(src, dest, num_pixels * num_channels, num_channels, is_srgb);
+    }
+}
+
+void inc::assets::convert_float_to_half(const float* src, uint16_t* dest, size_t num_values)
+{
+#if INC_PIXEL_CONVERT_X86
+    if (get_active_isa() == pixel_isa::avx2)
+        return float_to_half_avx2(src, dest, num_values);
+#endif
+
+    float_to_half_scalar(src, dest, num_values);
+}
+
+void inc::assets::convert_half_to_float(const uint16_t* src, float* dest, size_t num_values)
+{
+#if INC_PIXEL_CONVERT_X86
+    if (get_active_isa() == pixel_isa::avx2)
+        return half_to_float_avx2(src, dest, num_values);
+#endif
+
+    half_to_float_scalar(src, dest, num_values);
+}
+
+void inc::assets::reconstruct_normal_z(const uint8_t* src_rg, uint8_t* dest_rgba, size_t num_pixels)
+{
+    switch (get_active_isa())
+    {
+#if INC_PIXEL_CONVERT_X86
+    case pixel_isa::avx2:
+        return reconstruct_normal_z_avx2(src_rg, dest_rgba, num_pixels);
+    case pixel_isa::ssse3:
+        return reconstruct_normal_z_ssse3(src_rg, dest_rgba, num_pixels);
+#endif
+    default:
+        return reconstruct_normal_z_scalar(src_rg, dest_rgba, num_pixels);
+    }
+}
+
+void inc::assets::premultiply_alpha(uint8_t* rgba, size_t num_pixels, bool is_srgb)
+{
+    switch (get_active_isa())
+    {
+#if INC_PIXEL_CONVERT_X86
+    case pixel_isa::avx2:
+        return premultiply_alpha_avx2(rgba, num_pixels, is_srgb);
+    case pixel_isa::ssse3:
+        return premultiply_alpha_ssse3(rgba, num_pixels, is_srgb);
+#endif
+    default:
+        return premultiply_alpha_scalar(rgba, num_pixels, is_srgb);
+    }
+}
+
+void inc::assets::premultiply_alpha(float* rgba, size_t num_pixels)
+{
+    switch (get_active_isa())
+    {
+#if INC_PIXEL_CONVERT_X86
+    case pixel_isa::avx2:
+        return premultiply_alpha_avx2(rgba, num_pixels);
+    case pixel_isa::ssse3:
+        return premultiply_alpha_ssse3(rgba, num_pixels);
+#endif
+    default:
+        return premultiply_alpha_scalar(rgba, num_pixels);
+    }
+}
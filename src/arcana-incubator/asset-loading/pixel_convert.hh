@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace inc::assets
+{
+/// instruction set used by the pixel conversion kernels, picked at runtime from the CPU features
+enum class pixel_isa
+{
+    scalar,
+    ssse3,
+    avx2 // includes F16C
+};
+
+/// the best instruction set supported by this CPU
+[[nodiscard]] pixel_isa get_supported_pixel_isa();
+
+/// the instruction set currently in use
+[[nodiscard]] pixel_isa get_pixel_isa();
+
+/// overrides the instruction set (ie. to compare against the scalar reference), clamped to the supported one
+void set_pixel_isa(pixel_isa isa);
+
+// all conversions work on tightly packed pixels, call them per row for pitched images
+// sRGB: in images with 2 or 4 channels, the last channel is alpha and always linear
+
+/// RGB8 to RGBA8 with a constant alpha
+void convert_rgb_to_rgba(uint8_t const* __restrict src, uint8_t* __restrict dest, size_t num_pixels, uint8_t alpha = 255);
+
+/// RGBA8 <-> BGRA8, src and dest can be equal
+void swizzle_rgba_bgra(uint8_t const* src, uint8_t* dest, size_t num_pixels);
+
+/// UNORM8 to float in [0, 1], linearizing color channels if is_srgb
+void convert_unorm8_to_float(uint8_t const* __restrict src, float* __restrict dest, size_t num_pixels, unsigned num_channels, bool is_srgb = false);
+
+/// float to UNORM8, clamped to [0, 1], encoding color channels if is_srgb
+void convert_float_to_unorm8(float const* __restrict src, uint8_t* __restrict dest, size_t num_pixels, unsigned num_channels, bool is_srgb = false);
+
+/// float32 <-> float16, rounding to nearest even
+void convert_float_to_half(float const* __restrict src, uint16_t* __restrict dest, size_t num_values);
+void convert_half_to_float(uint16_t const* __restrict src, float* __restrict dest, size_t num_values);
+
+/// two channel tangent space normals (ie. BC5) to RGBA8, reconstructing Z (alpha is 255)
+void reconstruct_normal_z(uint8_t const* __restrict src_rg, uint8_t* __restrict dest_rgba, size_t num_pixels);
+
+/// multiplies RGB by alpha, in place
+/// is_srgb: the multiplication happens in linear space
+void premultiply_alpha(uint8_t* rgba, size_t num_pixels, bool is_srgb = false);
+void premultiply_alpha(float* rgba, size_t num_pixels);
+}
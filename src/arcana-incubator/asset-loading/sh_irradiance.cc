@@ -0,0 +1,230 @@
+#include "sh_irradiance.hh"
+
+#include <cmath>
+#include <thread>
+
+#include <clean-core/alloc_array.hh>
+#include <clean-core/assert.hh>
+#include <clean-core/capped_vector.hh>
+#include <clean-core/utility.hh>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define INC_SH_IRRADIANCE_SSE 1
+#include <xmmintrin.h>
+#else
+#define INC_SH_IRRADIANCE_SSE 0
+#endif
+
+namespace
+{
+constexpr unsigned gc_max_num_threads = 32;
+constexpr double gc_pi = 3.14159265358979323846;
+
+// real SH basis constants, y is the polar axis
+constexpr float gc_sh_y00 = 0.282095f;
+constexpr float gc_sh_y1 = 0.488603f;
+constexpr float gc_sh_y2 = 1.092548f;
+constexpr float gc_sh_y20 = 0.315392f;
+constexpr float gc_sh_y22 = 0.546274f;
+
+// cosine lobe convolution per band (Ramamoorthi and Hanrahan), divided by pi
+constexpr float gc_lobe_band0 = 1.f;
+constexpr float gc_lobe_band1 = 2.f / 3.f;
+constexpr float gc_lobe_band2 = 1.f / 4.f;
+
+// all basis functions separate into a factor of theta (per row) and of phi (per column)
+// with x = sin(t) cos(p), y = cos(t), z = sin(t) sin(p), the phi factors are
+// 1, cos(p), sin(p), cos(p) sin(p), cos(2p)
+constexpr unsigned gc_num_phi_factors = 5;
+
+struct column_factors
+{
+    float cos_phi;
+    float sin_phi;
+    float cos_sin_phi;
+    float cos_2phi;
+};
+
+// accumulated per-column sums of one band of rows, rgb per SH coefficient
+struct sh_accumulator
+{
+    double rgb[9][3] = {};
+};
+
+void accumulate_row(sh_accumulator& acc, float const* row, column_factors const* columns, unsigned width, unsigned num_channels, double sin_theta, double cos_theta, double row_weight)
+{
+    // sums of L * phi factor across the row, rgba
+    float sums[gc_num_phi_factors][4] = {};
+
+#if INC_SH_IRRADIANCE_SSE
+    if (num_channels == 4)
+    {
+        __m128 s_one = _mm_setzero_ps();
+        __m128 s_cos = _mm_setzero_ps();
+        __m128 s_sin = _mm_setzero_ps();
+        __m128 s_cos_sin = _mm_setzero_ps();
+        __m128 s_cos_2 = _mm_setzero_ps();
+
+        for (auto x = 0u; x < width; ++x)
+        {
+            __m128 const l = _mm_loadu_ps(row + x * 4);
+            __m128 const f = _mm_loadu_ps(&columns[x].cos_phi);
+
+            s_one = _mm_add_ps(s_one, l);
+            s_cos = _mm_add_ps(s_cos, _mm_mul_ps(l, _mm_shuffle_ps(f, f, _MM_SHUFFLE(0, 0, 0, 0))));
+            s_sin = _mm_add_ps(s_sin, _mm_mul_ps(l, _mm_shuffle_ps(f, f, _MM_SHUFFLE(1, 1, 1, 1))));
+            s_cos_sin = _mm_add_ps(s_cos_sin, _mm_mul_ps(l, _mm_shuffle_ps(f, f, _MM_SHUFFLE(2, 2, 2, 2))));
+            s_cos_2 = _mm_add_ps(s_cos_2, _mm_mul_ps(l, _mm_shuffle_ps(f, f, _MM_SHUFFLE(3, 3, 3, 3))));
+        }
+
+        _mm_storeu_ps(sums[0], s_one);
+        _mm_storeu_ps(sums[1], s_cos);
+        _mm_storeu_ps(sums[2], s_sin);
+        _mm_storeu_ps(sums[3], s_cos_sin);
+        _mm_storeu_ps(sums[4], s_cos_2);
+    }
+    else
+#endif
+    {
+        for (auto x = 0u; x < width; ++x)
+        {
+            float const* const l = row + x * num_channels;
+            column_factors const& f = columns[x];
+
+            for (auto c = 0u; c < 3; ++c)
+            {
+                sums[0][c] += l[c];
+                sums[1][c] += l[c] * f.cos_phi;
+                sums[2][c] += l[c] * f.sin_phi;
+                sums[3][c] += l[c] * f.cos_sin_phi;
+                sums[4][c] += l[c] * f.cos_2phi;
+            }
+        }
+    }
+
+    double const st = sin_theta;
+    double const ct = cos_theta;
+    double const w = row_weight;
+
+    for (auto c = 0u; c < 3; ++c)
+    {
+        acc.rgb[0][c] += w * gc_sh_y00 * sums[0][c];
+        acc.rgb[1][c] += w * gc_sh_y1 * ct * sums[0][c];                 // y
+        acc.rgb[2][c] += w * gc_sh_y1 * st * sums[2][c];                 // z
+        acc.rgb[3][c] += w * gc_sh_y1 * st * sums[1][c];                 // x
+        acc.rgb[4][c] += w * gc_sh_y2 * st * ct * sums[1][c];            // xy
+        acc.rgb[5][c] += w * gc_sh_y2 * st * ct * sums[2][c];            // yz
+        acc.rgb[6][c] += w * gc_sh_y20 * (3 * ct * ct - 1) * sums[0][c]; // 3y^2 - 1
+        acc.rgb[7][c] += w * gc_sh_y2 * st * st * sums[3][c];            // xz
+        acc.rgb[8][c] += w * gc_sh_y22 * st * st * sums[4][c];           // x^2 - z^2
+    }
+}
+}
+
+inc::assets::sh9_irradiance inc::assets::project_sh9_irradiance(const float* texels, unsigned width, unsigned height, unsigned num_channels, unsigned max_num_threads)
+{
+    CC_ASSERT(texels != nullptr && width > 0 && height > 0 && "invalid image");
+    CC_ASSERT((num_channels == 3 || num_channels == 4) && "image must have 3 or 4 channels");
+
+    auto columns = cc::alloc_array<column_factors>::uninitialized(width);
+    for (auto x = 0u; x < width; ++x)
+    {
+        // u = atan2(z, x) / 2pi + 0.5
+        double const phi = 2 * gc_pi * ((x + 0.5) / width - 0.5);
+        columns[x].cos_phi = float(std::cos(phi));
+        columns[x].sin_phi = float(std::sin(phi));
+        columns[x].cos_sin_phi = float(std::cos(phi) * std::sin(phi));
+        columns[x].cos_2phi = float(std::cos(2 * phi));
+    }
+
+    // solid angle of a texel: dphi * dtheta * sin(theta)
+    double const texel_angle = (2 * gc_pi / width) * (gc_pi / height);
+
+    auto f_project_rows = [&](unsigned row_start, unsigned row_end, sh_accumulator& acc) {
+        for (auto y = row_start; y < row_end; ++y)
+        {
+            // v = acos(y) / pi
+            double const theta = gc_pi * (y + 0.5) / height;
+            double const sin_theta = std::sin(theta);
+            double const cos_theta = std::cos(theta);
+
+            accumulate_row(acc, texels + size_t(y) * width * num_channels, columns.data(), width, num_channels, sin_theta, cos_theta, texel_angle * sin_theta);
+        }
+    };
+
+    unsigned num_threads = max_num_threads > 0 ? max_num_threads : cc::max(1u, std::thread::hardware_concurrency());
+    num_threads = cc::min(cc::min(num_threads, height), gc_max_num_threads);
+
+    cc::capped_vector<sh_accumulator, gc_max_num_threads> accumulators;
+    accumulators.resize(num_threads);
+
+    if (num_threads == 1)
+    {
+        f_project_rows(0, height, accumulators[0]);
+    }
+    else
+    {
+        cc::capped_vector<std::thread, gc_max_num_threads> threads;
+        unsigned const rows_per_thread = (height + num_threads - 1) / num_threads;
+
+        for (auto i = 0u; i < num_threads; ++i)
+        {
+            unsigned const start = cc::min(height, i * rows_per_thread);
+            unsigned const end = cc::min(height, start + rows_per_thread);
+            threads.emplace_back([&, start, end, i] { f_project_rows(start, end, accumulators[i]); });
+        }
+
+        for (auto& t : threads)
+            t.join();
+    }
+
+    sh9_irradiance res;
+    for (auto k = 0u; k < 9; ++k)
+    {
+        float const lobe = k == 0 ? gc_lobe_band0 : k < 4 ? gc_lobe_band1 : gc_lobe_band2;
+
+        double rgb[3] = {};
+        for (auto const& acc : accumulators)
+            for (auto c = 0u; c < 3; ++c)
+                rgb[c] += acc.rgb[k][c];
+
+        res.coefficients[k] = tg::vec4(float(rgb[0]) * lobe, float(rgb[1]) * lobe, float(rgb[2]) * lobe, 0.f);
+    }
+
+    return res;
+}
+
+inc::assets::sh9_irradiance inc::assets::project_sh9_irradiance(const inc::assets::image_data& data, const inc::assets::image_size& size, unsigned max_num_threads)
+{
+    CC_ASSERT(data.is_hdr && "image must be decoded to float (use_hdr_float)");
+    return project_sh9_irradiance(static_cast<float const*>(data.raw), size.width, size.height, data.num_channels, max_num_threads);
+}
+
+tg::vec3 inc::assets::evaluate_sh9_irradiance(const inc::assets::sh9_irradiance& sh, tg::vec3 normal)
+{
+    float const x = normal.x;
+    float const y = normal.y;
+    float const z = normal.z;
+
+    float const basis[9] = {
+        gc_sh_y00,                    //
+        gc_sh_y1 * y,                 //
+        gc_sh_y1 * z,                 //
+        gc_sh_y1 * x,                 //
+        gc_sh_y2 * x * y,             //
+        gc_sh_y2 * y * z,             //
+        gc_sh_y20 * (3 * y * y - 1),  //
+        gc_sh_y2 * x * z,             //
+        gc_sh_y22 * (x * x - z * z),  //
+    };
+
+    tg::vec3 res = tg::vec3(0, 0, 0);
+    for (auto k = 0u; k < 9; ++k)
+    {
+        res.x += sh.coefficients[k].x * basis[k];
+        res.y += sh.coefficients[k].y * basis[k];
+        res.z += sh.coefficients[k].z * basis[k];
+    }
+
+    return res;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <typed-geometry/tg-lean.hh>
+
+#include "image_loader.hh"
+
+namespace inc::assets
+{
+/// diffuse irradiance of an environment as 9 L2 spherical harmonics coefficients
+/// the cosine lobe (divided by pi) is already applied, evaluating at a normal yields the same value as a texel of
+/// pre::texture_processing::create_diffuse_irradiance_map in that direction
+/// layout matches a HLSL constant block of float4[9], rgb used, w zero
+struct sh9_irradiance
+{
+    tg::vec4 coefficients[9];
+};
+
+static_assert(sizeof(sh9_irradiance) == 144, "sh9_irradiance must be usable as a 144 byte constant block");
+
+/// projects an equirectangular HDR environment into L2 SH irradiance, on the CPU
+/// texels are float, 3 or 4 channels (ie. load_image(.., 4, true)), row-major, tightly packed
+/// the mapping is the same as the equirect_to_cube shader: u = atan2(dir.z, dir.x) / 2pi + 0.5, v = acos(dir.y) / pi
+/// rows are split across up to max_num_threads threads (0: hardware concurrency)
+[[nodiscard]] sh9_irradiance project_sh9_irradiance(float const* texels, unsigned width, unsigned height, unsigned num_channels, unsigned max_num_threads = 0);
+
+[[nodiscard]] sh9_irradiance project_sh9_irradiance(image_data const& data, image_size const& size, unsigned max_num_threads = 0);
+
+/// evaluates irradiance in direction normal (normalized), the same as the shader-side evaluation
+[[nodiscard]] tg::vec3 evaluate_sh9_irradiance(sh9_irradiance const& sh, tg::vec3 normal);
+}
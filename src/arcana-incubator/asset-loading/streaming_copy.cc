@@ -0,0 +1,125 @@
+#include "streaming_copy.hh"
+
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+#include <clean-core/assert.hh>
+#include <clean-core/capped_vector.hh>
+#include <clean-core/utility.hh>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define INC_STREAMING_COPY_SSE2 1
+#include <emmintrin.h>
+#else
+#define INC_STREAMING_COPY_SSE2 0
+#endif
+
+namespace
+{
+constexpr unsigned gc_max_num_threads = 32;
+
+void copy_row_streaming(std::byte* __restrict dest, std::byte const* __restrict src, size_t size)
+{
+#if INC_STREAMING_COPY_SSE2
+    // align the destination to 16 bytes, streaming stores require it
+    size_t const head = cc::min<size_t>(size, (16 - (reinterpret_cast<uintptr_t>(dest) & 15)) & 15);
+    std::memcpy(dest, src, head);
+    dest += head;
+    src += head;
+    size -= head;
+
+    // full 64 byte lines, the write-combining buffers are flushed in whole
+    while (size >= 64)
+    {
+        __m128i const v0 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src) + 0);
+        __m128i const v1 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src) + 1);
+        __m128i const v2 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src) + 2);
+        __m128i const v3 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src) + 3);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dest) + 0, v0);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dest) + 1, v1);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dest) + 2, v2);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dest) + 3, v3);
+        dest += 64;
+        src += 64;
+        size -= 64;
+    }
+
+    while (size >= 16)
+    {
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dest), _mm_loadu_si128(reinterpret_cast<__m128i const*>(src)));
+        dest += 16;
+        src += 16;
+        size -= 16;
+    }
+#endif
+
+    std::memcpy(dest, src, size);
+}
+
+// copies the linearized rows [row_start, row_end) across all slices
+void copy_rows(inc::assets::strided_copy_desc const& desc, size_t row_start, size_t row_end)
+{
+    for (auto i = row_start; i < row_end; ++i)
+    {
+        size_t const slice = i / desc.num_rows;
+        size_t const row = i % desc.num_rows;
+
+        std::byte const* const src = desc.src + slice * desc.src_slice_stride_bytes + row * desc.src_row_stride_bytes;
+        std::byte* const dest = desc.dest + slice * desc.dest_slice_stride_bytes + row * desc.dest_row_stride_bytes;
+        copy_row_streaming(dest, src, desc.row_size_bytes);
+    }
+
+#if INC_STREAMING_COPY_SSE2
+    // make the non-temporal stores globally visible before the thread is joined
+    _mm_sfence();
+#endif
+}
+}
+
+void inc::assets::streaming_copy(const inc::assets::strided_copy_desc& desc, unsigned max_num_threads, size_t multithread_threshold_bytes)
+{
+    CC_ASSERT(desc.row_size_bytes <= desc.dest_row_stride_bytes && "destination rows overlap");
+    CC_ASSERT((desc.num_slices <= 1 || desc.num_rows * desc.dest_row_stride_bytes <= desc.dest_slice_stride_bytes) && "destination slices overlap");
+
+    size_t const num_rows_total = size_t(desc.num_rows) * desc.num_slices;
+    size_t const num_bytes_total = num_rows_total * desc.row_size_bytes;
+
+    if (num_rows_total == 0)
+        return;
+
+    unsigned num_threads = 1;
+    if (num_bytes_total > multithread_threshold_bytes)
+    {
+        unsigned const max_threads = max_num_threads > 0 ? max_num_threads : cc::max(1u, std::thread::hardware_concurrency());
+        num_threads = unsigned(cc::min<size_t>(cc::min<size_t>(max_threads, gc_max_num_threads), num_rows_total));
+
+        // at least the threshold size per thread
+        num_threads = unsigned(cc::min<size_t>(num_threads, cc::max<size_t>(1, num_bytes_total / multithread_threshold_bytes)));
+    }
+
+    if (num_threads <= 1)
+    {
+        copy_rows(desc, 0, num_rows_total);
+        return;
+    }
+
+    size_t const rows_per_thread = (num_rows_total + num_threads - 1) / num_threads;
+
+    cc::capped_vector<std::thread, gc_max_num_threads> workers;
+    for (auto i = 1u; i < num_threads; ++i)
+    {
+        size_t const start = i * rows_per_thread;
+        size_t const end = cc::min(start + rows_per_thread, num_rows_total);
+        if (start >= end)
+            break;
+
+        workers.emplace_back([&desc, start, end] { copy_rows(desc, start, end); });
+    }
+
+    // the calling thread takes the first range
+    copy_rows(desc, 0, cc::min(rows_per_thread, num_rows_total));
+
+    for (auto& worker : workers)
+        worker.join();
+}
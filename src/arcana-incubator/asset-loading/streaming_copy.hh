@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+
+namespace inc::assets
+{
+/// a 2D (optionally arrayed) copy with independent source and destination strides
+struct strided_copy_desc
+{
+    std::byte const* src = nullptr;
+    std::byte* dest = nullptr;
+
+    size_t row_size_bytes = 0;
+    size_t src_row_stride_bytes = 0;
+    size_t dest_row_stride_bytes = 0; // in D3D12, texture upload rows are 256-byte aligned
+    unsigned num_rows = 0;
+
+    unsigned num_slices = 1;
+    size_t src_slice_stride_bytes = 0;
+    size_t dest_slice_stride_bytes = 0;
+};
+
+/// copies rows to write-combined memory (ie. a mapped upload buffer) using non-temporal stores
+/// rows are split across threads if the total size exceeds multithread_threshold_bytes
+/// max_num_threads: 0 for std::thread::hardware_concurrency
+void streaming_copy(strided_copy_desc const& desc, unsigned max_num_threads = 0, size_t multithread_threshold_bytes = 4ull * 1024 * 1024);
+}
@@ -0,0 +1,151 @@
+#include "texture_atlas.hh"
+
+#include <cstring>
+
+#include <clean-core/assert.hh>
+#include <clean-core/utility.hh>
+
+#include <arcana-incubator/imgui/lib/imstb_rectpack.h>
+
+namespace
+{
+// copies an image into a page, surrounded by gutter texels that repeat its border
+void write_padded_image(std::byte* page, size_t page_row_size, std::byte const* src, unsigned width, unsigned height, size_t texel_size, unsigned dest_x, unsigned dest_y, unsigned gutter)
+{
+    size_t const src_row_size = width * texel_size;
+
+    for (auto y = 0u; y < height + 2 * gutter; ++y)
+    {
+        unsigned const src_y = unsigned(cc::clamp(int(y) - int(gutter), 0, int(height) - 1));
+        std::byte const* const src_row = src + src_y * src_row_size;
+        std::byte* dest = page + (dest_y - gutter + y) * page_row_size + (dest_x - gutter) * texel_size;
+
+        for (auto x = 0u; x < gutter; ++x, dest += texel_size)
+            std::memcpy(dest, src_row, texel_size);
+
+        std::memcpy(dest, src_row, src_row_size);
+        dest += src_row_size;
+
+        for (auto x = 0u; x < gutter; ++x, dest += texel_size)
+            std::memcpy(dest, src_row + src_row_size - texel_size, texel_size);
+    }
+}
+}
+
+void inc::assets::texture_atlas::free()
+{
+    for (auto const& page : pages)
+        inc::assets::free(page);
+
+    pages.clear();
+    entries.clear();
+}
+
+inc::assets::texture_atlas inc::assets::build_texture_atlas(cc::span<const inc::assets::image_data> images,
+                                                            cc::span<const inc::assets::image_size> sizes,
+                                                            const inc::assets::texture_atlas_params& params,
+                                                            cc::allocator* alloc)
+{
+    CC_ASSERT(images.size() == sizes.size() && "image and size count mismatch");
+    CC_ASSERT(params.num_mips > 0 && params.num_mips <= 16 && "invalid amount of mips");
+
+    texture_atlas res;
+    res.pages = cc::alloc_vector<image_data>(alloc);
+    res.entries = cc::alloc_vector<texture_atlas_entry>::defaulted(images.size(), alloc);
+    res.page_size = {params.page_width, params.page_height, params.num_mips, 1};
+
+    if (images.empty())
+        return res;
+
+    uint8_t const num_channels = images[0].num_channels;
+    bool const is_hdr = images[0].is_hdr;
+    size_t const texel_size = size_t(num_channels) * (is_hdr ? sizeof(float) : 1);
+
+    // packing happens on a grid of mip-aligned cells, so the image origin and the gutters are multiples of the alignment
+    unsigned const alignment = 1u << (params.num_mips - 1);
+    unsigned const gutter = params.padding * alignment;
+    CC_ASSERT(params.page_width % alignment == 0 && params.page_height % alignment == 0 && "page size must be a multiple of the mip alignment");
+
+    int const grid_width = int(params.page_width / alignment);
+    int const grid_height = int(params.page_height / alignment);
+
+    cc::alloc_vector<stbrp_rect> pending(alloc);
+    pending.reserve(images.size());
+
+    for (auto i = 0u; i < images.size(); ++i)
+    {
+        CC_ASSERT(images[i].num_channels == num_channels && images[i].is_hdr == is_hdr && "all images in an atlas must have the same format");
+
+        int const cells_x = int((sizes[i].width + 2 * gutter + alignment - 1) / alignment);
+        int const cells_y = int((sizes[i].height + 2 * gutter + alignment - 1) / alignment);
+
+        // images larger than a page are left out, their entry page stays invalid
+        if (cells_x > grid_width || cells_y > grid_height)
+            continue;
+
+        stbrp_rect& rect = pending.emplace_back();
+        rect.id = int(i);
+        rect.w = stbrp_coord(cells_x);
+        rect.h = stbrp_coord(cells_y);
+        rect.x = 0;
+        rect.y = 0;
+        rect.was_packed = 0;
+    }
+
+    auto nodes = cc::alloc_vector<stbrp_node>::uninitialized(size_t(grid_width), alloc);
+    cc::alloc_vector<stbrp_rect> remaining(alloc);
+    remaining.reserve(pending.size());
+
+    // fill one page at a time, leftovers go to the next
+    while (!pending.empty())
+    {
+        unsigned const page_index = unsigned(res.pages.size());
+
+        stbrp_context context;
+        stbrp_init_target(&context, grid_width, grid_height, nodes.data(), grid_width);
+        stbrp_pack_rects(&context, pending.data(), int(pending.size()));
+
+        image_data& page = res.pages.emplace_back();
+        page.raw_size_bytes = size_t(params.page_width) * params.page_height * texel_size;
+        page.num_channels = num_channels;
+        page.is_hdr = is_hdr;
+        page.alloc = alloc;
+        {
+            // allocated like decoder results, so assets::free applies
+            detail::scoped_stbi_allocator const scoped_alloc(alloc);
+            page.raw = detail::stbi_hook_malloc(page.raw_size_bytes);
+        }
+        CC_RUNTIME_ASSERT(page.raw != nullptr && "failed to allocate atlas page");
+        std::memset(page.raw, 0, page.raw_size_bytes);
+
+        remaining.clear();
+        for (auto const& rect : pending)
+        {
+            if (!rect.was_packed)
+            {
+                remaining.push_back(rect);
+                continue;
+            }
+
+            auto const i = unsigned(rect.id);
+            texture_atlas_entry& entry = res.entries[i];
+            entry.page = page_index;
+            entry.x = unsigned(rect.x) * alignment + gutter;
+            entry.y = unsigned(rect.y) * alignment + gutter;
+            entry.width = sizes[i].width;
+            entry.height = sizes[i].height;
+            entry.u0 = float(entry.x) / params.page_width;
+            entry.v0 = float(entry.y) / params.page_height;
+            entry.u1 = float(entry.x + entry.width) / params.page_width;
+            entry.v1 = float(entry.y + entry.height) / params.page_height;
+
+            write_padded_image(static_cast<std::byte*>(page.raw), params.page_width * texel_size, static_cast<std::byte const*>(images[i].raw),
+                               entry.width, entry.height, texel_size, entry.x, entry.y, gutter);
+        }
+
+        CC_ASSERT(remaining.size() < pending.size() && "no progress packing atlas page");
+        cc::swap(pending, remaining);
+    }
+
+    return res;
+}
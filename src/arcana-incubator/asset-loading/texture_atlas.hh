@@ -0,0 +1,62 @@
+#pragma once
+
+#include <clean-core/alloc_vector.hh>
+#include <clean-core/allocator.hh>
+#include <clean-core/span.hh>
+
+#include "image_loader.hh"
+
+namespace inc::assets
+{
+inline constexpr unsigned gc_invalid_atlas_page = unsigned(-1);
+
+struct texture_atlas_params
+{
+    unsigned page_width = 1024;
+    unsigned page_height = 1024;
+
+    /// texels of clamped border around each image, in mip 0
+    unsigned padding = 1;
+
+    /// amount of mips the pages will be sampled with (including mip 0)
+    /// images are aligned to 2^(num_mips-1) texels and the padding is scaled by it, so no mip level bleeds into neighbors
+    unsigned num_mips = 1;
+};
+
+struct texture_atlas_entry
+{
+    unsigned page = gc_invalid_atlas_page; // gc_invalid_atlas_page if the image does not fit into a page
+
+    // rect of the image in the page, in texels, excluding the padding
+    unsigned x = 0;
+    unsigned y = 0;
+    unsigned width = 0;
+    unsigned height = 0;
+
+    // the same rect in UV space (top left and bottom right)
+    float u0 = 0.f;
+    float v0 = 0.f;
+    float u1 = 0.f;
+    float v1 = 0.f;
+};
+
+struct texture_atlas
+{
+    /// one image per page, page_width x page_height, free with assets::free
+    cc::alloc_vector<image_data> pages;
+    image_size page_size = {};
+
+    /// one entry per input image, in input order
+    cc::alloc_vector<texture_atlas_entry> entries;
+
+    void free();
+};
+
+/// packs many small images into as few pages as possible (stb_rect_pack skyline)
+/// all images must have the same amount of channels and must all be either LDR or HDR
+/// page memory is allocated from alloc, the input images are not modified
+[[nodiscard]] texture_atlas build_texture_atlas(cc::span<image_data const> images,
+                                                cc::span<image_size const> sizes,
+                                                texture_atlas_params const& params = {},
+                                                cc::allocator* alloc = cc::system_allocator);
+}
@@ -0,0 +1,342 @@
+#include "tiled_image.hh"
+
+#include <cstring>
+#include <type_traits>
+
+#include <clean-core/alloc_array.hh>
+#include <clean-core/assert.hh>
+#include <clean-core/capped_vector.hh>
+#include <clean-core/utility.hh>
+
+namespace
+{
+constexpr uint32_t gc_tiled_image_magic = 0x4C495449; // "ITIL"
+constexpr uint32_t gc_tiled_image_version = 1;
+constexpr unsigned gc_max_num_levels = 32;
+
+bool is_pnm_whitespace(int c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+// reads an unsigned integer from a PNM header, skipping whitespace and comments
+bool read_pnm_header_value(std::ifstream& file, unsigned& out_value)
+{
+    int c = file.get();
+    while (is_pnm_whitespace(c) || c == '#')
+    {
+        if (c == '#')
+        {
+            while (c != '\n' && c != EOF)
+                c = file.get();
+        }
+
+        c = file.get();
+    }
+
+    if (c < '0' || c > '9')
+        return false;
+
+    out_value = 0;
+    while (c >= '0' && c <= '9')
+    {
+        out_value = out_value * 10 + unsigned(c - '0');
+        c = file.get();
+    }
+
+    // exactly one whitespace character terminates the value
+    return is_pnm_whitespace(c);
+}
+
+template <class T>
+void downsample_row(std::byte const* row_a, std::byte const* row_b, std::byte* dest, unsigned src_width, unsigned dest_width, unsigned num_channels)
+{
+    auto const* const a = reinterpret_cast<T const*>(row_a);
+    auto const* const b = reinterpret_cast<T const*>(row_b);
+    auto* const out = reinterpret_cast<T*>(dest);
+
+    for (auto x = 0u; x < dest_width; ++x)
+    {
+        unsigned const x0 = cc::min(2 * x, src_width - 1) * num_channels;
+        unsigned const x1 = cc::min(2 * x + 1, src_width - 1) * num_channels;
+
+        for (auto c = 0u; c < num_channels; ++c)
+        {
+            if constexpr (std::is_same_v<T, float>)
+                out[x * num_channels + c] = (a[x0 + c] + a[x1 + c] + b[x0 + c] + b[x1 + c]) * 0.25f;
+            else
+                out[x * num_channels + c] = T((uint32_t(a[x0 + c]) + a[x1 + c] + b[x0 + c] + b[x1 + c] + 2) / 4);
+        }
+    }
+}
+
+struct level_state
+{
+    unsigned width = 0;
+    unsigned height = 0;
+    unsigned num_rows_received = 0;
+    unsigned num_band_rows = 0;
+    unsigned band_index = 0;
+
+    cc::alloc_array<std::byte> band;            // tile_size rows of this level
+    cc::alloc_array<std::byte> pending_row;     // even row waiting for its odd partner
+    cc::alloc_array<std::byte> downsampled_row; // a single row of the next level
+};
+
+struct tile_writer
+{
+    inc::assets::tiled_image_info const& info;
+    std::ofstream& file;
+    size_t pixel_size = 0;
+
+    cc::capped_vector<level_state, gc_max_num_levels> levels;
+    cc::alloc_array<std::byte> tile_scratch;
+
+    tile_writer(inc::assets::tiled_image_info const& info, std::ofstream& file) : info(info), file(file) {}
+
+    std::byte* get_band_row(level_state& l, unsigned row) { return l.band.data() + size_t(row) * l.width * pixel_size; }
+
+    void downsample(std::byte const* row_a, std::byte const* row_b, std::byte* dest, unsigned src_width, unsigned dest_width)
+    {
+        switch (info.bytes_per_channel)
+        {
+        case 1:
+            downsample_row<uint8_t>(row_a, row_b, dest, src_width, dest_width, info.num_channels);
+            break;
+        case 2:
+            downsample_row<uint16_t>(row_a, row_b, dest, src_width, dest_width, info.num_channels);
+            break;
+        default:
+            downsample_row<float>(row_a, row_b, dest, src_width, dest_width, info.num_channels);
+            break;
+        }
+    }
+
+    // copy a row into the band of a level, then process it
+    void push_row(unsigned level, std::byte const* row)
+    {
+        level_state& l = levels[level];
+        std::memcpy(get_band_row(l, l.num_band_rows), row, l.width * pixel_size);
+        on_row_added(level);
+    }
+
+    // process the latest row in the band of a level
+    void on_row_added(unsigned level)
+    {
+        level_state& l = levels[level];
+        std::byte const* const row = get_band_row(l, l.num_band_rows);
+        unsigned const row_index = l.num_rows_received;
+        ++l.num_band_rows;
+        ++l.num_rows_received;
+
+        // feed the next mip level, 2x2 box filter
+        if (level + 1 < levels.size())
+        {
+            level_state& next = levels[level + 1];
+            if (next.num_rows_received < next.height)
+            {
+                if (row_index % 2 == 0 && row_index + 1 < l.height)
+                {
+                    std::memcpy(l.pending_row.data(), row, l.width * pixel_size);
+                }
+                else
+                {
+                    // odd rows, or the single row of a level with a height of 1
+                    std::byte const* const row_a = row_index % 2 == 0 ? row : l.pending_row.data();
+                    downsample(row_a, row, l.downsampled_row.data(), l.width, next.width);
+                    push_row(level + 1, l.downsampled_row.data());
+                }
+            }
+        }
+
+        if (l.num_band_rows == info.tile_size || l.num_rows_received == l.height)
+            emit_band(level);
+    }
+
+    void emit_band(unsigned level)
+    {
+        level_state& l = levels[level];
+        unsigned const num_tiles_x = info.get_num_tiles_x(level);
+        size_t const tile_row_size = size_t(info.tile_size) * pixel_size;
+
+        for (auto tx = 0u; tx < num_tiles_x; ++tx)
+        {
+            unsigned const x_start = tx * info.tile_size;
+            unsigned const num_valid_columns = cc::min(info.tile_size, l.width - x_start);
+
+            for (auto y = 0u; y < info.tile_size; ++y)
+            {
+                std::byte* const dest_row = tile_scratch.data() + y * tile_row_size;
+                std::byte const* const src_row = get_band_row(l, cc::min(y, l.num_band_rows - 1)) + x_start * pixel_size;
+
+                std::memcpy(dest_row, src_row, num_valid_columns * pixel_size);
+
+                // pad by repeating the last column
+                for (auto x = num_valid_columns; x < info.tile_size; ++x)
+                    std::memcpy(dest_row + x * pixel_size, src_row + (num_valid_columns - 1) * pixel_size, pixel_size);
+            }
+
+            file.seekp(std::streamoff(info.get_tile_offset_bytes(level, tx, l.band_index)));
+            file.write(reinterpret_cast<char const*>(tile_scratch.data()), std::streamsize(tile_scratch.size()));
+        }
+
+        ++l.band_index;
+        l.num_band_rows = 0;
+    }
+};
+}
+
+bool inc::assets::pnm_scanline_source::open(const char* path)
+{
+    _file = std::ifstream(path, std::ios::binary);
+    if (!_file.good())
+        return false;
+
+    char magic[2];
+    _file.read(magic, 2);
+    if (!_file.good() || magic[0] != 'P' || (magic[1] != '5' && magic[1] != '6'))
+        return false;
+
+    unsigned max_value = 0;
+    if (!read_pnm_header_value(_file, width) || !read_pnm_header_value(_file, height) || !read_pnm_header_value(_file, max_value))
+        return false;
+
+    if (width == 0 || height == 0 || max_value == 0 || max_value > 65535)
+        return false;
+
+    num_channels = magic[1] == '5' ? 1 : 3;
+    bytes_per_channel = max_value > 255 ? 2 : 1;
+    return true;
+}
+
+bool inc::assets::pnm_scanline_source::read_rows(std::byte* dest, unsigned num_rows)
+{
+    size_t const num_bytes = get_row_size_bytes() * num_rows;
+    _file.read(reinterpret_cast<char*>(dest), std::streamsize(num_bytes));
+    if (!_file.good())
+        return false;
+
+    if (bytes_per_channel == 2)
+    {
+        // 16 bit PNM is big endian
+        for (auto i = 0u; i < num_bytes; i += 2)
+            cc::swap(dest[i], dest[i + 1]);
+    }
+
+    return true;
+}
+
+bool inc::assets::raw_scanline_source::open(const char* path, unsigned width, unsigned height, unsigned num_channels, unsigned bytes_per_channel, size_t header_size_bytes)
+{
+    CC_ASSERT((bytes_per_channel == 1 || bytes_per_channel == 2 || bytes_per_channel == 4) && "invalid channel size");
+
+    _file = std::ifstream(path, std::ios::binary);
+    if (!_file.good())
+        return false;
+
+    _file.seekg(std::streamoff(header_size_bytes));
+
+    this->width = width;
+    this->height = height;
+    this->num_channels = num_channels;
+    this->bytes_per_channel = bytes_per_channel;
+    return _file.good();
+}
+
+bool inc::assets::raw_scanline_source::read_rows(std::byte* dest, unsigned num_rows)
+{
+    _file.read(reinterpret_cast<char*>(dest), std::streamsize(get_row_size_bytes() * num_rows));
+    return _file.good();
+}
+
+size_t inc::assets::tiled_image_info::get_tile_offset_bytes(unsigned level, unsigned tile_x, unsigned tile_y) const
+{
+    size_t num_preceding_tiles = 0;
+    for (auto l = 0u; l < level; ++l)
+        num_preceding_tiles += size_t(get_num_tiles_x(l)) * get_num_tiles_y(l);
+
+    num_preceding_tiles += size_t(tile_y) * get_num_tiles_x(level) + tile_x;
+    return sizeof(tiled_image_info) + num_preceding_tiles * get_tile_size_bytes();
+}
+
+bool inc::assets::write_tiled_image_cache(inc::assets::scanline_source& source, const char* out_path, unsigned tile_size, cc::allocator* alloc)
+{
+    CC_ASSERT(tile_size > 0 && "invalid tile size");
+    if (source.width == 0 || source.height == 0)
+        return false;
+
+    tiled_image_info info;
+    info.magic = gc_tiled_image_magic;
+    info.version = gc_tiled_image_version;
+    info.width = source.width;
+    info.height = source.height;
+    info.num_channels = source.num_channels;
+    info.bytes_per_channel = source.bytes_per_channel;
+    info.tile_size = tile_size;
+
+    // mip levels down to a single tile
+    info.num_mips = 1;
+    while (cc::max(info.get_level_width(info.num_mips - 1), info.get_level_height(info.num_mips - 1)) > tile_size && info.num_mips < gc_max_num_levels)
+        ++info.num_mips;
+
+    auto file = std::ofstream(out_path, std::ios::binary | std::ios::trunc);
+    if (!file.good())
+        return false;
+
+    file.write(reinterpret_cast<char const*>(&info), sizeof(info));
+
+    // allocate the full file upfront, tiles of different levels are written out of order
+    size_t const file_size = info.get_tile_offset_bytes(info.num_mips, 0, 0);
+    file.seekp(std::streamoff(file_size - 1));
+    file.put(0);
+
+    tile_writer writer(info, file);
+    writer.pixel_size = size_t(info.num_channels) * info.bytes_per_channel;
+    writer.tile_scratch = cc::alloc_array<std::byte>::uninitialized(info.get_tile_size_bytes(), alloc);
+
+    for (auto i = 0u; i < info.num_mips; ++i)
+    {
+        level_state& l = writer.levels.emplace_back();
+        l.width = info.get_level_width(i);
+        l.height = info.get_level_height(i);
+        l.band = cc::alloc_array<std::byte>::uninitialized(size_t(tile_size) * l.width * writer.pixel_size, alloc);
+
+        if (i + 1 < info.num_mips)
+        {
+            l.pending_row = cc::alloc_array<std::byte>::uninitialized(l.width * writer.pixel_size, alloc);
+            l.downsampled_row = cc::alloc_array<std::byte>::uninitialized(info.get_level_width(i + 1) * writer.pixel_size, alloc);
+        }
+    }
+
+    // decode level 0 band by band, directly into its band buffer
+    level_state& level0 = writer.levels[0];
+    while (level0.num_rows_received < level0.height)
+    {
+        unsigned const num_rows = cc::min(tile_size, level0.height - level0.num_rows_received);
+        if (!source.read_rows(writer.get_band_row(level0, 0), num_rows))
+            return false;
+
+        for (auto i = 0u; i < num_rows; ++i)
+            writer.on_row_added(0);
+    }
+
+    file.close();
+    return !file.fail();
+}
+
+bool inc::assets::tiled_image_reader::open(const char* path)
+{
+    _file = std::ifstream(path, std::ios::binary);
+    if (!_file.good())
+        return false;
+
+    _file.read(reinterpret_cast<char*>(&info), sizeof(info));
+    return _file.good() && info.magic == gc_tiled_image_magic && info.version == gc_tiled_image_version;
+}
+
+bool inc::assets::tiled_image_reader::read_tile(unsigned level, unsigned tile_x, unsigned tile_y, cc::span<std::byte> dest)
+{
+    CC_ASSERT(level < info.num_mips && tile_x < info.get_num_tiles_x(level) && tile_y < info.get_num_tiles_y(level) && "tile out of bounds");
+    CC_ASSERT(dest.size() >= info.get_tile_size_bytes() && "destination too small");
+
+    _file.seekg(std::streamoff(info.get_tile_offset_bytes(level, tile_x, tile_y)));
+    _file.read(reinterpret_cast<char*>(dest.data()), std::streamsize(info.get_tile_size_bytes()));
+    return _file.good();
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+
+#include <clean-core/allocator.hh>
+#include <clean-core/span.hh>
+
+namespace inc::assets
+{
+/// a source of image rows, decoded incrementally from top to bottom
+/// rows are tightly packed, channels are interleaved
+struct scanline_source
+{
+    virtual ~scanline_source() = default;
+
+    /// reads the next num_rows rows into dest, returns false on failure
+    virtual bool read_rows(std::byte* dest, unsigned num_rows) = 0;
+
+    unsigned width = 0;
+    unsigned height = 0;
+    unsigned num_channels = 0;
+    unsigned bytes_per_channel = 0; // 1: uint8, 2: uint16, 4: float
+
+    size_t get_row_size_bytes() const { return size_t(width) * num_channels * bytes_per_channel; }
+};
+
+/// binary PGM / PPM (P5 / P6), 8 or 16 bit
+/// NOTE: PNG and JPEG cannot be band-decoded with stb_image, convert very large images to PNM or raw first
+struct pnm_scanline_source final : scanline_source
+{
+    [[nodiscard]] bool open(char const* path);
+    bool read_rows(std::byte* dest, unsigned num_rows) override;
+
+private:
+    std::ifstream _file;
+};
+
+/// headerless pixel data, ie. terrain heightmaps
+struct raw_scanline_source final : scanline_source
+{
+    [[nodiscard]] bool open(char const* path, unsigned width, unsigned height, unsigned num_channels, unsigned bytes_per_channel, size_t header_size_bytes = 0);
+    bool read_rows(std::byte* dest, unsigned num_rows) override;
+
+private:
+    std::ifstream _file;
+};
+
+/// header of a tiled image cache file
+/// the header is followed by all tiles of all mip levels, level-major and row-major within each level
+/// all tiles have the same size, tiles at the right and bottom edge are padded by repeating the last column / row
+struct tiled_image_info
+{
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t num_channels = 0;
+    uint32_t bytes_per_channel = 0;
+    uint32_t tile_size = 0;
+    uint32_t num_mips = 0;
+
+    unsigned get_level_width(unsigned level) const { return width >> level > 0 ? width >> level : 1u; }
+    unsigned get_level_height(unsigned level) const { return height >> level > 0 ? height >> level : 1u; }
+    unsigned get_num_tiles_x(unsigned level) const { return (get_level_width(level) + tile_size - 1) / tile_size; }
+    unsigned get_num_tiles_y(unsigned level) const { return (get_level_height(level) + tile_size - 1) / tile_size; }
+
+    size_t get_tile_size_bytes() const { return size_t(tile_size) * tile_size * num_channels * bytes_per_channel; }
+
+    /// offset of a tile from the start of the file
+    size_t get_tile_offset_bytes(unsigned level, unsigned tile_x, unsigned tile_y) const;
+};
+
+/// streams an image from source into a tiled cache file on disk, including a mip pyramid down to a single tile
+/// peak memory is roughly two bands of tile_size rows, independent of the image height
+[[nodiscard]] bool write_tiled_image_cache(scanline_source& source, char const* out_path, unsigned tile_size = 128, cc::allocator* alloc = cc::system_allocator);
+
+/// random access to the tiles of a cache file written by write_tiled_image_cache
+struct tiled_image_reader
+{
+    [[nodiscard]] bool open(char const* path);
+
+    /// reads a single tile, dest must be at least info.get_tile_size_bytes() large
+    [[nodiscard]] bool read_tile(unsigned level, unsigned tile_x, unsigned tile_y, cc::span<std::byte> dest);
+
+    tiled_image_info info;
+
+private:
+    std::ifstream _file;
+};
+}
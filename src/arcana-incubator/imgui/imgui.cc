@@ -1,9 +1,12 @@
 #include "imgui.hh"
 
+#include <clean-core/assert.hh>
+
 #include <phantasm-hardware-interface/Backend.hh>
 
 #include <phantasm-renderer/Frame.hh>
 
+#include <arcana-incubator/asset-loading/texture_atlas.hh>
 #include <arcana-incubator/imgui/imgui_impl_phi.hh>
 #include <arcana-incubator/imgui/imgui_impl_sdl2.hh>
 
@@ -546,3 +549,13 @@ void inc::imgui_discard_frame()
 {
     ImGui::EndFrame();
 }
+
+void inc::imgui_atlas_image(ImTextureID const* page_tex_ids, assets::texture_atlas_entry const& entry, ImVec2 size)
+{
+    CC_ASSERT(entry.page != assets::gc_invalid_atlas_page && "image is not part of the atlas");
+
+    if (size.x == 0.f && size.y == 0.f)
+        size = ImVec2(float(entry.width), float(entry.height));
+
+    ImGui::Image(page_tex_ids[entry.page], size, ImVec2(entry.u0, entry.v0), ImVec2(entry.u1, entry.v1));
+}
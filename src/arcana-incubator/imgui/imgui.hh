@@ -9,6 +9,11 @@
 
 struct SDL_Window;
 
+namespace inc::assets
+{
+struct texture_atlas_entry;
+}
+
 namespace inc
 {
 // the backends in this folder are designed for standalone use
@@ -56,4 +61,8 @@ enum class imgui_theme
 
 IMGUI_IMPL_API void load_imgui_theme(imgui_theme theme);
 
+// draws an image packed into a texture atlas (see assets::build_texture_atlas)
+// page_tex_ids: the ImTextureID of each atlas page, size: (0, 0) to use the size of the image in texels
+IMGUI_IMPL_API void imgui_atlas_image(ImTextureID const* page_tex_ids, assets::texture_atlas_entry const& entry, ImVec2 size = ImVec2(0, 0));
+
 } // namespace inc
@@ -19,6 +19,7 @@
 
 #include <arcana-incubator/imgui/lib/imgui.h>
 #include <arcana-incubator/phi-util/texture_util.hh>
+#include <arcana-incubator/phi-util/upload_ring.hh>
 
 #ifndef INC_ENABLE_IMGUI_PHI_BINDLESS
 #define INC_ENABLE_IMGUI_PHI_BINDLESS 0
@@ -61,6 +62,7 @@ phi::format g_backbuffer_format = phi::format::none;
 int g_num_frames_in_flight = 0;
 phi::handle::pipeline_state g_pipeline_state = phi::handle::null_pipeline_state;
 phi::handle::resource g_font_texture = phi::handle::null_resource;
+inc::upload_ring* g_staging_ring = nullptr; // optional, for the font upload
 phi::handle::shader_view g_font_texture_sv = phi::handle::null_shader_view;
 
 
@@ -168,6 +170,7 @@ bool ImGui_ImplPHI_InitWithShaders(phi::Backend* backend,
     return true;
 }
 
+void ImGui_ImplPHI_SetStagingRing(inc::upload_ring* staging) { g_staging_ring = staging; }
 
 void ImGui_ImplPHI_Shutdown()
 {
@@ -547,8 +550,18 @@ bool ImGui_ImplPHI_InitWithoutPSO(phi::Backend* backend,
 
 
         uint32_t const upbuff_size = phi::util::get_texture_size_bytes_on_gpu(fontDesc, is_d3d12);
-        phi::handle::resource temp_upload_buffer
-            = backend->createBuffer(upbuff_size, 0, phi::resource_heap::upload, false, "ImGui_ImplPHI_InitWithShaders Upload Buffer");
+
+        inc::upload_allocation upload;
+        if (g_staging_ring != nullptr)
+        {
+            upload = g_staging_ring->allocate(upbuff_size);
+        }
+        else
+        {
+            upload.buffer = backend->createBuffer(upbuff_size, 0, phi::resource_heap::upload, false, "ImGui_ImplPHI_InitWithShaders Upload Buffer");
+            upload.data = backend->mapBuffer(upload.buffer);
+            upload.size = upbuff_size;
+        }
 
 
         {
@@ -558,15 +571,21 @@ bool ImGui_ImplPHI_InitWithoutPSO(phi::Backend* backend,
             auto& tcmd = writer.emplace_command<phi::cmd::transition_resources>();
             tcmd.add(g_font_texture, phi::resource_state::copy_dest);
 
-            inc::copy_data_to_texture(writer, temp_upload_buffer, backend->mapBuffer(temp_upload_buffer), g_font_texture, phi::format::rgba8un,
-                                      unsigned(width), unsigned(height), reinterpret_cast<std::byte const*>(pixels), is_d3d12);
-            backend->unmapBuffer(temp_upload_buffer);
+            inc::copy_data_to_texture(writer, upload.buffer, upload.data, g_font_texture, phi::format::rgba8un, unsigned(width), unsigned(height),
+                                      reinterpret_cast<std::byte const*>(pixels), is_d3d12, upload.offset);
+
+            if (g_staging_ring == nullptr)
+                backend->unmapBuffer(upload.buffer);
 
             auto& tcmd2 = writer.emplace_command<phi::cmd::transition_resources>();
             tcmd2.add(g_font_texture, phi::resource_state::shader_resource, phi::shader_stage_flags::pixel);
 
             auto const cmdl = backend->recordCommandList(writer.buffer(), writer.size());
             backend->submit(cc::span{cmdl});
+
+            // the ring releases its staging memory once the copy completes
+            if (g_staging_ring != nullptr)
+                g_staging_ring->signal_submit(phi::queue_type::direct);
         }
 
 #if INC_ENABLE_IMGUI_PHI_BINDLESS
@@ -586,15 +605,20 @@ bool ImGui_ImplPHI_InitWithoutPSO(phi::Backend* backend,
         }
 #endif
 
-        if (out_upload_buffer != nullptr)
+        if (g_staging_ring != nullptr)
+        {
+            if (out_upload_buffer != nullptr)
+                *out_upload_buffer = phi::handle::null_resource;
+        }
+        else if (out_upload_buffer != nullptr)
         {
             // write out upload buffer instead of flushing and freeing
-            *out_upload_buffer = temp_upload_buffer;
+            *out_upload_buffer = upload.buffer;
         }
         else
         {
             backend->flushGPU();
-            backend->free(temp_upload_buffer);
+            backend->free(upload.buffer);
         }
     }
 
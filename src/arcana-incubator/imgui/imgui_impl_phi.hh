@@ -16,6 +16,11 @@
 
 struct ImDrawData;
 
+namespace inc
+{
+struct upload_ring;
+}
+
 IMGUI_IMPL_API bool ImGui_ImplPHI_Init(phi::Backend* backend, int num_frames_in_flight, phi::format target_format);
 IMGUI_IMPL_API void ImGui_ImplPHI_Shutdown();
 IMGUI_IMPL_API void ImGui_ImplPHI_NewFrame();
@@ -62,6 +67,11 @@ IMGUI_IMPL_API bool ImGui_ImplPHI_InitWithoutPSO(phi::Backend* backend,
 #endif
                                                  phi::handle::resource* out_upload_buffer = nullptr);
 
+// Stages the font texture upload of the following Init* calls in an upload ring, nullptr to go back to a dedicated upload buffer
+// the ring must stay alive until the upload completes, Init* submits the copy and signals the ring without flushing the GPU
+// (out_upload_buffer is set to a null handle in this case)
+IMGUI_IMPL_API void ImGui_ImplPHI_SetStagingRing(inc::upload_ring* staging);
+
 // Returns the config info for the required PSO if you want to completely supply it yourself (use with ImGui_ImplPHI_InitWithoutPSO and _RenderDrawDataWithPSO)
 IMGUI_IMPL_API void ImGui_ImplPHI_GetDefaultPSOConfig(phi::format target_format,
                                                       phi::vertex_attribute_info out_vert_attrs[3],
@@ -1,63 +1,96 @@
 #include "mesh_util.hh"
 
 #include <cstdlib>
+#include <cstring>
 
+#include <clean-core/assert.hh>
 #include <clean-core/defer.hh>
 
 #include <phantasm-hardware-interface/Backend.hh>
 #include <phantasm-hardware-interface/commands.hh>
 
 #include <arcana-incubator/asset-loading/mesh_loader.hh>
+#include <arcana-incubator/phi-util/upload_ring.hh>
 
-inc::phi_mesh inc::load_mesh(phi::Backend& backend, const char* path, bool binary)
+namespace
+{
+// loads the mesh, creates its buffers and records their upload
+template <class F>
+phi::handle::command_list record_mesh_load(phi::Backend& backend, char const* path, bool binary, inc::phi_mesh& out_mesh, F&& f_get_upload)
 {
     using namespace phi;
 
-    handle::resource upload_buffer;
-
     auto const buffer_size = 1024ull * 2;
     auto* const buffer = static_cast<std::byte*>(std::malloc(buffer_size));
     CC_DEFER { std::free(buffer); };
     command_stream_writer writer(buffer, buffer_size);
 
-    inc::phi_mesh res;
+    auto const mesh_data = binary ? inc::assets::load_binary_mesh(path) : inc::assets::load_obj_mesh(path);
 
-    {
-        auto const mesh_data = binary ? inc::assets::load_binary_mesh(path) : inc::assets::load_obj_mesh(path);
+    out_mesh.num_indices = unsigned(mesh_data.indices.size());
 
-        res.num_indices = unsigned(mesh_data.indices.size());
+    auto const vert_size = uint32_t(mesh_data.vertices.size_bytes());
+    auto const ind_size = uint32_t(mesh_data.indices.size_bytes());
 
-        auto const vert_size = uint32_t(mesh_data.vertices.size_bytes());
-        auto const ind_size = uint32_t(mesh_data.indices.size_bytes());
+    out_mesh.vertex_buffer = backend.createBuffer(uint32_t(vert_size), sizeof(inc::assets::simple_vertex));
+    out_mesh.index_buffer = backend.createBuffer(uint32_t(ind_size), sizeof(uint32_t));
 
-        res.vertex_buffer = backend.createBuffer(uint32_t(vert_size), sizeof(inc::assets::simple_vertex));
-        res.index_buffer = backend.createBuffer(uint32_t(ind_size), sizeof(uint32_t));
+    inc::upload_allocation const upload = f_get_upload(size_t(vert_size) + ind_size);
+    inc::record_mesh_upload(writer, out_mesh.vertex_buffer, out_mesh.index_buffer, upload, mesh_data.vertices.data(), vert_size, mesh_data.indices.data(), ind_size);
+
+    return backend.recordCommandList(writer.buffer(), writer.size());
+}
+}
 
-        {
-            cmd::transition_resources tcmd;
-            tcmd.add(res.vertex_buffer, resource_state::copy_dest);
-            tcmd.add(res.index_buffer, resource_state::copy_dest);
-            writer.add_command(tcmd);
-        }
+void inc::record_mesh_upload(phi::command_stream_writer& writer,
+                             phi::handle::resource vertex_buffer,
+                             phi::handle::resource index_buffer,
+                             const inc::upload_allocation& upload,
+                             const void* vertices,
+                             size_t vertices_size_bytes,
+                             const void* indices,
+                             size_t indices_size_bytes)
+{
+    using namespace phi;
+    CC_ASSERT(upload.size >= vertices_size_bytes + indices_size_bytes && "upload allocation too small");
 
-        upload_buffer = backend.createUploadBuffer(unsigned(vert_size + ind_size));
-        std::byte* const upload_mapped = backend.mapBuffer(upload_buffer);
+    {
+        cmd::transition_resources tcmd;
+        tcmd.add(vertex_buffer, resource_state::copy_dest);
+        tcmd.add(index_buffer, resource_state::copy_dest);
+        writer.add_command(tcmd);
+    }
 
-        std::memcpy(upload_mapped, mesh_data.vertices.data(), vert_size);
-        std::memcpy(upload_mapped + vert_size, mesh_data.indices.data(), ind_size);
+    std::memcpy(upload.data, vertices, vertices_size_bytes);
+    std::memcpy(upload.data + vertices_size_bytes, indices, indices_size_bytes);
 
-        writer.add_command(cmd::copy_buffer(res.vertex_buffer, 0u, upload_buffer, 0u, vert_size));
-        writer.add_command(cmd::copy_buffer(res.index_buffer, 0u, upload_buffer, vert_size, ind_size));
+    writer.add_command(cmd::copy_buffer(vertex_buffer, 0u, upload.buffer, upload.offset, vertices_size_bytes));
+    writer.add_command(cmd::copy_buffer(index_buffer, 0u, upload.buffer, upload.offset + vertices_size_bytes, indices_size_bytes));
 
-        {
-            cmd::transition_resources tcmd;
-            tcmd.add(res.vertex_buffer, resource_state::vertex_buffer);
-            tcmd.add(res.index_buffer, resource_state::index_buffer);
-            writer.add_command(tcmd);
-        }
+    {
+        cmd::transition_resources tcmd;
+        tcmd.add(vertex_buffer, resource_state::vertex_buffer);
+        tcmd.add(index_buffer, resource_state::index_buffer);
+        writer.add_command(tcmd);
     }
+}
 
-    auto const setup_cmd_list = backend.recordCommandList(writer.buffer(), writer.size());
+inc::phi_mesh inc::load_mesh(phi::Backend& backend, const char* path, bool binary)
+{
+    using namespace phi;
+
+    handle::resource upload_buffer;
+
+    inc::phi_mesh res;
+    auto const setup_cmd_list = record_mesh_load(backend, path, binary, res, [&](size_t size_bytes) {
+        upload_buffer = backend.createUploadBuffer(unsigned(size_bytes));
+
+        inc::upload_allocation upload;
+        upload.buffer = upload_buffer;
+        upload.data = backend.mapBuffer(upload_buffer);
+        upload.size = size_bytes;
+        return upload;
+    });
 
     backend.unmapBuffer(upload_buffer);
     backend.submit(cc::span{setup_cmd_list});
@@ -66,3 +99,15 @@ inc::phi_mesh inc::load_mesh(phi::Backend& backend, const char* path, bool binar
 
     return res;
 }
+
+inc::phi_mesh inc::load_mesh(phi::Backend& backend, inc::upload_ring& staging, const char* path, bool binary)
+{
+    // vertices and indices are copied with buffer copies, 16 byte alignment suffices
+    inc::phi_mesh res;
+    auto const setup_cmd_list = record_mesh_load(backend, path, binary, res, [&](size_t size_bytes) { return staging.allocate(size_bytes, 16); });
+
+    backend.submit(cc::span{setup_cmd_list});
+    staging.signal_submit(phi::queue_type::direct);
+
+    return res;
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstddef>
+
+#include <phantasm-hardware-interface/fwd.hh>
 #include <phantasm-hardware-interface/types.hh>
 
 namespace phi
@@ -9,6 +12,9 @@ class Backend;
 
 namespace inc
 {
+struct upload_ring;
+struct upload_allocation;
+
 struct phi_mesh
 {
     phi::handle::resource vertex_buffer;
@@ -19,4 +25,19 @@ struct phi_mesh
 // loads a mesh, internally blocking (flushes GPU, resources immediately usable)
 [[nodiscard]] phi_mesh load_mesh(phi::Backend& backend, char const* path, bool binary = false);
 
+// loads a mesh, staged in the upload ring and submitted on the direct queue without waiting
+// resources are usable by all work submitted afterwards, preferable when loading many meshes
+[[nodiscard]] phi_mesh load_mesh(phi::Backend& backend, upload_ring& staging, char const* path, bool binary = false);
+
+// writes vertices and indices back to back into the upload allocation and records their copy,
+// the buffers end up in vertex_buffer / index_buffer state
+void record_mesh_upload(phi::command_stream_writer& writer,
+                        phi::handle::resource vertex_buffer,
+                        phi::handle::resource index_buffer,
+                        upload_allocation const& upload,
+                        void const* vertices,
+                        size_t vertices_size_bytes,
+                        void const* indices,
+                        size_t indices_size_bytes);
+
 }
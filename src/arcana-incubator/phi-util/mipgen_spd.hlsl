@@ -0,0 +1,206 @@
+// single-pass mip downsampler, used by texture_processing::generate_mips and texture_creator::generate_mips if present
+// compile as a compute shader named "mipgen_spd" next to the other mipgen shaders
+//
+// interface (see inc::spd_constants and inc::get_spd_setup in texture_util.hh):
+//   t0        mip 0 of all array slices (Texture2DArray)
+//   u0 - u11  mips 1 to 12 of all array slices, slots beyond the last mip alias it and are never written
+//   u12       one uint counter per array slice, must be zero before the first dispatch, the shader resets it
+//   b1        root constants (spd_constants)
+//   dispatch  ceil(width / 64) x ceil(height / 64) x array_size
+//
+// each workgroup reduces a 64x64 tile of mip 0 to mips 1 to 6 in groupshared memory
+// the last workgroup of a slice to finish (global atomic counter) reduces mip 6 to the remaining mips
+// texels of the next level average 2x2 texels of the previous one, clamped to its size (non-square and NPOT sizes)
+// mips are read back as UAVs in the last workgroup, this requires typed UAV loads of the texture format
+// (D3D12: TypedUAVLoadAdditionalFormats, Vulkan: shaderStorageImageReadWithoutFormat)
+
+struct spd_constants
+{
+    uint num_mips_and_flags; // bits 0-7: amount of mips to generate, bit 8: apply gamma
+    uint num_work_groups;    // per array slice
+};
+
+[[vk::push_constant]] ConstantBuffer<spd_constants> g_constants : register(b1, space0);
+
+Texture2DArray<float4> g_mip0 : register(t0, space0);
+
+globallycoherent RWTexture2DArray<float4> g_mip1 : register(u0, space0);
+globallycoherent RWTexture2DArray<float4> g_mip2 : register(u1, space0);
+globallycoherent RWTexture2DArray<float4> g_mip3 : register(u2, space0);
+globallycoherent RWTexture2DArray<float4> g_mip4 : register(u3, space0);
+globallycoherent RWTexture2DArray<float4> g_mip5 : register(u4, space0);
+globallycoherent RWTexture2DArray<float4> g_mip6 : register(u5, space0);
+globallycoherent RWTexture2DArray<float4> g_mip7 : register(u6, space0);
+globallycoherent RWTexture2DArray<float4> g_mip8 : register(u7, space0);
+globallycoherent RWTexture2DArray<float4> g_mip9 : register(u8, space0);
+globallycoherent RWTexture2DArray<float4> g_mip10 : register(u9, space0);
+globallycoherent RWTexture2DArray<float4> g_mip11 : register(u10, space0);
+globallycoherent RWTexture2DArray<float4> g_mip12 : register(u11, space0);
+
+globallycoherent RWStructuredBuffer<uint> g_counters : register(u12, space0);
+
+// level 1 of a 64x64 tile, reduced in place for the levels below
+groupshared float4 gs_texels[32][32];
+groupshared uint gs_prev_counter;
+
+float3 srgb_to_linear(float3 c) { return c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4); }
+float3 linear_to_srgb(float3 c) { return c <= 0.0031308 ? c * 12.92 : 1.055 * pow(c, 1.0 / 2.4) - 0.055; }
+
+// averaging happens in linear space, alpha is always linear
+float4 decode(float4 v, bool apply_gamma) { return apply_gamma ? float4(srgb_to_linear(v.rgb), v.a) : v; }
+float4 encode(float4 v, bool apply_gamma) { return apply_gamma ? float4(linear_to_srgb(v.rgb), v.a) : v; }
+
+uint2 get_level_size(uint2 mip0_size, uint level) { return max(uint2(1, 1), mip0_size >> level); }
+
+void store_mip(uint level, uint3 pos, float4 value)
+{
+    switch (level)
+    {
+    case 1: g_mip1[pos] = value; break;
+    case 2: g_mip2[pos] = value; break;
+    case 3: g_mip3[pos] = value; break;
+    case 4: g_mip4[pos] = value; break;
+    case 5: g_mip5[pos] = value; break;
+    case 6: g_mip6[pos] = value; break;
+    case 7: g_mip7[pos] = value; break;
+    case 8: g_mip8[pos] = value; break;
+    case 9: g_mip9[pos] = value; break;
+    case 10: g_mip10[pos] = value; break;
+    case 11: g_mip11[pos] = value; break;
+    default: g_mip12[pos] = value; break;
+    }
+}
+
+// only used for the levels reduced by the last workgroup, 6 to 11
+float4 load_mip(uint level, uint3 pos)
+{
+    switch (level)
+    {
+    case 6: return g_mip6[pos];
+    case 7: return g_mip7[pos];
+    case 8: return g_mip8[pos];
+    case 9: return g_mip9[pos];
+    case 10: return g_mip10[pos];
+    default: return g_mip11[pos];
+    }
+}
+
+[numthreads(256, 1, 1)]
+void main(uint3 group_id : SV_GroupID, uint local_index : SV_GroupIndex)
+{
+    uint const num_mips = g_constants.num_mips_and_flags & 0xFF;
+    bool const apply_gamma = (g_constants.num_mips_and_flags & (1u << 8)) != 0;
+    uint const slice = group_id.z;
+
+    uint2 mip0_size;
+    uint num_slices;
+    g_mip0.GetDimensions(mip0_size.x, mip0_size.y, num_slices);
+
+    // level 1, 32x32 texels per tile, 4 per thread
+    {
+        uint2 const level_size = get_level_size(mip0_size, 1);
+
+        for (uint i = local_index; i < 32 * 32; i += 256)
+        {
+            uint2 const local = uint2(i % 32, i / 32);
+            uint2 const dest = group_id.xy * 32 + local;
+
+            float4 sum = 0;
+            for (uint o = 0; o < 4; ++o)
+            {
+                uint2 const src = min(dest * 2 + uint2(o & 1, o >> 1), mip0_size - 1);
+                sum += decode(g_mip0.Load(int4(src, slice, 0)), apply_gamma);
+            }
+
+            float4 const value = sum * 0.25;
+            gs_texels[local.y][local.x] = value;
+
+            if (all(dest < level_size))
+                store_mip(1, uint3(dest, slice), encode(value, apply_gamma));
+        }
+
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    // levels 2 to 6 within the tile, at most one texel per thread
+    for (uint level = 2; level <= min(num_mips, 6u); ++level)
+    {
+        uint const tile_size = 64u >> level;
+        uint2 const src_size = get_level_size(mip0_size, level - 1);
+        uint2 const level_size = get_level_size(mip0_size, level);
+
+        uint2 const local = uint2(local_index % tile_size, local_index / tile_size);
+        uint2 const dest = group_id.xy * tile_size + local;
+        bool const is_active = local_index < tile_size * tile_size;
+
+        float4 value = 0;
+        if (is_active)
+        {
+            // source texels are clamped to the previous level, then converted to tile coordinates
+            // if the clamped texel lies in a preceding tile, dest is out of bounds and only read clamped itself
+            int2 const src_tile_origin = int2(group_id.xy * tile_size * 2);
+            for (uint o = 0; o < 4; ++o)
+            {
+                int2 const src = int2(min(dest * 2 + uint2(o & 1, o >> 1), src_size - 1));
+                int2 const src_local = clamp(src - src_tile_origin, 0, int(tile_size * 2 - 1));
+                value += gs_texels[src_local.y][src_local.x];
+            }
+
+            value *= 0.25;
+        }
+
+        // all reads of the previous level complete before it is overwritten
+        GroupMemoryBarrierWithGroupSync();
+
+        if (is_active)
+        {
+            gs_texels[local.y][local.x] = value;
+
+            if (all(dest < level_size))
+                store_mip(level, uint3(dest, slice), encode(value, apply_gamma));
+        }
+
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    if (num_mips <= 6)
+        return;
+
+    // make mip 6 of this tile visible to the other workgroups, then find the last one to finish
+    AllMemoryBarrierWithGroupSync();
+
+    if (local_index == 0)
+        InterlockedAdd(g_counters[slice], 1, gs_prev_counter);
+
+    GroupMemoryBarrierWithGroupSync();
+
+    if (gs_prev_counter != g_constants.num_work_groups - 1)
+        return;
+
+    // the next dispatch on this slice starts at zero again
+    if (local_index == 0)
+        g_counters[slice] = 0;
+
+    // the remaining levels from mip 6, which is at most 128x128
+    for (uint level = 7; level <= num_mips; ++level)
+    {
+        uint2 const src_size = get_level_size(mip0_size, level - 1);
+        uint2 const level_size = get_level_size(mip0_size, level);
+
+        for (uint i = local_index; i < level_size.x * level_size.y; i += 256)
+        {
+            uint2 const dest = uint2(i % level_size.x, i / level_size.x);
+
+            float4 sum = 0;
+            for (uint o = 0; o < 4; ++o)
+            {
+                uint2 const src = min(dest * 2 + uint2(o & 1, o >> 1), src_size - 1);
+                sum += decode(load_mip(level - 1, uint3(src, slice)), apply_gamma);
+            }
+
+            store_mip(level, uint3(dest, slice), encode(sum * 0.25, apply_gamma));
+        }
+
+        AllMemoryBarrierWithGroupSync();
+    }
+}
@@ -1,5 +1,7 @@
 #include "texture_creation.hh"
 
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 
 #include <clean-core/bits.hh>
@@ -13,6 +15,7 @@
 #include <phantasm-hardware-interface/common/format_size.hh>
 #include <phantasm-hardware-interface/util.hh>
 
+#include <arcana-incubator/asset-loading/brdf_lut.hh>
 #include <arcana-incubator/phi-util/shader_util.hh>
 #include <arcana-incubator/phi-util/texture_util.hh>
 #include <arcana-incubator/phi-util/unique_buffer.hh>
@@ -22,6 +25,33 @@ using namespace phi;
 namespace
 {
 constexpr auto gc_ibl_cubemap_format = format::rgba16f;
+constexpr auto gc_max_mip_array_size = 16u;
+
+constexpr size_t gc_staging_ring_size = 64ull * 1024 * 1024;
+
+// limits of batched, not yet submitted uploads
+// half the ring, the other half can be filled while a batch is in flight
+constexpr size_t gc_max_pending_upload_bytes = gc_staging_ring_size / 2;
+constexpr size_t gc_max_pending_cmd_lists = 64;
+
+void record_slice_barriers(command_stream_writer& writer, cc::span<cmd::transition_image_slices::slice_transition_info const> slice_barriers)
+{
+    cmd::transition_image_slices tcmd;
+
+    for (auto const& ti : slice_barriers)
+    {
+        if (tcmd.transitions.size() == limits::max_resource_transitions)
+        {
+            writer.add_command(tcmd);
+            tcmd.transitions.clear();
+        }
+
+        tcmd.transitions.push_back(ti);
+    }
+
+    if (!tcmd.transitions.empty())
+        writer.add_command(tcmd);
+}
 }
 
 
@@ -31,9 +61,13 @@ void inc::texture_creator::initialize(phi::Backend& backend, char const* shader_
 
     resources_to_free.reserve(1000);
     shader_views_to_free.reserve(1000);
-    pending_cmd_lists.reserve(100);
+    pending_cmd_lists.reserve(gc_max_pending_cmd_lists);
+    pending_submits.reserve(64);
+    upload_fence = backend.createFence();
+    staging.initialize(backend, gc_staging_ring_size);
     align_mip_rows = backend.getBackendType() == phi::backend_type::d3d12;
     this->backend = &backend;
+    std::snprintf(shader_path_prefix, sizeof(shader_path_prefix), "%s", shader_path);
 
     // create command stream buffer
     {
@@ -69,15 +103,39 @@ void inc::texture_creator::initialize(phi::Backend& backend, char const* shader_
         pso_mipgen_array = backend.createComputePipelineState(psoDesc);
     }
 
+    // load the single pass mip downsampler, if present
+    if (auto const sb_mipgen_spd = get_shader_binary(shader_path, "mipgen_spd", shader_ending); sb_mipgen_spd.is_valid())
+    {
+        // SRV: mip 0, UAVs: mips 1 to 12, atomic counters
+        cc::capped_vector<arg::shader_arg_shape, 1> arg_shape;
+        {
+            arg::shader_arg_shape shape = {};
+            shape.num_srvs = 1;
+            shape.num_uavs = inc::gc_spd_max_num_mips + 1;
+            arg_shape.push_back(shape);
+        }
+
+        pso_mipgen_spd = backend.createComputePipelineState(arg_shape, {sb_mipgen_spd.get(), sb_mipgen_spd.size()}, true);
+
+        // the counters must start at zero, the shader resets them after each use
+        auto const counters_size = unsigned(sizeof(uint32_t) * gc_max_mip_array_size);
+        spd_counter_buffer = backend.createBuffer(counters_size, sizeof(uint32_t), resource_heap::gpu, true);
+
+        auto const upload = staging.allocate(counters_size, sizeof(uint32_t));
+        std::memset(upload.data, 0, counters_size);
+
+        cmd::transition_resources tcmd;
+        tcmd.add(spd_counter_buffer, resource_state::copy_dest);
+        cmd_writer.add_command(tcmd);
+        cmd_writer.add_command(cmd::copy_buffer(spd_counter_buffer, 0u, upload.buffer, upload.offset, counters_size));
+    }
+
     // load IBL preparation shaders
     {
         auto const sb_equirect_cube = get_shader_binary(shader_path, "equirect_to_cube", shader_ending);
         auto const sb_specular_map_filter = get_shader_binary(shader_path, "specular_map_filter", shader_ending);
         auto const sb_irradiance_map_filter = get_shader_binary(shader_path, "irradiance_map_filter", shader_ending);
-        auto const sb_brdf_lut_gen = get_shader_binary(shader_path, "brdf_lut_gen", shader_ending);
-
-        CC_RUNTIME_ASSERT(sb_equirect_cube.is_valid() && sb_specular_map_filter.is_valid() && sb_irradiance_map_filter.is_valid()
-                          && sb_brdf_lut_gen.is_valid() && "failed to load shaders");
+        CC_RUNTIME_ASSERT(sb_equirect_cube.is_valid() && sb_specular_map_filter.is_valid() && sb_irradiance_map_filter.is_valid() && "failed to load shaders");
 
         cc::capped_vector<arg::shader_arg_shape, 1> arg_shape;
         {
@@ -94,62 +152,56 @@ void inc::texture_creator::initialize(phi::Backend& backend, char const* shader_
         pso_specular_map_filter = backend.createComputePipelineState(arg_shape, {sb_specular_map_filter.get(), sb_specular_map_filter.size()}, true);
 
         pso_irradiance_map_gen = backend.createComputePipelineState(arg_shape, {sb_irradiance_map_filter.get(), sb_irradiance_map_filter.size()});
-
-        cc::capped_vector<arg::shader_arg_shape, 1> arg_shape_single_uav;
-        {
-            arg::shader_arg_shape shape = {};
-            shape.num_uavs = 1;
-            arg_shape_single_uav.push_back(shape);
-        }
-
-        pso_brdf_lut_gen = backend.createComputePipelineState(arg_shape_single_uav, {sb_brdf_lut_gen.get(), sb_brdf_lut_gen.size()});
     }
 }
 
 void inc::texture_creator::free(Backend& backend)
 {
-    flush_cmdstream(true, true);
+    finish_uploads();
+    staging.destroy();
 
     std::free(commandstream_buffer);
+    backend.free(cc::span{upload_fence});
 
     backend.free(pso_mipgen);
     backend.free(pso_mipgen_gamma);
     backend.free(pso_mipgen_array);
 
+    if (pso_mipgen_spd.is_valid())
+    {
+        backend.free(pso_mipgen_spd);
+        backend.free(spd_counter_buffer);
+    }
+
     backend.free(pso_equirect_to_cube);
     backend.free(pso_specular_map_filter);
     backend.free(pso_irradiance_map_gen);
-    backend.free(pso_brdf_lut_gen);
+
+    if (pso_brdf_lut_gen.is_valid())
+        backend.free(pso_brdf_lut_gen);
 }
 
 handle::resource inc::texture_creator::load_texture(char const* path, phi::format format, bool include_mipmaps, bool apply_gamma)
 {
     CC_ASSERT((apply_gamma ? include_mipmaps : true) && "gamma setting meaningless without mipmap generation");
 
-    flush_cmdstream(true, false);
+    flush_cmdstream(false);
 
-    inc::assets::image_size img_size;
-    inc::assets::image_data img_data;
-    {
-        auto const num_components = phi::util::get_format_num_components(format);
-        auto const is_hdr = phi::util::get_format_size_bytes(format) / num_components > 1;
-        img_data = inc::assets::load_image(path, img_size, static_cast<int>(num_components), is_hdr);
-    }
-    CC_DEFER
-    {
-        inc::assets::free(img_data);
-    };
+    // read the encoded file, the image is decoded straight into the upload buffer
+    auto const file_data = inc::unique_buffer::create_from_binary_file(path);
+    CC_RUNTIME_ASSERT(file_data.is_valid() && "failed to load texture");
+
+    cc::span<std::byte const> const encoded_data = {file_data.data(), file_data.size()};
 
-    CC_RUNTIME_ASSERT(inc::assets::is_valid(img_data) && "failed to load texture");
+    inc::assets::image_size img_size;
+    bool const read_size_success = inc::assets::get_image_size(encoded_data, img_size);
+    CC_RUNTIME_ASSERT(read_size_success && "failed to load texture");
 
     auto const res_handle = backend->createTexture(format, {int(img_size.width), int(img_size.height)}, include_mipmaps ? img_size.num_mipmaps : 1,
                                                    texture_dimension::t2d, 1, true);
 
 
-    uint32_t const upbuff_size
-        = phi::util::get_texture_size_bytes({int(img_size.width), int(img_size.height), int(img_size.array_size)}, format, 1, align_mip_rows);
-    auto const upbuff_handle = backend->createUploadBuffer(upbuff_size);
-    resources_to_free.push_back(upbuff_handle);
+    auto const upload = staging.allocate(inc::get_upload_size_bytes(img_size, format, align_mip_rows));
 
     cmd_writer.add_command(cmd::begin_debug_label{"load_texture"});
 
@@ -159,17 +211,21 @@ handle::resource inc::texture_creator::load_texture(char const* path, phi::forma
         cmd_writer.add_command(transition_cmd);
     }
 
-    inc::copy_data_to_texture(cmd_writer, upbuff_handle, backend->mapBuffer(upbuff_handle), res_handle, format, img_size.width, img_size.height,
-                              static_cast<std::byte const*>(img_data.raw), align_mip_rows);
+    bool const decode_success = inc::decode_data_to_texture(cmd_writer, upload.buffer, upload.data, res_handle, format, img_size.width,
+                                                            img_size.height, encoded_data, align_mip_rows, upload.offset);
+    CC_RUNTIME_ASSERT(decode_success && "failed to load texture");
 
     if (include_mipmaps)
         generate_mips(res_handle, img_size, apply_gamma, format);
 
-    // make writes to the upload buffer visible
-    backend->unmapBuffer(upbuff_handle);
-
     cmd_writer.add_command(cmd::end_debug_label{});
 
+    // batch many loads into one submission, bounded by the staging memory in flight
+    if (staging.get_unsignaled_bytes() >= gc_max_pending_upload_bytes || pending_cmd_lists.size() + 1 >= gc_max_pending_cmd_lists)
+        submit_uploads();
+    else
+        free_completed_uploads();
+
     return res_handle;
 }
 
@@ -181,12 +237,12 @@ handle::resource inc::texture_creator::load_filtered_specular_map(const char* hd
     constexpr auto cube_height = 1024u;
     auto const cube_num_mips = phi::util::get_num_mips(cube_width, cube_height);
 
-    // this call full flushes, no need to do it ourselves
+    // this call starts a new command list, no need to do it ourselves
     auto const equirect_handle = load_texture(hdr_equirect_path, format::rgba32f, false);
-    resources_to_free.push_back(equirect_handle);
+    free_deferred(equirect_handle);
 
     auto const unfiltered_env_handle = backend->createTexture(gc_ibl_cubemap_format, {cube_width, cube_height}, cube_num_mips, texture_dimension::t2d, 6, true);
-    resources_to_free.push_back(unfiltered_env_handle);
+    free_deferred(unfiltered_env_handle);
 
     auto const filtered_env_handle = backend->createTexture(gc_ibl_cubemap_format, {cube_width, cube_height}, cube_num_mips, texture_dimension::t2d, 6, true);
 
@@ -204,7 +260,7 @@ handle::resource inc::texture_creator::load_filtered_specular_map(const char* hd
             srv_sampler.init_default(sampler_filter::min_mag_mip_linear);
 
             sv = backend->createShaderView(cc::span{sve_srv}, cc::span{sve_uav}, cc::span{srv_sampler}, true);
-            shader_views_to_free.push_back(sv);
+            free_deferred(sv);
         }
 
         // pre transition
@@ -274,7 +330,7 @@ handle::resource inc::texture_creator::load_filtered_specular_map(const char* hd
 
                 sve_uav.texture_info.mip_start = level;
                 auto const sv = backend->createShaderView(cc::span{sve_srv}, cc::span{sve_uav}, cc::span{default_sampler}, true);
-                shader_views_to_free.push_back(sv);
+                free_deferred(sv);
 
                 cmd::dispatch dcmd;
                 dcmd.init(pso_specular_map_filter, num_groups, num_groups, 6);
@@ -292,7 +348,7 @@ handle::resource inc::texture_creator::load_filtered_specular_map(const char* hd
 
 handle::resource inc::texture_creator::create_diffuse_irradiance_map(handle::resource filtered_specular_map)
 {
-    flush_cmdstream(true, false);
+    flush_cmdstream(false);
     constexpr auto cube_width = 32u;
     constexpr auto cube_height = 32u;
 
@@ -319,7 +375,7 @@ handle::resource inc::texture_creator::create_diffuse_irradiance_map(handle::res
         default_sampler.init_default(sampler_filter::min_mag_mip_linear);
 
         auto const sv = backend->createShaderView(cc::span{sve_srv}, cc::span{sve_uav}, cc::span{default_sampler}, true);
-        shader_views_to_free.push_back(sv);
+        free_deferred(sv);
 
         cmd::dispatch dcmd;
         dcmd.init(pso_irradiance_map_gen, cube_width / 32, cube_height / 32, 6);
@@ -334,7 +390,23 @@ handle::resource inc::texture_creator::create_diffuse_irradiance_map(handle::res
 
 handle::resource inc::texture_creator::create_brdf_lut(int width_height)
 {
-    flush_cmdstream(true, false);
+    flush_cmdstream(false);
+
+    if (!pso_brdf_lut_gen.is_valid())
+    {
+        char const* const shader_ending = backend->getBackendType() == phi::backend_type::d3d12 ? "dxil" : "spv";
+        auto const sb_brdf_lut_gen = get_shader_binary(shader_path_prefix, "brdf_lut_gen", shader_ending);
+        CC_RUNTIME_ASSERT(sb_brdf_lut_gen.is_valid() && "failed to load shaders");
+
+        cc::capped_vector<arg::shader_arg_shape, 1> arg_shape_single_uav;
+        {
+            arg::shader_arg_shape shape = {};
+            shape.num_uavs = 1;
+            arg_shape_single_uav.push_back(shape);
+        }
+
+        pso_brdf_lut_gen = backend->createComputePipelineState(arg_shape_single_uav, {sb_brdf_lut_gen.get(), sb_brdf_lut_gen.size()});
+    }
 
     auto const brdf_lut_handle = backend->createTexture(format::rg16f, {width_height, width_height}, 1, texture_dimension::t2d, 1, true);
 
@@ -352,7 +424,7 @@ handle::resource inc::texture_creator::create_brdf_lut(int width_height)
         sve_uav.init_as_tex2d(brdf_lut_handle, format::rg16f);
 
         auto const sv = backend->createShaderView({}, cc::span{sve_uav}, {}, true);
-        shader_views_to_free.push_back(sv);
+        free_deferred(sv);
 
         cmd::dispatch dcmd;
         dcmd.init(pso_brdf_lut_gen, width_height / 32, width_height / 32, 1);
@@ -366,9 +438,40 @@ handle::resource inc::texture_creator::create_brdf_lut(int width_height)
     return brdf_lut_handle;
 }
 
+handle::resource inc::texture_creator::load_brdf_lut(const char* cooked_path, int width_height)
+{
+    flush_cmdstream(false);
+
+    auto const lut = inc::assets::load_or_compute_brdf_lut(cooked_path, unsigned(width_height), unsigned(width_height));
+
+    auto const brdf_lut_handle = backend->createTexture(format::rg16f, {int(lut.width), int(lut.height)}, 1, texture_dimension::t2d, 1, false);
+
+    auto const upload = staging.allocate(inc::get_upload_size_bytes({lut.width, lut.height, 1, 1}, format::rg16f, align_mip_rows));
+
+    cmd_writer.add_command(cmd::begin_debug_label{"load_brdf_lut"});
+
+    {
+        cmd::transition_resources tcmd;
+        tcmd.add(brdf_lut_handle, resource_state::copy_dest);
+        cmd_writer.add_command(tcmd);
+    }
+
+    // the cooked texels are rg16f already, no conversion
+    inc::copy_data_to_texture(cmd_writer, upload.buffer, upload.data, brdf_lut_handle, format::rg16f, lut.width, lut.height,
+                              reinterpret_cast<std::byte const*>(lut.texels.data()), align_mip_rows, upload.offset);
+
+    cmd_writer.add_command(cmd::end_debug_label{});
+
+    return brdf_lut_handle;
+}
+
 void inc::texture_creator::generate_mips(handle::resource resource, const inc::assets::image_size& size, bool apply_gamma, format pf)
 {
-    constexpr auto max_array_size = 16u;
+    constexpr auto max_array_size = gc_max_mip_array_size;
+
+    if (pso_mipgen_spd.is_valid() && generate_mips_single_pass(resource, size, apply_gamma, pf))
+        return;
+
     CC_ASSERT(size.width == size.height && "non-square textures unimplemented");
     CC_ASSERT(cc::is_pow2(size.width) && "non-power of two textures unimplemented");
 
@@ -383,26 +486,6 @@ void inc::texture_creator::generate_mips(handle::resource resource, const inc::a
         matching_pso = apply_gamma ? pso_mipgen_gamma : pso_mipgen;
     }
 
-    auto const record_barriers = [this](cc::span<cmd::transition_image_slices::slice_transition_info const> slice_barriers)
-    {
-        cmd::transition_image_slices tcmd;
-
-        for (auto const& ti : slice_barriers)
-        {
-            if (tcmd.transitions.size() == limits::max_resource_transitions)
-            {
-                cmd_writer.add_command(tcmd);
-                tcmd.transitions.clear();
-            }
-
-            tcmd.transitions.push_back(ti);
-        }
-
-        if (!tcmd.transitions.empty())
-            cmd_writer.add_command(tcmd);
-    };
-
-
     cmd::transition_resources starting_tcmd;
     starting_tcmd.add(resource, resource_state::shader_resource, shader_stage_flags::compute);
     cmd_writer.add_command(starting_tcmd);
@@ -425,7 +508,7 @@ void inc::texture_creator::generate_mips(handle::resource resource, const inc::a
         sve_uav.texture_info.mip_start = level;
 
         auto const sv = backend->createShaderView(cc::span{sve}, cc::span{sve_uav}, {}, true);
-        shader_views_to_free.push_back(sv);
+        free_deferred(sv);
 
         cc::capped_vector<cmd::transition_image_slices::slice_transition_info, max_array_size> pre_dispatch;
         cc::capped_vector<cmd::transition_image_slices::slice_transition_info, max_array_size> post_dispatch;
@@ -441,7 +524,7 @@ void inc::texture_creator::generate_mips(handle::resource resource, const inc::a
         }
 
         // record pre-dispatch barriers
-        record_barriers(pre_dispatch);
+        record_slice_barriers(cmd_writer, pre_dispatch);
 
         // record compute dispatch
         cmd::dispatch dcmd;
@@ -450,11 +533,95 @@ void inc::texture_creator::generate_mips(handle::resource resource, const inc::a
         cmd_writer.add_command(dcmd);
 
         // record post-dispatch barriers
-        record_barriers(post_dispatch);
+        record_slice_barriers(cmd_writer, post_dispatch);
     }
 }
 
-void inc::texture_creator::flush_cmdstream(bool dispatch, bool stall)
+bool inc::texture_creator::generate_mips_single_pass(handle::resource resource, const inc::assets::image_size& size, bool apply_gamma, format pf)
+{
+    using slice_transition_info = cmd::transition_image_slices::slice_transition_info;
+
+    auto const num_mipmaps = size.num_mipmaps == 0 ? phi::util::get_num_mips(size.width, size.height) : size.num_mipmaps;
+
+    inc::spd_constants constants;
+    unsigned num_groups_x = 0;
+    unsigned num_groups_y = 0;
+    if (size.array_size > gc_max_mip_array_size || !inc::get_spd_setup(size.width, size.height, num_mipmaps, apply_gamma, constants, num_groups_x, num_groups_y))
+        return false;
+
+    handle::shader_view sv;
+    {
+        resource_view sve_srv;
+        sve_srv.init_as_tex2d(resource, pf);
+        sve_srv.dimension = resource_view_dimension::texture2d_array;
+        sve_srv.texture_info.array_size = size.array_size;
+        sve_srv.texture_info.mip_start = 0;
+        sve_srv.texture_info.mip_size = 1;
+
+        cc::capped_vector<resource_view, inc::gc_spd_max_num_mips + 1> sve_uavs;
+        for (auto level = 1u; level <= inc::gc_spd_max_num_mips; ++level)
+        {
+            // slots beyond the last mip are never written, they alias it to keep the argument shape fixed
+            resource_view& sve_uav = sve_uavs.emplace_back(sve_srv);
+            sve_uav.texture_info.mip_start = cc::min(level, num_mipmaps - 1);
+        }
+
+        sve_uavs.emplace_back().init_as_structured_buffer(spd_counter_buffer, gc_max_mip_array_size, sizeof(uint32_t));
+
+        sv = backend->createShaderView(cc::span{sve_srv}, sve_uavs, {}, true);
+        free_deferred(sv);
+    }
+
+    // all mips below 0 are written in the same dispatch, transition them at once instead of per level
+    cc::capped_vector<slice_transition_info, inc::gc_spd_max_num_mips * gc_max_mip_array_size> pre_dispatch;
+    cc::capped_vector<slice_transition_info, inc::gc_spd_max_num_mips * gc_max_mip_array_size> post_dispatch;
+
+    for (auto level = 1u; level < num_mipmaps; ++level)
+    {
+        for (auto arraySlice = 0u; arraySlice < size.array_size; ++arraySlice)
+        {
+            pre_dispatch.push_back(slice_transition_info{resource, resource_state::shader_resource, resource_state::unordered_access,
+                                                         shader_stage_flags::compute, shader_stage_flags::compute, int(level), int(arraySlice)});
+            post_dispatch.push_back(slice_transition_info{resource, resource_state::unordered_access, resource_state::shader_resource,
+                                                          shader_stage_flags::compute, shader_stage_flags::compute, int(level), int(arraySlice)});
+        }
+    }
+
+    {
+        cmd::transition_resources tcmd;
+        tcmd.add(resource, resource_state::shader_resource, shader_stage_flags::compute);
+        tcmd.add(spd_counter_buffer, resource_state::unordered_access, shader_stage_flags::compute);
+        cmd_writer.add_command(tcmd);
+    }
+
+    record_slice_barriers(cmd_writer, pre_dispatch);
+
+    cmd::dispatch dcmd;
+    dcmd.init(pso_mipgen_spd, num_groups_x, num_groups_y, size.array_size);
+    dcmd.add_shader_arg(handle::null_resource, 0, sv);
+    dcmd.write_root_constants(constants);
+    cmd_writer.add_command(dcmd);
+
+    record_slice_barriers(cmd_writer, post_dispatch);
+    return true;
+}
+
+void inc::texture_creator::submit_uploads()
+{
+    flush_cmdstream(true);
+    free_completed_uploads();
+}
+
+void inc::texture_creator::finish_uploads()
+{
+    flush_cmdstream(true);
+
+    // only waits for this creator's work, not the whole GPU
+    backend->waitFenceCPU(upload_fence, num_submits);
+    free_completed_uploads();
+}
+
+void inc::texture_creator::flush_cmdstream(bool submit)
 {
     if (!cmd_writer.empty())
     {
@@ -462,24 +629,51 @@ void inc::texture_creator::flush_cmdstream(bool dispatch, bool stall)
         cmd_writer.reset();
     }
 
-    if (dispatch)
-    {
-        backend->submit(pending_cmd_lists);
-        pending_cmd_lists.clear();
+    if (!submit || pending_cmd_lists.empty())
+        return;
 
-        if (stall)
-        {
-            backend->flushGPU();
+    backend->submit(pending_cmd_lists);
+    pending_cmd_lists.clear();
 
-            backend->freeRange(shader_views_to_free);
-            shader_views_to_free.clear();
+    ++num_submits;
+    backend->signalFenceGPU(upload_fence, num_submits, queue_type::direct);
+    staging.signal_submit(queue_type::direct);
 
-            backend->freeRange(resources_to_free);
-            resources_to_free.clear();
-        }
-    }
-    else
+    // everything deferred so far is released once this submission completes
+    pending_submits.push_back({num_submits, resources_to_free.size(), shader_views_to_free.size()});
+}
+
+void inc::texture_creator::free_completed_uploads()
+{
+    staging.reclaim();
+
+    if (pending_submits.empty())
+        return;
+
+    uint64_t const completed_value = backend->getFenceValue(upload_fence);
+
+    size_t num_completed = 0;
+    while (num_completed < pending_submits.size() && pending_submits[num_completed].fence_value <= completed_value)
+        ++num_completed;
+
+    if (num_completed == 0)
+        return;
+
+    // the counts are cumulative, the last completed submission covers all earlier ones
+    auto const& last = pending_submits[num_completed - 1];
+    size_t const num_resources = last.num_resources;
+    size_t const num_shader_views = last.num_shader_views;
+
+    backend->freeRange(cc::span{shader_views_to_free.data(), num_shader_views});
+    backend->freeRange(cc::span{resources_to_free.data(), num_resources});
+
+    inc::detail::erase_front(shader_views_to_free, num_shader_views);
+    inc::detail::erase_front(resources_to_free, num_resources);
+    inc::detail::erase_front(pending_submits, num_completed);
+
+    for (auto& submit : pending_submits)
     {
-        CC_ASSERT(!stall && "cannot stall if not dispatching");
+        submit.num_resources -= num_resources;
+        submit.num_shader_views -= num_shader_views;
     }
 }
@@ -6,6 +6,7 @@
 #include <phantasm-hardware-interface/commands.hh>
 
 #include <arcana-incubator/asset-loading/image_loader.hh>
+#include <arcana-incubator/phi-util/upload_ring.hh>
 
 namespace inc
 {
@@ -14,9 +15,18 @@ struct texture_creator
     void initialize(phi::Backend& backend, char const* shader_path);
     void free(phi::Backend& backend);
 
+    /// decodes the texture and records its upload, uploads are batched and submitted in bulk
+    /// the texture is usable on the GPU after the next submit_uploads or finish_uploads
     phi::handle::resource load_texture(char const* path, phi::format format, bool include_mipmaps, bool apply_gamma = false);
 
-    void finish_uploads() { flush_cmdstream(true, true); }
+    /// submits all recorded work without waiting, frees staging resources of submissions the GPU has completed
+    void submit_uploads();
+
+    /// submits all recorded work and blocks until it is complete
+    void finish_uploads();
+
+    /// staging memory of all uploads comes from a persistent upload ring
+    upload_ring_stats const& get_staging_stats() const { return staging.get_stats(); }
 
 public:
     // IBL
@@ -25,12 +35,28 @@ public:
 
     phi::handle::resource create_diffuse_irradiance_map(phi::handle::resource filtered_specular_map);
 
+    /// computes the BRDF LUT on the GPU (rg16f, like the cooked LUT), the brdf_lut_gen shader is only loaded on first use
     phi::handle::resource create_brdf_lut(int width_height = 256);
 
+    /// uploads the BRDF LUT from a cooked file, computing it on the CPU and writing the file if missing
+    /// no shader is involved, see assets::load_or_compute_brdf_lut
+    phi::handle::resource load_brdf_lut(char const* cooked_path, int width_height = 256);
+
 private:
     void generate_mips(phi::handle::resource resource, inc::assets::image_size const& size, bool apply_gamma, phi::format pf);
 
-    void flush_cmdstream(bool dispatch, bool stall);
+    // returns false if the texture can't be handled by the single pass downsampler
+    bool generate_mips_single_pass(phi::handle::resource resource, inc::assets::image_size const& size, bool apply_gamma, phi::format pf);
+
+    // records the command stream into a pending command list, submit: submits all pending lists and signals the upload fence
+    void flush_cmdstream(bool submit);
+
+    // frees staging resources whose submission the GPU has completed, never waits
+    void free_completed_uploads();
+
+    // released once the current batch is complete
+    void free_deferred(phi::handle::resource res) { resources_to_free.push_back(res); }
+    void free_deferred(phi::handle::shader_view sv) { shader_views_to_free.push_back(sv); }
 
 private:
     phi::Backend* backend = nullptr;
@@ -40,19 +66,37 @@ private:
     phi::handle::pipeline_state pso_mipgen_gamma;
     phi::handle::pipeline_state pso_mipgen_array;
 
+    phi::handle::pipeline_state pso_mipgen_spd = phi::handle::null_pipeline_state; // optional
+    phi::handle::resource spd_counter_buffer = phi::handle::null_resource;         // one atomic counter per array slice
+
     phi::handle::pipeline_state pso_equirect_to_cube;
     phi::handle::pipeline_state pso_specular_map_filter;
     phi::handle::pipeline_state pso_irradiance_map_gen;
-    phi::handle::pipeline_state pso_brdf_lut_gen;
+    phi::handle::pipeline_state pso_brdf_lut_gen = phi::handle::null_pipeline_state; // lazy
 
+    char shader_path_prefix[256] = {};
 
 private:
     std::byte* commandstream_buffer = nullptr;
     phi::command_stream_writer cmd_writer;
 
+    // deferred frees, in submission order
     cc::vector<phi::handle::resource> resources_to_free;
     cc::vector<phi::handle::shader_view> shader_views_to_free;
     cc::vector<phi::handle::command_list> pending_cmd_lists;
+
+    struct pending_submit
+    {
+        uint64_t fence_value;    // signaled when the submission is complete
+        size_t num_resources;    // amount of resources_to_free released by then
+        size_t num_shader_views; // amount of shader_views_to_free released by then
+    };
+
+    cc::vector<pending_submit> pending_submits;
+    phi::handle::fence upload_fence;
+    uint64_t num_submits = 0;
+
+    upload_ring staging;
 };
 
 
@@ -1,5 +1,6 @@
 #include "texture_util.hh"
 
+#include <clean-core/assert.hh>
 #include <clean-core/utility.hh>
 
 #include <phantasm-hardware-interface/commands.hh>
@@ -9,48 +10,117 @@
 
 #include <typed-geometry/tg.hh>
 
-void inc::copy_data_to_texture(phi::command_stream_writer& writer,
-                               phi::handle::resource upload_buffer,
-                               std::byte* upload_buffer_map,
-                               phi::handle::resource dest_texture,
-                               phi::format dest_format,
-                               unsigned dest_width,
-                               unsigned dest_height,
-                               const std::byte* img_data,
-                               bool use_d3d12_per_row_alingment)
+#include <arcana-incubator/asset-loading/streaming_copy.hh>
+
+namespace
+{
+// row stride of the texture data in the upload buffer
+unsigned get_upload_row_stride(phi::format dest_format, unsigned dest_width, bool use_d3d12_per_row_alingment)
+{
+    auto mip_row_stride_bytes = phi::util::get_format_size_bytes(dest_format) * dest_width;
+
+    if (use_d3d12_per_row_alingment)
+        // MIP maps are 256-byte aligned per row in d3d12
+        mip_row_stride_bytes = phi::util::align_up(mip_row_stride_bytes, 256);
+
+    return mip_row_stride_bytes;
+}
+
+void record_copy_to_texture(phi::command_stream_writer& writer,
+                            phi::handle::resource upload_buffer,
+                            size_t upload_buffer_offset,
+                            phi::handle::resource dest_texture,
+                            unsigned dest_width,
+                            unsigned dest_height)
 {
     using namespace phi;
-    auto const bytes_per_pixel = phi::util::get_format_size_bytes(dest_format);
 
     // CC_RUNTIME_ASSERT(img_size.array_size == 1 && "array upload unimplemented");
     // NOTE: image_data is currently always a single array slice
 
     cmd::copy_buffer_to_texture command;
     command.source.buffer = upload_buffer;
+    command.source.offset_bytes = upload_buffer_offset;
     command.destination = dest_texture;
     command.dest_width = dest_width;
     command.dest_height = dest_height;
     command.dest_mip_index = 0;
+    command.dest_array_index = 0u;
+
+    writer.add_command(command);
+}
+}
+
+void inc::copy_data_to_texture(phi::command_stream_writer& writer,
+                               phi::handle::resource upload_buffer,
+                               std::byte* upload_buffer_map,
+                               phi::handle::resource dest_texture,
+                               phi::format dest_format,
+                               unsigned dest_width,
+                               unsigned dest_height,
+                               const std::byte* img_data,
+                               bool use_d3d12_per_row_alingment,
+                               size_t upload_buffer_offset)
+{
+    auto const mip_row_size_bytes = phi::util::get_format_size_bytes(dest_format) * dest_width;
+    auto const mip_row_stride_bytes = get_upload_row_stride(dest_format, dest_width, use_d3d12_per_row_alingment);
+    record_copy_to_texture(writer, upload_buffer, upload_buffer_offset, dest_texture, dest_width, dest_height);
 
-    auto accumulated_offset_bytes = 0u;
+    // the upload buffer is write-combined memory, use streaming stores
+    inc::assets::strided_copy_desc copy_desc;
+    copy_desc.src = img_data;
+    copy_desc.dest = upload_buffer_map;
+    copy_desc.row_size_bytes = mip_row_size_bytes;
+    copy_desc.src_row_stride_bytes = mip_row_size_bytes;
+    copy_desc.dest_row_stride_bytes = mip_row_stride_bytes;
+    copy_desc.num_rows = dest_height;
+    inc::assets::streaming_copy(copy_desc);
+}
 
-    // for (auto a = 0u; a < img_size.array_size; ++a)
-    {
-        command.dest_array_index = 0u; // a;
-        command.source.offset_bytes = accumulated_offset_bytes;
+bool inc::decode_data_to_texture(phi::command_stream_writer& writer,
+                                 phi::handle::resource upload_buffer,
+                                 std::byte* upload_buffer_map,
+                                 phi::handle::resource dest_texture,
+                                 phi::format dest_format,
+                                 unsigned dest_width,
+                                 unsigned dest_height,
+                                 cc::span<std::byte const> encoded_data,
+                                 bool use_d3d12_per_row_alingment,
+                                 size_t upload_buffer_offset)
+{
+    auto const num_components = phi::util::get_format_num_components(dest_format);
+    bool const is_hdr = phi::util::get_format_size_bytes(dest_format) / num_components > 1;
+
+    auto const mip_row_stride_bytes = get_upload_row_stride(dest_format, dest_width, use_d3d12_per_row_alingment);
+
+    // decode first, a failed decode must not leave a copy from garbage upload memory in the writer
+    inc::assets::image_size decoded_size;
+    if (!inc::assets::load_image_to(encoded_data, upload_buffer_map, mip_row_stride_bytes, decoded_size, int(num_components), is_hdr))
+        return false;
 
-        writer.add_command(command);
+    CC_ASSERT(decoded_size.width == dest_width && decoded_size.height == dest_height && "decoded image size mismatch");
+
+    record_copy_to_texture(writer, upload_buffer, upload_buffer_offset, dest_texture, dest_width, dest_height);
+    return true;
+}
 
-        auto const mip_row_size_bytes = bytes_per_pixel * command.dest_width;
-        auto mip_row_stride_bytes = mip_row_size_bytes;
+size_t inc::get_upload_size_bytes(const inc::assets::image_size& size, phi::format dest_format, bool use_d3d12_per_row_alingment)
+{
+    return phi::util::get_texture_size_bytes({int(size.width), int(size.height), int(cc::max(1u, size.array_size))}, dest_format, 1, use_d3d12_per_row_alingment);
+}
+
+bool inc::get_spd_setup(unsigned width, unsigned height, unsigned num_mips, bool apply_gamma, inc::spd_constants& out_constants, unsigned& out_num_groups_x, unsigned& out_num_groups_y)
+{
+    CC_ASSERT(width > 0 && height > 0 && num_mips > 0 && "invalid texture");
+    unsigned const num_generated_mips = num_mips - 1;
 
-        if (use_d3d12_per_row_alingment)
-            // MIP maps are 256-byte aligned per row in d3d12
-            mip_row_stride_bytes = phi::util::align_up(mip_row_stride_bytes, 256);
+    if (num_generated_mips == 0 || num_generated_mips > gc_spd_max_num_mips)
+        return false;
 
-        auto const mip_offset_bytes = mip_row_stride_bytes * command.dest_height;
-        accumulated_offset_bytes += mip_offset_bytes;
+    out_num_groups_x = (width + 63) / 64;
+    out_num_groups_y = (height + 63) / 64;
 
-        inc::assets::rowwise_copy(img_data, upload_buffer_map + command.source.offset_bytes, mip_row_stride_bytes, mip_row_size_bytes, command.dest_height);
-    }
+    out_constants.num_mips_and_flags = num_generated_mips | (apply_gamma ? 1u << 8 : 0u);
+    out_constants.num_work_groups = out_num_groups_x * out_num_groups_y;
+    return true;
 }
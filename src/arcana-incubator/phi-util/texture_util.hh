@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 
 #include <phantasm-hardware-interface/fwd.hh>
 #include <phantasm-hardware-interface/types.hh>
@@ -9,6 +10,8 @@
 
 namespace inc
 {
+/// upload_buffer_map points to upload_buffer_offset in the upload buffer (ie. an upload_ring allocation)
+/// the offset must be a multiple of gc_upload_texture_alignment (512 bytes)
 void copy_data_to_texture(phi::command_stream_writer& writer,
                           phi::handle::resource upload_buffer,
                           std::byte* upload_buffer_map,
@@ -17,6 +20,40 @@ void copy_data_to_texture(phi::command_stream_writer& writer,
                           unsigned dest_width,
                           unsigned dest_height,
                           const std::byte* img_data,
-                          bool use_d3d12_per_row_alingment);
+                          bool use_d3d12_per_row_alingment,
+                          size_t upload_buffer_offset = 0);
 
+/// decodes an encoded image (png, jpg, hdr, ..) directly into the upload buffer and records the copy to the texture
+/// saves the full-image copy of load_image + copy_data_to_texture, the upload buffer must be sized for dest_width x dest_height
+/// returns false if decoding failed, in which case no command is recorded
+[[nodiscard]] bool decode_data_to_texture(phi::command_stream_writer& writer,
+                                          phi::handle::resource upload_buffer,
+                                          std::byte* upload_buffer_map,
+                                          phi::handle::resource dest_texture,
+                                          phi::format dest_format,
+                                          unsigned dest_width,
+                                          unsigned dest_height,
+                                          cc::span<std::byte const> encoded_data,
+                                          bool use_d3d12_per_row_alingment,
+                                          size_t upload_buffer_offset = 0);
+
+/// the upload buffer size required to copy mip 0 of an image to a texture of dest_format (ie. sized with assets::probe_image)
+[[nodiscard]] size_t get_upload_size_bytes(assets::image_size const& size, phi::format dest_format, bool use_d3d12_per_row_alingment);
+
+/// single-pass mip downsampler (mipgen_spd shader, source and bindings in mipgen_spd.hlsl), generates up to gc_spd_max_num_mips mips below mip 0 in one dispatch
+/// each workgroup reduces a 64x64 tile of mip 0, the last workgroup of a slice to finish (global atomic counter) reduces the rest
+/// supports non-square and non-power of two textures, odd sizes are box filtered with the texel clamped to the level
+inline constexpr unsigned gc_spd_max_num_mips = 12;
+
+/// root constants of the mipgen_spd shader (8 bytes)
+struct spd_constants
+{
+    uint32_t num_mips_and_flags; // bits 0-7: amount of mips to generate, bit 8: apply gamma
+    uint32_t num_work_groups;    // per array slice
+};
+
+/// writes the constants and the dispatch size for a texture of the given size and mip count (including mip 0)
+/// returns false if the mips do not fit into a single dispatch
+[[nodiscard]] bool get_spd_setup(
+    unsigned width, unsigned height, unsigned num_mips, bool apply_gamma, spd_constants& out_constants, unsigned& out_num_groups_x, unsigned& out_num_groups_y);
 }
@@ -0,0 +1,207 @@
+#include "upload_ring.hh"
+
+#include <clean-core/assert.hh>
+#include <clean-core/utility.hh>
+
+#include <phantasm-hardware-interface/Backend.hh>
+
+namespace
+{
+size_t align_up(size_t value, size_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+}
+
+void inc::upload_ring::initialize(phi::Backend& backend, size_t size_bytes, size_t dedicated_threshold_bytes)
+{
+    CC_ASSERT(this->backend == nullptr && "double init");
+    CC_ASSERT(size_bytes > 0 && size_bytes <= size_t(uint32_t(-1)) && "invalid upload ring size");
+
+    this->backend = &backend;
+    capacity = size_bytes;
+    dedicated_threshold = dedicated_threshold_bytes > 0 ? cc::min(dedicated_threshold_bytes, size_bytes) : size_bytes / 4;
+
+    // upload heaps are host coherent, the ring stays mapped for its lifetime
+    buffer = backend.createUploadBuffer(uint32_t(size_bytes));
+    map = backend.mapBuffer(buffer);
+    fence = backend.createFence();
+
+    batches.reserve(64);
+    dedicated_buffers.reserve(64);
+
+    stats = {};
+    stats.capacity_bytes = capacity;
+}
+
+void inc::upload_ring::destroy()
+{
+    if (backend == nullptr)
+        return;
+
+    wait_idle();
+    CC_ASSERT(num_unsignaled_bytes == 0 && "upload ring destroyed with allocations that were never signaled");
+
+    backend->unmapBuffer(buffer);
+    backend->free(buffer);
+    backend->free(cc::span{fence});
+
+    backend = nullptr;
+    buffer = phi::handle::null_resource;
+    map = nullptr;
+    fence = phi::handle::null_fence;
+}
+
+inc::upload_allocation inc::upload_ring::allocate(size_t size_bytes, size_t alignment)
+{
+    CC_ASSERT(backend != nullptr && "upload_ring uninitialized");
+    CC_ASSERT(size_bytes > 0 && alignment > 0 && "invalid allocation");
+
+    ++stats.num_allocations;
+
+    if (size_bytes > dedicated_threshold)
+        return allocate_dedicated(size_bytes);
+
+    reclaim();
+
+    size_t offset = 0;
+    if (!try_allocate(size_bytes, alignment, offset))
+    {
+        // no waiting for in-flight submissions, and the space of unsignaled allocations would never be released
+        if (batches.empty())
+            ++stats.num_overflows;
+        else
+            ++stats.num_stalls;
+
+        return allocate_dedicated(size_bytes);
+    }
+
+    upload_allocation res;
+    res.buffer = buffer;
+    res.offset = offset;
+    res.data = map + offset;
+    res.size = size_bytes;
+    return res;
+}
+
+void inc::upload_ring::signal_submit(phi::queue_type queue)
+{
+    CC_ASSERT(backend != nullptr && "upload_ring uninitialized");
+
+    if (num_unsignaled_bytes == 0)
+        return;
+
+    ++num_signals;
+    backend->signalFenceGPU(fence, num_signals, queue);
+
+    batches.push_back({num_signals, num_unsignaled_ring_bytes, dedicated_buffers.size()});
+    num_unsignaled_bytes = 0;
+    num_unsignaled_ring_bytes = 0;
+}
+
+void inc::upload_ring::reclaim()
+{
+    if (batches.empty())
+        return;
+
+    uint64_t const completed_value = backend->getFenceValue(fence);
+
+    size_t num_completed = 0;
+    size_t num_released_bytes = 0;
+    while (num_completed < batches.size() && batches[num_completed].fence_value <= completed_value)
+    {
+        num_released_bytes += batches[num_completed].num_ring_bytes;
+        ++num_completed;
+    }
+
+    if (num_completed == 0)
+        return;
+
+    auto const& last = batches[num_completed - 1];
+    size_t const num_dedicated = last.num_dedicated;
+
+    num_used_bytes -= num_released_bytes;
+    stats.used_bytes = num_used_bytes;
+
+    // restart at the front once empty, keeps large allocations from wrapping
+    if (num_used_bytes == 0)
+        head = 0;
+
+    if (num_dedicated > 0)
+    {
+        for (auto i = 0u; i < num_dedicated; ++i)
+            backend->unmapBuffer(dedicated_buffers[i]);
+
+        backend->freeRange(cc::span{dedicated_buffers.data(), num_dedicated});
+        detail::erase_front(dedicated_buffers, num_dedicated);
+    }
+
+    detail::erase_front(batches, num_completed);
+
+    // the counts are cumulative
+    for (auto& batch : batches)
+        batch.num_dedicated -= num_dedicated;
+}
+
+void inc::upload_ring::wait_idle()
+{
+    if (!batches.empty())
+        backend->waitFenceCPU(fence, num_signals);
+
+    reclaim();
+}
+
+void inc::upload_ring::reset_stats()
+{
+    stats = {};
+    stats.capacity_bytes = capacity;
+    stats.used_bytes = num_used_bytes;
+    stats.peak_used_bytes = num_used_bytes;
+}
+
+bool inc::upload_ring::try_allocate(size_t size_bytes, size_t alignment, size_t& out_offset)
+{
+    size_t offset = align_up(head, alignment);
+    size_t padding = offset - head;
+
+    if (offset + size_bytes > capacity)
+    {
+        // skip the end of the ring and continue at the front
+        offset = 0;
+        padding = capacity - head;
+    }
+
+    // allocations are released in order, the free space always starts at head and spans capacity - used bytes (wrapping)
+    size_t const num_consumed = padding + size_bytes;
+    if (num_consumed > capacity - num_used_bytes)
+        return false;
+
+    head = offset + size_bytes;
+    if (head == capacity)
+        head = 0;
+
+    num_used_bytes += num_consumed;
+    num_unsignaled_bytes += num_consumed;
+    num_unsignaled_ring_bytes += num_consumed;
+
+    stats.used_bytes = num_used_bytes;
+    stats.peak_used_bytes = cc::max(stats.peak_used_bytes, num_used_bytes);
+
+    out_offset = offset;
+    return true;
+}
+
+inc::upload_allocation inc::upload_ring::allocate_dedicated(size_t size_bytes)
+{
+    CC_ASSERT(size_bytes <= size_t(uint32_t(-1)) && "upload too large");
+
+    upload_allocation res;
+    res.buffer = backend->createUploadBuffer(uint32_t(size_bytes));
+    res.offset = 0;
+    res.data = backend->mapBuffer(res.buffer);
+    res.size = size_bytes;
+
+    dedicated_buffers.push_back(res.buffer);
+    num_unsignaled_bytes += size_bytes;
+
+    ++stats.num_dedicated;
+    stats.dedicated_bytes += size_bytes;
+    return res;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <clean-core/vector.hh>
+
+#include <phantasm-hardware-interface/types.hh>
+
+namespace phi
+{
+class Backend;
+}
+
+namespace inc
+{
+/// placement alignment of buffer to texture copies (D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT), also sufficient for Vulkan
+inline constexpr size_t gc_upload_texture_alignment = 512;
+
+struct upload_allocation
+{
+    phi::handle::resource buffer = phi::handle::null_resource;
+    size_t offset = 0;         // of the allocation in buffer, copies read from here
+    std::byte* data = nullptr; // mapped memory at offset, write-combined, write only
+    size_t size = 0;
+};
+
+struct upload_ring_stats
+{
+    size_t capacity_bytes = 0;
+    size_t used_bytes = 0; // in flight or not yet signaled, including alignment padding
+    size_t peak_used_bytes = 0;
+
+    size_t num_allocations = 0;
+    size_t num_dedicated = 0; // allocations that got their own upload buffer, oversized or overflowing
+    size_t dedicated_bytes = 0;
+    size_t num_overflows = 0; // dedicated because the ring was full of allocations that were never signaled
+    size_t num_stalls = 0;    // dedicated because the ring was full of in-flight submissions, allocate never waits for the GPU
+};
+
+namespace detail
+{
+// removes the first num elements, used to retire fence-ordered batches
+template <class T>
+void erase_front(cc::vector<T>& vec, size_t num)
+{
+    for (auto i = num; i < vec.size(); ++i)
+        vec[i - num] = vec[i];
+
+    vec.resize(vec.size() - num);
+}
+}
+
+/// a persistently mapped upload buffer, sub-allocated linearly and reclaimed in submission order
+/// replaces creating (and freeing) an upload buffer per uploaded asset
+///
+/// usage:
+///   allocate staging memory, write it and record copies reading from it
+///   submit the command lists, then call signal_submit on the same queue
+///   the allocations stay valid until the GPU passes that signal
+///
+/// allocations above the dedicated threshold get their own upload buffer, released the same way
+/// if the ring is full, allocate falls back to a dedicated buffer as well, it never blocks
+/// frequent stalls or overflows in the stats mean the ring is too small for the upload rate
+struct upload_ring
+{
+    /// dedicated_threshold_bytes: 0 uses a quarter of the ring
+    void initialize(phi::Backend& backend, size_t size_bytes, size_t dedicated_threshold_bytes = 0);
+    void destroy();
+
+    [[nodiscard]] upload_allocation allocate(size_t size_bytes, size_t alignment = gc_upload_texture_alignment);
+
+    /// all allocations since the last call are released once the GPU reaches this point in the given queue
+    void signal_submit(phi::queue_type queue = phi::queue_type::direct);
+
+    /// releases the allocations of completed submissions, never waits (allocate does this as well)
+    void reclaim();
+
+    /// blocks until all signaled submissions are complete and releases their allocations
+    void wait_idle();
+
+    /// staging memory allocated since the last signal_submit, including dedicated buffers
+    size_t get_unsignaled_bytes() const { return num_unsignaled_bytes; }
+
+    upload_ring_stats const& get_stats() const { return stats; }
+    void reset_stats();
+
+private:
+    // returns false if the ring has no contiguous space left
+    bool try_allocate(size_t size_bytes, size_t alignment, size_t& out_offset);
+
+    upload_allocation allocate_dedicated(size_t size_bytes);
+
+private:
+    phi::Backend* backend = nullptr;
+    phi::handle::resource buffer = phi::handle::null_resource;
+    std::byte* map = nullptr;
+    phi::handle::fence fence = phi::handle::null_fence;
+
+    size_t capacity = 0;
+    size_t dedicated_threshold = 0;
+
+    size_t head = 0;           // next free byte
+    size_t num_used_bytes = 0; // from the oldest allocation in use up to head, including padding and the skipped end when wrapping
+    size_t num_unsignaled_bytes = 0;
+    size_t num_unsignaled_ring_bytes = 0;
+
+    struct in_flight_batch
+    {
+        uint64_t fence_value;
+        size_t num_ring_bytes; // released once complete
+        size_t num_dedicated;  // amount of dedicated_buffers released by then (cumulative)
+    };
+
+    cc::vector<in_flight_batch> batches;
+    cc::vector<phi::handle::resource> dedicated_buffers; // in allocation order
+    uint64_t num_signals = 0;
+
+    upload_ring_stats stats;
+};
+}
@@ -0,0 +1,260 @@
+#include "frame_capture.hh"
+
+#include <cstdio>
+#include <cstring>
+
+#include <clean-core/alloc_array.hh>
+#include <clean-core/utility.hh>
+
+#include <phantasm-hardware-interface/Backend.hh>
+#include <phantasm-hardware-interface/common/byte_util.hh>
+#include <phantasm-hardware-interface/common/format_size.hh>
+
+#include <phantasm-renderer/Context.hh>
+#include <phantasm-renderer/Frame.hh>
+
+#include <arcana-incubator/asset-loading/lib/stb_image_write.hh>
+#include <arcana-incubator/asset-loading/pixel_convert.hh>
+
+namespace
+{
+bool is_supported_format(pr::format fmt)
+{
+    return fmt == pr::format::rgba8un || fmt == pr::format::bgra8un || fmt == pr::format::rgba16f || fmt == pr::format::rgba32f;
+}
+}
+
+void inc::pre::frame_capture::initialize(pr::Context& ctx, unsigned num_slots, unsigned num_workers)
+{
+    CC_ASSERT(num_slots > 0 && num_slots <= max_num_slots && "invalid amount of capture slots");
+    CC_ASSERT(num_workers > 0 && num_workers <= max_num_workers && "invalid amount of capture workers");
+
+    fence = ctx.get_backend().createFence();
+    num_signals = 0;
+    align_rows = ctx.get_backend().getBackendType() == phi::backend_type::d3d12;
+
+    slots.resize(num_slots);
+    is_shutting_down = false;
+
+    for (auto i = 0u; i < num_workers; ++i)
+        workers.emplace_back([this] { worker_main(); });
+}
+
+void inc::pre::frame_capture::destroy(pr::Context& ctx)
+{
+    if (slots.empty())
+        return;
+
+    flush(ctx);
+
+    {
+        std::lock_guard lg(queue_mutex);
+        is_shutting_down = true;
+    }
+    queue_cv.notify_all();
+
+    for (auto& worker : workers)
+        worker.join();
+
+    workers.clear();
+    slots.clear();
+
+    ctx.get_backend().free(cc::span<phi::handle::fence const>{&fence, 1});
+    fence = phi::handle::null_fence;
+}
+
+bool inc::pre::frame_capture::capture(pr::raii::Frame& frame, const pr::texture& texture, const char* path)
+{
+    auto& ctx = frame.context();
+    auto const& info = ctx.get_texture_info(texture);
+    CC_ASSERT(is_supported_format(info.fmt) && "unsupported texture format for capture");
+
+    slot* target = nullptr;
+    for (auto& s : slots)
+    {
+        if (s.state.load() == slot_state::free)
+        {
+            target = &s;
+            break;
+        }
+    }
+
+    if (target == nullptr)
+    {
+        // backpressure: never wait for the GPU or the workers on the render thread
+        ++num_dropped;
+        return false;
+    }
+
+    auto const bytes_per_pixel = phi::util::get_format_size_bytes(info.fmt);
+    unsigned const row_size = unsigned(info.width) * bytes_per_pixel;
+
+    target->width = unsigned(info.width);
+    target->height = unsigned(info.height);
+    target->row_pitch = align_rows ? phi::util::align_up(row_size, 256) : row_size;
+    target->fmt = info.fmt;
+    target->fence_value = num_signals + 1; // signaled by the next on_frame
+    std::snprintf(target->path, sizeof(target->path), "%s", path);
+
+    // readback buffers only grow
+    unsigned const required_size = target->row_pitch * target->height;
+    if (target->readback_size < required_size)
+    {
+        target->readback.free();
+        target->readback = ctx.make_readback_buffer(required_size);
+        target->readback_size = required_size;
+    }
+
+    frame.transition(texture, pr::state::copy_src);
+    frame.copy(texture, target->readback, 0, 0, 0);
+
+    target->state.store(slot_state::copying);
+    return true;
+}
+
+void inc::pre::frame_capture::on_frame(pr::Context& ctx)
+{
+    auto& backend = ctx.get_backend();
+
+    // ordered after the copies submitted so far on the same queue
+    ++num_signals;
+    backend.signalFenceGPU(fence, num_signals, phi::queue_type::direct);
+
+    recycle_done_slots(ctx);
+
+    uint64_t const completed_value = backend.getFenceValue(fence);
+    for (auto i = 0u; i < slots.size(); ++i)
+    {
+        if (slots[i].state.load() == slot_state::copying && slots[i].fence_value <= completed_value)
+            hand_off(ctx, i);
+    }
+}
+
+void inc::pre::frame_capture::flush(pr::Context& ctx)
+{
+    ctx.flush();
+
+    for (auto i = 0u; i < slots.size(); ++i)
+    {
+        if (slots[i].state.load() == slot_state::copying)
+            hand_off(ctx, i);
+    }
+
+    // wait for the workers
+    {
+        std::unique_lock lock(queue_mutex);
+        queue_cv.wait(lock, [&] {
+            for (auto const& s : slots)
+                if (s.state.load() == slot_state::encoding)
+                    return false;
+            return true;
+        });
+    }
+
+    recycle_done_slots(ctx);
+}
+
+bool inc::pre::frame_capture::is_full() const
+{
+    for (auto const& s : slots)
+        if (s.state.load() == slot_state::free)
+            return false;
+
+    return true;
+}
+
+void inc::pre::frame_capture::hand_off(pr::Context& ctx, unsigned slot_index)
+{
+    slot& s = slots[slot_index];
+    s.readback_map = ctx.map_buffer(s.readback);
+    s.state.store(slot_state::encoding);
+
+    {
+        std::lock_guard lg(queue_mutex);
+        queue.push_back(slot_index);
+    }
+    queue_cv.notify_all();
+}
+
+void inc::pre::frame_capture::recycle_done_slots(pr::Context& ctx)
+{
+    for (auto& s : slots)
+    {
+        if (s.state.load() == slot_state::done)
+        {
+            ctx.unmap_buffer(s.readback);
+            s.readback_map = nullptr;
+            s.state.store(slot_state::free);
+        }
+    }
+}
+
+void inc::pre::frame_capture::worker_main()
+{
+    while (true)
+    {
+        unsigned slot_index;
+        {
+            std::unique_lock lock(queue_mutex);
+            queue_cv.wait(lock, [&] { return is_shutting_down || !queue.empty(); });
+
+            if (queue.empty())
+                return; // shutting down
+
+            slot_index = queue.back();
+            queue.pop_back();
+        }
+
+        slot& s = slots[slot_index];
+        if (encode_and_write(s))
+            ++num_written;
+        else
+            ++num_failed;
+
+        {
+            // under the lock so flush can not miss the notification
+            std::lock_guard lg(queue_mutex);
+            s.state.store(slot_state::done);
+        }
+        queue_cv.notify_all();
+    }
+}
+
+bool inc::pre::frame_capture::encode_and_write(const inc::pre::frame_capture::slot& s)
+{
+    size_t const num_pixels = size_t(s.width) * s.height;
+
+    // the encoder reads pitched rows directly from the readback buffer
+    if (s.fmt == pr::format::rgba8un)
+        return ::stbi_write_png(s.path, int(s.width), int(s.height), 4, s.readback_map, int(s.row_pitch)) != 0;
+
+    if (s.fmt == pr::format::bgra8un)
+    {
+        auto pixels = cc::alloc_array<uint8_t>::uninitialized(num_pixels * 4);
+        for (auto y = 0u; y < s.height; ++y)
+        {
+            auto const* const src = reinterpret_cast<uint8_t const*>(s.readback_map + size_t(y) * s.row_pitch);
+            inc::assets::swizzle_rgba_bgra(src, pixels.data() + size_t(y) * s.width * 4, s.width);
+        }
+
+        return ::stbi_write_png(s.path, int(s.width), int(s.height), 4, pixels.data(), int(s.width * 4)) != 0;
+    }
+
+    // float formats are written as HDR
+    auto pixels = cc::alloc_array<float>::uninitialized(num_pixels * 4);
+    for (auto y = 0u; y < s.height; ++y)
+    {
+        std::byte const* const src = s.readback_map + size_t(y) * s.row_pitch;
+        float* const dest = pixels.data() + size_t(y) * s.width * 4;
+
+        if (s.fmt == pr::format::rgba32f)
+        {
+            std::memcpy(dest, src, size_t(s.width) * 4 * sizeof(float));
+            continue;
+        }
+
+        inc::assets::convert_half_to_float(reinterpret_cast<uint16_t const*>(src), dest, size_t(s.width) * 4);
+    }
+
+    return ::stbi_write_hdr(s.path, int(s.width), int(s.height), 4, pixels.data()) != 0;
+}
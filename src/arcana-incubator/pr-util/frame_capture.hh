@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <clean-core/capped_vector.hh>
+
+#include <phantasm-hardware-interface/handles.hh>
+
+#include <phantasm-renderer/fwd.hh>
+#include <phantasm-renderer/resource_types.hh>
+
+namespace inc::pre
+{
+/// asynchronous screenshot / frame capture
+/// textures are copied into a ring of readback buffers, once the GPU is done (a fence signaled in on_frame)
+/// the data is handed to a pool of worker threads which encode and write PNG (8 bit formats) or HDR (float formats)
+/// the render thread never waits, if all slots are busy a capture is dropped (see is_full and get_num_dropped)
+///
+/// usage:
+///     capture.initialize(ctx);
+///     ..
+///     capture.capture(frame, backbuffer, "capture_0001.png");
+///     ctx.submit(cc::move(frame));
+///     capture.on_frame(ctx); // once per frame, after submitting the frames that recorded captures
+///     ..
+///     capture.destroy(ctx); // writes all pending captures
+struct frame_capture
+{
+    /// supported texture formats: rgba8un, bgra8un (PNG), rgba16f, rgba32f (HDR)
+    void initialize(pr::Context& ctx, unsigned num_slots = 4, unsigned num_workers = 2);
+    void destroy(pr::Context& ctx);
+
+    /// records a copy of mip 0 of the texture, it is written to path asynchronously
+    /// returns false if no slot is free, the capture is dropped then
+    bool capture(pr::raii::Frame& frame, pr::texture const& texture, char const* path);
+
+    /// once per application frame, signals the capture fence on the direct queue (the copies of all captures submitted so far
+    /// are complete once it is reached), hands completed readbacks to the workers and recycles encoded slots
+    void on_frame(pr::Context& ctx);
+
+    /// blocks until all recorded captures are written to disk
+    /// NOTE: flushes the GPU
+    void flush(pr::Context& ctx);
+
+    /// true if the next capture would be dropped
+    bool is_full() const;
+
+    unsigned get_num_dropped() const { return num_dropped; }
+    unsigned get_num_written() const { return num_written.load(); }
+    unsigned get_num_failed() const { return num_failed.load(); }
+
+    frame_capture() = default;
+    frame_capture(frame_capture const&) = delete;
+    frame_capture& operator=(frame_capture const&) = delete;
+
+private:
+    enum class slot_state
+    {
+        free,
+        copying,  // the GPU copy is in flight
+        encoding, // owned by the workers
+        done      // encoded, the readback buffer can be unmapped and reused
+    };
+
+    struct slot
+    {
+        std::atomic<slot_state> state = {slot_state::free};
+        pr::auto_buffer readback;
+        unsigned readback_size = 0;
+        std::byte const* readback_map = nullptr;
+
+        unsigned width = 0;
+        unsigned height = 0;
+        unsigned row_pitch = 0;
+        pr::format fmt = pr::format::none;
+        uint64_t fence_value = 0; // the copy is complete once the capture fence reaches it
+        char path[512];
+    };
+
+    void worker_main();
+    void hand_off(pr::Context& ctx, unsigned slot_index);
+    void recycle_done_slots(pr::Context& ctx);
+
+    static bool encode_and_write(slot const& s);
+
+private:
+    static constexpr unsigned max_num_slots = 16;
+    static constexpr unsigned max_num_workers = 8;
+
+    cc::capped_vector<slot, max_num_slots> slots;
+    cc::capped_vector<std::thread, max_num_workers> workers;
+
+    // queue of slot indices handed to the workers
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    cc::capped_vector<unsigned, max_num_slots> queue;
+    bool is_shutting_down = false;
+
+    phi::handle::fence fence = phi::handle::null_fence;
+    uint64_t num_signals = 0;
+    bool align_rows = false;
+
+    unsigned num_dropped = 0;
+    std::atomic<unsigned> num_written = {0};
+    std::atomic<unsigned> num_failed = {0};
+};
+}
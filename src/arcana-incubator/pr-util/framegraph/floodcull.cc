@@ -2,6 +2,43 @@
 
 #include <clean-core/alloc_vector.hh>
 
+namespace
+{
+// relations bucketed by one of their indices (CSR), the other index of bucket i is at [offsets[i], offsets[i + 1])
+struct adjacency
+{
+    cc::alloc_vector<unsigned> offsets;
+    cc::alloc_vector<unsigned> indices;
+
+    cc::span<unsigned const> get(size_t i) const { return {indices.data() + offsets[i], offsets[i + 1] - offsets[i]}; }
+};
+
+// counting sort, keeps the relation order within each bucket
+template <class KeyF, class ValueF>
+adjacency build_adjacency(cc::span<inc::frag::floodcull_relation const> relations, size_t num_buckets, KeyF&& f_key, ValueF&& f_value, cc::allocator* alloc)
+{
+    adjacency res;
+    res.offsets = cc::alloc_vector<unsigned>::filled(num_buckets + 1, 0, alloc);
+    res.indices = cc::alloc_vector<unsigned>::uninitialized(relations.size(), alloc);
+
+    for (auto const& rel : relations)
+        ++res.offsets[f_key(rel) + 1];
+
+    for (auto i = 0u; i < num_buckets; ++i)
+        res.offsets[i + 1] += res.offsets[i];
+
+    // use the offsets as write cursors, afterwards each one has moved to the start of the next bucket
+    for (auto const& rel : relations)
+        res.indices[res.offsets[f_key(rel)]++] = f_value(rel);
+
+    for (auto i = num_buckets; i > 0; --i)
+        res.offsets[i] = res.offsets[i - 1];
+    res.offsets[0] = 0;
+
+    return res;
+}
+}
+
 void inc::frag::run_floodcull(cc::span<int> producers,
                               cc::span<int> resources,
                               cc::span<const inc::frag::floodcull_relation> writes,
@@ -24,7 +61,16 @@ void inc::frag::run_floodcull(cc::span<int> producers,
     }
 
     // phase two - floodfill from unreferenced resources
+    // the producers of each resource and the reads of each producer are looked up in adjacency lists, O(producers + resources + relations)
     {
+        auto const producers_by_resource = build_adjacency(
+            writes, resources.size(), [](floodcull_relation const& r) { return r.resource_index; },
+            [](floodcull_relation const& r) { return r.producer_index; }, alloc);
+
+        auto const reads_by_producer = build_adjacency(
+            reads, producers.size(), [](floodcull_relation const& r) { return r.producer_index; },
+            [](floodcull_relation const& r) { return r.resource_index; }, alloc);
+
         cc::alloc_vector<unsigned> residx_stack(alloc);
         residx_stack.reserve(resources.size() / 2);
 
@@ -40,30 +86,24 @@ void inc::frag::run_floodcull(cc::span<int> producers,
             CC_ASSERT(resources[popped] == 0 && "unexpected resource refcount");
 
             // go over producers of this resource
-            for (floodcull_relation const& write : writes)
+            for (unsigned const producer_index : producers_by_resource.get(popped))
             {
-                if (write.resource_index != popped)
-                    continue;
-
-                int& producer_refcount = producers[write.producer_index];
+                int& producer_refcount = producers[producer_index];
                 producer_refcount--;
 
                 CC_ASSERT(producer_refcount >= 0 && "producer at unexpected refcount");
                 if (producer_refcount == 0)
                 {
                     // go over reads of this pass
-                    for (floodcull_relation const& read : reads)
+                    for (unsigned const read_resource_index : reads_by_producer.get(producer_index))
                     {
-                        if (read.producer_index != write.producer_index)
-                            continue;
-
-                        int& resource_refcount = resources[read.resource_index];
+                        int& resource_refcount = resources[read_resource_index];
                         resource_refcount--;
 
                         //CC_ASSERT(resource_refcount > 0 && "read resource at unexpected refcount");
 
                         if (resource_refcount == 0)
-                            residx_stack.push_back(read.resource_index);
+                            residx_stack.push_back(read_resource_index);
                     }
                 }
             }
@@ -2,21 +2,83 @@
 
 #include <cinttypes>
 #include <cstdio>
+#include <cstring>
+#include <thread>
 
 #include <clean-core/alloc_vector.hh>
+#include <clean-core/utility.hh>
 
 #include <rich-log/log.hh>
 
 #include <phantasm-hardware-interface/Backend.hh>
+#include <phantasm-hardware-interface/common/hash.hh>
 
 #include <phantasm-renderer/Context.hh>
 #include <phantasm-renderer/Frame.hh>
 
+#include <arcana-incubator/device-abstraction/timer.hh>
 #include <arcana-incubator/imgui/imgui.hh>
 
 #include "floodcull.hh"
 #include "resource_cache.hh"
 
+namespace
+{
+constexpr uint32_t gc_empty_guid_slot = uint32_t(-1);
+
+constexpr unsigned gc_max_num_record_threads = 32;
+static_assert(gc_max_num_record_threads <= inc::frag::gc_max_num_pool_workers + 1, "more ranges than the pool can run at once");
+constexpr unsigned gc_min_passes_per_range = 2; // a frame per pass costs more than it saves
+
+constexpr size_t gc_pass_arena_chunk_size = 64 * 1024;
+
+// true if staying in the state needs no barrier between passes
+// read-only states, and render target and depth writes which are ordered within a queue - not UAV or copy writes
+bool can_skip_transition(phi::resource_state state)
+{
+    using rs = phi::resource_state;
+    switch (state)
+    {
+    case rs::vertex_buffer:
+    case rs::index_buffer:
+    case rs::constant_buffer:
+    case rs::shader_resource:
+    case rs::indirect_argument:
+    case rs::copy_src:
+    case rs::resolve_src:
+    case rs::depth_read:
+    case rs::render_target:
+    case rs::depth_write:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// GUIDs are often small or sequential, mix all bits into the low ones (murmur3 finalizer)
+size_t hash_guid(uint64_t guid)
+{
+    guid ^= guid >> 33;
+    guid *= 0xff51afd7ed558ccdull;
+    guid ^= guid >> 33;
+    guid *= 0xc4ceb9fe1a85ec53ull;
+    guid ^= guid >> 33;
+    return size_t(guid);
+}
+
+uint64_t hash_combine(uint64_t seed, uint64_t value) { return seed ^ (uint64_t(hash_guid(value)) + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2)); }
+
+// shader stage flags are an integer or a flag set depending on the phi version
+template <class T>
+uint64_t to_hashable(T const& value)
+{
+    static_assert(sizeof(T) <= sizeof(uint64_t), "value too large");
+    uint64_t res = 0;
+    std::memcpy(&res, &value, sizeof(T));
+    return res;
+}
+}
+
 inc::frag::res_handle inc::frag::GraphBuilder::registerCreate(inc::frag::pass_idx pass_idx,
                                                               inc::frag::res_guid_t guid,
                                                               const phi::arg::resource_description& info,
@@ -33,6 +95,8 @@ inc::frag::res_handle inc::frag::GraphBuilder::registerCreate(inc::frag::pass_id
     pass.creates.push_back({new_idx, mode});
     ++mNumWritesTotal;
 
+    addToStructureHash(st_create, pass_idx, guid, phi::ComputeHash(info), hash_combine(uint64_t(mode.required_state), to_hashable(mode.stage_flags)));
+
     return guidstate.get_handle();
 }
 
@@ -51,6 +115,8 @@ inc::frag::res_handle inc::frag::GraphBuilder::registerImport(inc::frag::pass_id
     internal_pass& pass = mPasses[pass_idx];
     pass.imports.push_back({new_idx, mode});
 
+    // the imported resource itself is not part of the structure, it can change every frame (ie. the backbuffer)
+    addToStructureHash(st_import, pass_idx, guid, phi::ComputeHash(optional_info), hash_combine(uint64_t(mode.required_state), to_hashable(mode.stage_flags)));
 
     return guidstate.get_handle();
 }
@@ -64,6 +130,7 @@ inc::frag::res_handle inc::frag::GraphBuilder::registerWrite(inc::frag::pass_idx
 
     ++mNumWritesTotal;
     pass.writes.push_back({guidstate.virtual_res, guidstate.virtual_res_version, mode});
+    addToStructureHash(st_write, pass_idx, guid, uint64_t(mode.required_state), to_hashable(mode.stage_flags));
 
     // writes increase resource version
     auto const return_handle = guidstate.get_handle_and_bump_version();
@@ -78,6 +145,7 @@ inc::frag::res_handle inc::frag::GraphBuilder::registerRead(inc::frag::pass_idx
     internal_pass& pass = mPasses[pass_idx];
     pass.reads.push_back({guidstate.virtual_res, guidstate.virtual_res_version, mode});
     ++mNumReadsTotal;
+    addToStructureHash(st_read, pass_idx, guid, uint64_t(mode.required_state), to_hashable(mode.stage_flags));
 
     return guidstate.get_handle();
 }
@@ -98,6 +166,7 @@ inc::frag::res_handle inc::frag::GraphBuilder::registerMove(inc::frag::pass_idx
     internal_pass& pass = mPasses[pass_idx];
     pass.moves.push_back({src_state.virtual_res, src_state.virtual_res_version, dest_guid});
     ++mNumWritesTotal;
+    addToStructureHash(st_move, pass_idx, source_guid, dest_guid);
 
     auto& dest_state = getGuidState(dest_guid);
     if (dest_state.is_valid())
@@ -115,54 +184,184 @@ inc::frag::res_handle inc::frag::GraphBuilder::registerMove(inc::frag::pass_idx
 }
 
 
-void inc::frag::GraphBuilder::realizePhysicalResources(inc::frag::GraphCache& cache)
+void inc::frag::GraphBuilder::calculateLifetimes()
 {
-    CC_ASSERT(mPhysicalResources.empty() && "ran twice");
+    for (pass_idx i = 0; i < mPassOrder.size(); ++i)
+    {
+        auto const& pass = mPasses[mPassOrder[i]];
+        if (pass.is_culled)
+            continue;
 
-    mPhysicalResources.reserve(mVirtualResources.size());
+        auto f_use = [&](virtual_res_idx res, access_mode mode)
+        {
+            virtual_resource& virt = mVirtualResources[res];
+            if (virt.first_use == gc_invalid_pass)
+                virt.first_use = i;
+
+            virt.last_use = i;
+
+            if (mode.is_set())
+                virt.last_state = mode.required_state;
+        };
+
+        // same order as the barriers, the last transition of a pass wins
+        for (auto const& read : pass.reads)
+            f_use(read.res, read.mode);
+
+        for (auto const& write : pass.writes)
+            f_use(write.res, write.mode);
+
+        for (auto const& create : pass.creates)
+            f_use(create.res, create.mode);
+
+        for (auto const& import : pass.imports)
+            f_use(import.res, access_mode{});
+
+        for (auto const& move : pass.moves)
+            f_use(move.src_res, access_mode{});
+    }
+
+    pass_idx const past_last_pass = pass_idx(mPasses.size());
     for (auto& virt : mVirtualResources)
     {
         if (virt.is_culled())
-        {
-            // RICH_LOG_INFO("skipped virtual resource with initial GUID {} (culled)", virt.initial_guid);
             continue;
-        }
 
-        // passthrough imported resources or call the realize_func
-        pr::resource physical;
-        if (virt.is_imported())
+        if (virt.first_use == gc_invalid_pass)
         {
-            physical = virt.imported_resource;
-            // RICH_LOG_INFO("imported virtual resource with initial GUID {}", virt.initial_guid);
+            // never used by a non-culled pass, keep it alive throughout
+            virt.first_use = 0;
+            virt.last_use = past_last_pass;
         }
-        else
+
+        // root resources are used after the graph
+        if (virt.is_root())
+            virt.last_use = past_last_pass;
+    }
+}
+
+void inc::frag::GraphBuilder::realizePhysicalResources(inc::frag::GraphCache& cache, cc::allocator* alloc)
+{
+    CC_ASSERT(mPhysicalResources.empty() && "ran twice");
+
+    mPhysicalResources.reserve(mVirtualResources.size());
+    mMemoryStats = {};
+
+    // passthrough imported resources
+    for (auto& virt : mVirtualResources)
+    {
+        if (virt.is_culled() || !virt.is_imported())
+            continue;
+
+        mPhysicalResources.push_back({virt.imported_resource, virt.resource_info});
+        virt.associated_physical = physical_res_idx(mPhysicalResources.size() - 1);
+    }
+
+    struct transient_physical
+    {
+        uint64_t info_hash;
+        pass_idx last_use; // of its latest virtual resource
+        phi::resource_state last_state;
+        physical_res_idx physical;
+    };
+
+    cc::alloc_vector<transient_physical> transients(alloc);
+    transients.reserve(mVirtualResources.size());
+
+    // combined size of the resources becoming alive (positive) or dead (negative) at each pass
+    auto live_bytes_deltas = cc::alloc_vector<int64_t>::filled(mPasses.size() + 2, 0, alloc);
+
+    // every transient resource has exactly one create, visiting them in pass order assigns physical resources by ascending first use
+    // this greedy interval partitioning needs the least physical resources per resource description
+    for (auto const pass_i : mPassOrder)
+    {
+        for (auto const& create : mPasses[pass_i].creates)
         {
-            char namebuf[256];
-            std::snprintf(namebuf, sizeof(namebuf), "[fgraph-guid:%" PRIu64 "]", virt.initial_guid);
-            physical = cache.get(virt.resource_info, namebuf);
-            // RICH_LOG_INFO("cache-realized virtual resource with initial GUID {}", virt.initial_guid);
+            virtual_resource& virt = mVirtualResources[create.res];
+            if (virt.is_culled())
+                continue;
+
+            uint64_t const info_hash = phi::ComputeHash(virt.resource_info);
+            size_t const size_bytes = get_resource_size_bytes(virt.resource_info);
+
+            ++mMemoryStats.num_transient;
+            mMemoryStats.bytes_without_aliasing += size_bytes;
+            live_bytes_deltas[virt.first_use] += int64_t(size_bytes);
+            live_bytes_deltas[virt.last_use + 1] -= int64_t(size_bytes);
+
+            // reuse a physical resource with the same description whose last virtual resource is dead
+            // only across a state change, the transition into the creation state then acts as the aliasing barrier
+            transient_physical* target = nullptr;
+            if (mEnableAliasing && create.mode.is_set())
+            {
+                for (auto& candidate : transients)
+                {
+                    if (candidate.info_hash == info_hash && candidate.last_use < virt.first_use
+                        && candidate.last_state != phi::resource_state::undefined && candidate.last_state != create.mode.required_state)
+                    {
+                        target = &candidate;
+                        break;
+                    }
+                }
+            }
+
+            if (target == nullptr)
+            {
+                char namebuf[256];
+                std::snprintf(namebuf, sizeof(namebuf), "[fgraph-guid:%" PRIu64 "]", virt.initial_guid);
+                mPhysicalResources.push_back({cache.get(virt.resource_info, namebuf), virt.resource_info});
+
+                transients.push_back({info_hash, 0, phi::resource_state::undefined, physical_res_idx(mPhysicalResources.size() - 1)});
+                target = &transients.back();
+
+                ++mMemoryStats.num_physical;
+                mMemoryStats.bytes_with_aliasing += size_bytes;
+            }
+
+            target->last_use = virt.last_use;
+            target->last_state = virt.last_state;
+            virt.associated_physical = target->physical;
         }
+    }
 
-        mPhysicalResources.push_back({physical, virt.resource_info});
-        virt.associated_physical = physical_res_idx(mPhysicalResources.size() - 1);
+    int64_t live_bytes = 0;
+    for (auto i = 0u; i < mPasses.size(); ++i)
+    {
+        live_bytes += live_bytes_deltas[i];
+        mMemoryStats.bytes_peak_live = cc::max(mMemoryStats.bytes_peak_live, size_t(live_bytes));
     }
 }
 
 
-void inc::frag::GraphBuilder::calculateBarriers()
+void inc::frag::GraphBuilder::calculateBarriers(cc::allocator* alloc)
 {
-    // this is extremely naive right now
     // things to eventually consider:
     // - batching accross passes
     // - split barriers (requires phi features)
     // - lowest-common-denominator states (might require vk/d3d12 specific implementations)
     // - separate invalidate/flush barriers
-    // - compatibility with eventual aliasing
     // - cross-queue concerns
+    //
+    // the state of each physical resource is tracked across the (non-culled) pass order,
+    // with barrier elimination, transitions into the state it is already in are skipped where no barrier is needed
+    // NOTE: this relies on the exec functions not changing states behind the graph's back (see exec_context)
+    //
+    // physical resources shared by multiple virtual resources (see realizePhysicalResources):
+    // the next virtual resource is only placed across a state change, so the transition
+    // into its creation state recorded here is the aliasing barrier (orders all prior accesses)
+
+    struct tracked_state
+    {
+        phi::resource_state state = phi::resource_state::undefined; // unknown before the first transition
+        phi::shader_stage_flags_t stage_flags = 0;
+    };
 
+    auto physical_states = cc::alloc_vector<tracked_state>::filled(mPhysicalResources.size(), tracked_state{}, alloc);
+    mBarrierStats = {};
 
-    for (auto& pass : mPasses)
+    for (auto const pass_i : mPassOrder)
     {
+        internal_pass& pass = mPasses[pass_i];
         if (pass.is_culled)
             continue;
 
@@ -177,7 +376,42 @@ void inc::frag::GraphBuilder::calculateBarriers()
             auto const physical_idx = mVirtualResources[virtual_res].associated_physical;
             CC_ASSERT(physical_idx != gc_invalid_physical_res);
             auto const res = mPhysicalResources[physical_idx].raw_res.handle;
-            pass.transitions_before.push_back({res, mode.required_state, mode.stage_flags});
+            tracked_state& current = physical_states[physical_idx];
+
+            ++mBarrierStats.num_requested;
+
+            // at most one transition per resource and pass, the same state merges the shader stages, otherwise the last access wins
+            for (auto& transition : pass.transitions_before)
+            {
+                if (transition.resource != res)
+                    continue;
+
+                if (transition.target_state == mode.required_state)
+                    transition.dependent_shaders = transition.dependent_shaders | mode.stage_flags;
+                else
+                    transition = {res, mode.required_state, mode.stage_flags};
+
+                current = {transition.target_state, transition.dependent_shaders};
+                ++mBarrierStats.num_merged;
+                return;
+            }
+
+            phi::shader_stage_flags_t stage_flags = mode.stage_flags;
+            if (mEnableBarrierElimination && current.state == mode.required_state && can_skip_transition(mode.required_state))
+            {
+                // already in this state, skipped unless shader stages are added
+                if ((current.stage_flags | mode.stage_flags) == current.stage_flags)
+                {
+                    ++mBarrierStats.num_eliminated;
+                    return;
+                }
+
+                stage_flags = current.stage_flags | mode.stage_flags;
+            }
+
+            pass.transitions_before.push_back({res, mode.required_state, stage_flags});
+            pass.transition_physicals.push_back(physical_idx);
+            current = {mode.required_state, stage_flags};
         };
 
         for (auto const& read : pass.reads)
@@ -188,49 +422,191 @@ void inc::frag::GraphBuilder::calculateBarriers()
 
         for (auto const& create : pass.creates)
             f_add_barrier(create.res, create.mode);
+
+        mBarrierStats.num_emitted += unsigned(pass.transitions_before.size());
     }
 }
 
 void inc::frag::GraphBuilder::executePasses(pr::raii::Frame* frame, size_t start, size_t end, pre::timestamp_bundle* timing, int timer_offset)
 {
     CC_CONTRACT(frame != nullptr);
-    CC_ASSERT(end <= mPasses.size() && "pass amount out of bounds");
+    CC_ASSERT(end <= mPassOrder.size() && "pass amount out of bounds, or not compiled");
 
     for (auto i = start; i < end; ++i)
     {
-        auto const& pass = mPasses[i];
-        if (pass.is_culled)
+        if (mPasses[mPassOrder[i]].is_culled)
             continue;
 
-        for (auto const& transition_pre : pass.transitions_before)
-            frame->transition(transition_pre.resource, transition_pre.target_state, transition_pre.dependent_shaders);
+        executePass(frame, mPassOrder[i], timing, timer_offset, false);
+    }
+}
+
+void inc::frag::GraphBuilder::executePass(pr::raii::Frame* frame, inc::frag::pass_idx pass_idx, inc::pre::timestamp_bundle* timing, int timer_offset, bool skip_released)
+{
+    auto const& pass = mPasses[pass_idx];
+
+    // recorded back to back, the frame batches them into a single transition command before the pass
+    auto const num_transitions = pass.transitions_before.size() - (skip_released ? pass.num_released_transitions : 0);
+    for (auto i = 0u; i < num_transitions; ++i)
+    {
+        auto const& transition_pre = pass.transitions_before[i];
+        frame->transition(transition_pre.resource, transition_pre.target_state, transition_pre.dependent_shaders);
+    }
+
+    frame->begin_debug_label(pass.debug_name);
+    if (timing)
+        timing->begin_timing(*frame, pass_idx + timer_offset);
+
+    exec_context exec_ctx = {pass_idx, this, frame};
+    pass.execute_func(pass.execute_closure, exec_ctx);
 
+    if (timing)
+        timing->end_timing(*frame, pass_idx + timer_offset);
+    frame->end_debug_label();
+}
+
+void inc::frag::GraphBuilder::execute(pr::raii::Frame* frame, inc::pre::timestamp_bundle* timing, int timer_offset)
+{
+    mRecordTimings.clear();
+    executePasses(frame, 0, mPassOrder.size(), timing, timer_offset);
+}
+
+unsigned inc::frag::GraphBuilder::executeParallel(pr::Context& ctx, unsigned max_num_threads, inc::pre::timestamp_bundle* timing, int timer_offset)
+{
+    mRecordTimings.clear();
+
+    unsigned num_active = 0;
+    for (auto const& pass : mPasses)
+        num_active += pass.is_culled ? 0 : 1;
+
+    if (num_active == 0)
+        return 0;
+
+    unsigned num_threads = max_num_threads > 0 ? max_num_threads : cc::max(1u, std::thread::hardware_concurrency());
+    num_threads = cc::min(num_threads, gc_max_num_record_threads);
+    num_threads = cc::max(1u, cc::min(num_threads, num_active / gc_min_passes_per_range));
+
+    // contiguous ranges with an even share of the non-culled passes, in graph order
+    unsigned const passes_per_range = (num_active + num_threads - 1) / num_threads;
+    {
+        record_range_timing range;
+        for (pass_idx i = 0; i < mPassOrder.size(); ++i)
         {
-            frame->begin_debug_label(pass.debug_name);
-            if (timing)
-                timing->begin_timing(*frame, i + timer_offset);
+            if (mPasses[mPassOrder[i]].is_culled)
+                continue;
 
-            exec_context exec_ctx = {(pass_idx)i, this, frame};
-            pass.execute_func(exec_ctx);
+            if (range.num_passes == passes_per_range)
+            {
+                range.end = i;
+                mRecordTimings.push_back(range);
+                range = {};
+                range.start = i;
+            }
 
-            if (timing)
-                timing->end_timing(*frame, i + timer_offset);
-            frame->end_debug_label();
+            ++range.num_passes;
         }
+
+        range.end = pass_idx(mPassOrder.size());
+        mRecordTimings.push_back(range);
     }
+
+    // frames are created up front, the worker threads only record into them
+    cc::capped_vector<pr::raii::Frame, gc_max_num_record_threads> frames;
+    for (auto i = 0u; i < mRecordTimings.size(); ++i)
+        frames.emplace_back(ctx.make_frame());
+
+    auto f_record_range = [&](unsigned range_idx)
+    {
+        record_range_timing& range = mRecordTimings[range_idx];
+        da::Timer timer;
+        executePasses(&frames[range_idx], range.start, range.end, timing, timer_offset);
+        range.record_ms = timer.elapsedMilliseconds();
+    };
+
+    // the calling thread records as well, the workers persist across calls
+    mRecordPool.run(unsigned(mRecordTimings.size()), f_record_range);
+
+    // transitions_before are computed across the whole graph, the resource states are only consistent in this order
+    for (auto& frame : frames)
+        ctx.submit(cc::move(frame));
+
+    return unsigned(mRecordTimings.size());
 }
 
-void inc::frag::GraphBuilder::execute(pr::raii::Frame* frame, inc::pre::timestamp_bundle* timing, int timer_offset)
+void inc::frag::GraphBuilder::executeScheduled(pr::Context& ctx, inc::pre::timestamp_bundle* timing, int timer_offset)
 {
-    executePasses(frame, 0, mPasses.size(), timing, timer_offset);
+    mRecordTimings.clear();
+
+    phi::Backend& backend = ctx.get_backend();
+    if (mFenceBackend == nullptr)
+    {
+        mFenceBackend = &backend;
+        for (auto& fence : mQueueFences)
+            fence = backend.createFence();
+    }
+    CC_ASSERT(mFenceBackend == &backend && "executed with a different context");
+
+    uint64_t num_batches_per_queue[gc_num_queue_types] = {};
+    for (auto const& batch : mQueueSchedule.batches)
+        num_batches_per_queue[unsigned(batch.queue)] = batch.serial;
+
+    for (uint32_t b = 0; b < mQueueSchedule.batches.size(); ++b)
+    {
+        queue_batch const& batch = mQueueSchedule.batches[b];
+        auto const queue_idx = unsigned(batch.queue);
+        bool const is_last_on_queue = batch.serial == num_batches_per_queue[queue_idx];
+
+        auto frame = ctx.make_frame();
+        for (auto i = batch.passes_start; i < batch.passes_end; ++i)
+            executePass(&frame, mQueueSchedule.passes[i], timing, timer_offset, true);
+
+        for (auto const& release : mReleaseTransitions)
+        {
+            if (release.batch == b)
+                frame.transition(release.transition.resource, release.transition.target_state, release.transition.dependent_shaders);
+        }
+
+        for (auto q = 0u; q < gc_num_queue_types; ++q)
+        {
+            if (batch.wait_serials[q] > 0)
+                backend.waitFenceGPU(mQueueFences[q], mQueueFenceBases[q] + batch.wait_serials[q], batch.queue);
+            else if (batch.serial == 1 && q != queue_idx && mQueueFenceFinals[q] > 0)
+                // cross-execution, a wait within this execution has a higher value and covers it
+                backend.waitFenceGPU(mQueueFences[q], mQueueFenceFinals[q], batch.queue);
+        }
+
+        ctx.submit(cc::move(frame), batch.queue);
+
+        if (batch.needs_signal || is_last_on_queue)
+            backend.signalFenceGPU(mQueueFences[queue_idx], mQueueFenceBases[queue_idx] + batch.serial, batch.queue);
+    }
+
+    // fence values only increase, the next execution continues after the serials of this one
+    for (auto q = 0u; q < gc_num_queue_types; ++q)
+    {
+        mQueueFenceBases[q] += num_batches_per_queue[q];
+        if (num_batches_per_queue[q] > 0)
+            mQueueFenceFinals[q] = mQueueFenceBases[q];
+    }
 }
 
 void inc::frag::GraphBuilder::reset()
 {
+    // the passes only point into the arena
     mPasses.clear();
+    mPassArena.reset();
     mGuidStates.clear();
+    for (auto& slot : mGuidLookup)
+        slot = gc_empty_guid_slot;
     mVirtualResources.clear();
     mPhysicalResources.clear();
+    mPassOrder.clear();
+    mReorderStats = {};
+    mMemoryStats = {};
+    mBarrierStats = {};
+    mStructureHash = 0;
+    mQueueSchedule.clear();
+    mReleaseTransitions.clear();
     mNumReadsTotal = 0;
     mNumWritesTotal = 0;
 }
@@ -314,6 +690,67 @@ void inc::frag::GraphBuilder::performInfoImgui(const pre::timestamp_bundle* timi
         }
 
         ImGui::Text("%u passes culled, %u root passes, total time: % 2.3fms", num_culled, num_root, time_sum);
+
+        auto const f_to_mb = [](size_t bytes) { return float(double(bytes) / (1024. * 1024.)); };
+        ImGui::Text("%u transient resources in %u physical, %.1f MB (%.1f MB without aliasing, peak live %.1f MB)", mMemoryStats.num_transient,
+                    mMemoryStats.num_physical, f_to_mb(mMemoryStats.bytes_with_aliasing), f_to_mb(mMemoryStats.bytes_without_aliasing),
+                    f_to_mb(mMemoryStats.bytes_peak_live));
+
+        ImGui::Text("%u transitions emitted, %u redundant skipped, %u merged within a pass", mBarrierStats.num_emitted, mBarrierStats.num_eliminated,
+                    mBarrierStats.num_merged);
+
+        if (mEnableReordering)
+        {
+            ImGui::Text("%u passes reordered, estimated transitions %u -> %u, queue switches %u -> %u", mReorderStats.num_moved,
+                        mReorderStats.num_transitions_before, mReorderStats.num_transitions_after, mReorderStats.num_queue_switches_before,
+                        mReorderStats.num_queue_switches_after);
+        }
+
+        ImGui::Text("%u queue batches, %u cross-queue waits for %u dependencies", unsigned(mQueueSchedule.batches.size()), mQueueSchedule.num_waits,
+                    mQueueSchedule.num_dependencies);
+
+        auto const& arena_stats = mPassArena.get_stats();
+        ImGui::Text("pass closures: %u in %.1f KB (%.1f KB reserved), %u allocations this frame", unsigned(arena_stats.num_allocations),
+                    float(arena_stats.bytes_used) / 1024.f, float(arena_stats.bytes_reserved) / 1024.f, unsigned(arena_stats.num_backing_allocations));
+
+        ImGui::TextUnformatted(mLastCompileReused ? "compile reused, graph structure unchanged" : "full compile");
+
+        if (!mRecordTimings.empty())
+        {
+            float record_ms_max = 0.f;
+            float record_ms_sum = 0.f;
+            for (auto const& range : mRecordTimings)
+            {
+                record_ms_max = cc::max(record_ms_max, range.record_ms);
+                record_ms_sum += range.record_ms;
+            }
+
+            ImGui::Text("recorded in %u ranges, CPU time: % 2.3fms longest, % 2.3fms total", unsigned(mRecordTimings.size()), record_ms_max, record_ms_sum);
+
+            if (ImGui::BeginTable("record_ranges", 3, tableFlags))
+            {
+                ImGui::TableSetupColumn("Passes");
+                ImGui::TableSetupColumn("Active");
+                ImGui::TableSetupColumn("CPU Time", 0, 60.f);
+                ImGui::TableHeadersRow();
+
+                for (auto const& range : mRecordTimings)
+                {
+                    ImGui::TableNextRow();
+
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::Text("%u - %u", unsigned(range.start), unsigned(range.end));
+
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text("%2u", range.num_passes);
+
+                    ImGui::TableSetColumnIndex(2);
+                    ImGui::Text("% 2.3fms", range.record_ms);
+                }
+
+                ImGui::EndTable();
+            }
+        }
     }
     ImGui::End();
 }
@@ -386,31 +823,372 @@ void inc::frag::GraphBuilder::runFloodfillCulling(cc::allocator* alloc)
     }
 }
 
+void inc::frag::GraphBuilder::calculatePassOrder(cc::allocator* alloc)
+{
+    mPassOrder.clear();
+    mReorderStats = {};
+
+    if (!mEnableReordering)
+    {
+        for (pass_idx i = 0; i < mPasses.size(); ++i)
+            mPassOrder.push_back(i);
+        return;
+    }
+
+    auto pass_queues = cc::alloc_vector<phi::queue_type>::uninitialized(mPasses.size(), alloc);
+    auto pass_culled = cc::alloc_vector<bool>::uninitialized(mPasses.size(), alloc);
+
+    cc::alloc_vector<reorder_access> accesses(alloc);
+    accesses.reserve(mNumReadsTotal + mNumWritesTotal);
+
+    for (pass_idx i = 0; i < mPasses.size(); ++i)
+    {
+        internal_pass const& pass = mPasses[i];
+        pass_queues[i] = pass.queue;
+        pass_culled[i] = pass.is_culled;
+
+        // same access order as the barriers, the last requested state of a pass wins
+        for (auto const& read : pass.reads)
+            accesses.push_back({i, read.res, false, read.mode.required_state});
+
+        for (auto const& write : pass.writes)
+            accesses.push_back({i, write.res, true, write.mode.required_state});
+
+        for (auto const& create : pass.creates)
+            accesses.push_back({i, create.res, true, create.mode.required_state});
+
+        for (auto const& import : pass.imports)
+            accesses.push_back({i, import.res, true, import.mode.required_state});
+
+        // moved resources are accessed through the new GUID afterwards, ordered like a write
+        for (auto const& move : pass.moves)
+            accesses.push_back({i, move.src_res, true, phi::resource_state::undefined});
+    }
+
+    for (auto i = 0u; i < mPasses.size(); ++i)
+        mPassOrder.push_back(0);
+
+    run_pass_reorder({mPassOrder.data(), mPassOrder.size()}, mReorderStats, {pass_queues.data(), pass_queues.size()},
+                     {pass_culled.data(), pass_culled.size()}, {accesses.data(), accesses.size()}, mVirtualResources.size(), alloc);
+}
+
 
 void inc::frag::GraphBuilder::initialize(cc::allocator* alloc, unsigned max_num_passes, unsigned max_num_guids)
 {
+    mAllocator = alloc;
     mPasses.reset_reserve(alloc, max_num_passes);
     mGuidStates.reset_reserve(alloc, max_num_guids);
+
+    size_t lookup_size = 16;
+    while (lookup_size < 2 * size_t(max_num_guids))
+        lookup_size *= 2;
+    mGuidLookup = cc::alloc_vector<uint32_t>::filled(lookup_size, gc_empty_guid_slot, alloc);
+
     mVirtualResources.reset_reserve(alloc, max_num_guids);
     mPhysicalResources.reset_reserve(alloc, max_num_guids);
+    mPassOrder.reset_reserve(alloc, max_num_passes);
+    mPassArena.initialize(alloc, gc_pass_arena_chunk_size);
+    mRecordTimings.reset_reserve(alloc, gc_max_num_record_threads);
+    mQueueSchedule.reset_reserve(alloc, max_num_passes);
+    mReleaseTransitions.reset_reserve(alloc, max_num_passes);
+
+    mLastCompile.is_valid = false;
+    mLastCompile.pass_order.reset_reserve(alloc, max_num_passes);
+    mLastCompile.passes_culled.reset_reserve(alloc, max_num_passes);
+    mLastCompile.pass_transition_offsets.reset_reserve(alloc, max_num_passes + 1);
+    mLastCompile.transitions.reset_reserve(alloc, max_num_passes * 4);
+    mLastCompile.pass_num_released.reset_reserve(alloc, max_num_passes);
+    mLastCompile.virtuals.reset_reserve(alloc, max_num_guids);
+    mLastCompile.physicals.reset_reserve(alloc, max_num_guids);
+    mLastCompile.schedule.reset_reserve(alloc, max_num_passes);
+    mLastCompile.release_transitions.reset_reserve(alloc, max_num_passes);
 }
 
 void inc::frag::GraphBuilder::destroy()
 {
     reset();
+    mLastCompile.is_valid = false;
+
+    mPassArena.destroy();
+    mRecordPool.destroy();
+
+    // the GPU must be done with the last executeScheduled
+    if (mFenceBackend != nullptr)
+    {
+        mFenceBackend->free(cc::span<phi::handle::fence const>{mQueueFences, gc_num_queue_types});
+        mFenceBackend = nullptr;
+
+        for (auto q = 0u; q < gc_num_queue_types; ++q)
+        {
+            mQueueFences[q] = phi::handle::null_fence;
+            mQueueFenceBases[q] = 0;
+            mQueueFenceFinals[q] = 0;
+        }
+    }
 }
 
 void inc::frag::GraphBuilder::compile(inc::frag::GraphCache& cache, cc::allocator* alloc)
 {
-    runFloodfillCulling(alloc);
-    realizePhysicalResources(cache);
-    calculateBarriers();
+    mLastCompileReused = mEnableCompileReuse && mLastCompile.is_valid && mLastCompile.structure_hash == mStructureHash
+                         && mLastCompile.cache == &cache && mLastCompile.enable_aliasing == mEnableAliasing
+                         && mLastCompile.enable_reordering == mEnableReordering && mLastCompile.enable_barrier_elimination == mEnableBarrierElimination
+                         && restoreCompileResults(cache);
+    if (!mLastCompileReused)
+    {
+        runFloodfillCulling(alloc);
+        calculatePassOrder(alloc);
+        calculateLifetimes();
+        realizePhysicalResources(cache, alloc);
+        calculateBarriers(alloc);
+        scheduleQueues(alloc);
+
+        storeCompileResults(cache);
+    }
 }
 
-void inc::frag::GraphBuilder::printState() const
+void inc::frag::GraphBuilder::scheduleQueues(cc::allocator* alloc)
 {
+    mReleaseTransitions.clear();
+
+    auto pass_queues = cc::alloc_vector<phi::queue_type>::uninitialized(mPasses.size(), alloc);
+    auto pass_culled = cc::alloc_vector<bool>::uninitialized(mPasses.size(), alloc);
+
+    cc::alloc_vector<schedule_access> accesses(alloc);
+    accesses.reserve(mNumReadsTotal + mNumWritesTotal);
+
+    // the scheduler works on positions in the pass order
+    for (pass_idx i = 0; i < mPassOrder.size(); ++i)
+    {
+        internal_pass& pass = mPasses[mPassOrder[i]];
+        pass.num_released_transitions = 0;
+        pass_queues[i] = pass.queue;
+        pass_culled[i] = pass.is_culled;
+
+        if (pass.is_culled)
+            continue;
+
+        // accesses transitioning the resource modify it as well
+        auto f_add_access = [&](virtual_res_idx virtual_res, bool is_write)
+        {
+            auto const physical_idx = mVirtualResources[virtual_res].associated_physical;
+            CC_ASSERT(physical_idx != gc_invalid_physical_res);
+
+            bool is_transitioned = false;
+            for (auto const transitioned : pass.transition_physicals)
+                is_transitioned |= transitioned == physical_idx;
+
+            accesses.push_back({i, physical_idx, is_write || is_transitioned});
+        };
+
+        for (auto const& import : pass.imports)
+            f_add_access(import.res, false);
+
+        for (auto const& read : pass.reads)
+            f_add_access(read.res, false);
+
+        for (auto const& write : pass.writes)
+            f_add_access(write.res, true);
+
+        for (auto const& create : pass.creates)
+            f_add_access(create.res, true);
+    }
+
+    run_queue_schedule(mQueueSchedule, {pass_queues.data(), pass_queues.size()}, {pass_culled.data(), pass_culled.size()},
+                       {accesses.data(), accesses.size()}, mPhysicalResources.size(), alloc);
+
+    for (auto& pass : mQueueSchedule.passes)
+        pass = mPassOrder[pass];
+
+    for (auto& handoff : mQueueSchedule.handoffs)
+        handoff.dest_pass = mPassOrder[handoff.dest_pass];
+
+    // queue ownership: compute and copy queues can't transition out of graphics states (ie. render_target),
+    // resources handed over from the direct queue are transitioned at the end of its batch instead, before the signal
+    // only executeScheduled does this, execute records all transitions before their pass
+    for (queue_handoff const& handoff : mQueueSchedule.handoffs)
+    {
+        if (mQueueSchedule.batches[handoff.src_batch].queue != phi::queue_type::direct
+            || mQueueSchedule.batches[handoff.dest_batch].queue == phi::queue_type::direct)
+            continue;
+
+        internal_pass& pass = mPasses[handoff.dest_pass];
+        for (auto t = 0u; t < pass.transition_physicals.size(); ++t)
+        {
+            if (pass.transition_physicals[t] != handoff.physical)
+                continue;
+
+            mReleaseTransitions.push_back({handoff.src_batch, handoff.physical, pass.transitions_before[t]});
+
+            // moved to the end, the order within a pass does not matter as its transitions are recorded as one batch
+            auto const last = pass.transitions_before.size() - 1 - pass.num_released_transitions;
+            cc::swap(pass.transitions_before[t], pass.transitions_before[last]);
+            cc::swap(pass.transition_physicals[t], pass.transition_physicals[last]);
+            ++pass.num_released_transitions;
+            break;
+        }
+    }
+}
+
+bool inc::frag::GraphBuilder::restoreCompileResults(inc::frag::GraphCache& cache)
+{
+    CC_ASSERT(mPhysicalResources.empty() && "ran twice");
+    auto const& last = mLastCompile;
+
+    if (last.passes_culled.size() != mPasses.size() || last.virtuals.size() != mVirtualResources.size())
+        return false;
+
+    CC_ASSERT(mPassOrder.empty() && "ran twice");
+
+    // transient resources must still be cached, LRU eviction might have freed them in the meantime
+    // all are looked up first, a failure leaves the cache untouched for the full compile
+    for (auto const& phys : last.physicals)
+    {
+        if (phys.imported_res == gc_invalid_virtual_res && !cache.canReacquire(phys.info_hash, phys.physical.raw_res))
+            return false;
+    }
+
+    for (auto const& phys : last.physicals)
+    {
+        if (phys.imported_res != gc_invalid_virtual_res)
+        {
+            auto const& virt = mVirtualResources[phys.imported_res];
+            mPhysicalResources.push_back({virt.imported_resource, virt.resource_info});
+        }
+        else
+        {
+            bool const reacquired = cache.reacquire(phys.info_hash, phys.physical.raw_res);
+            CC_ASSERT(reacquired && "physical resource vanished after lookup");
+            (void)reacquired;
+
+            mPhysicalResources.push_back(phys.physical);
+        }
+    }
+
+    for (auto i = 0u; i < mVirtualResources.size(); ++i)
+    {
+        virtual_resource& virt = mVirtualResources[i];
+        compiled_virtual const& compiled = last.virtuals[i];
+
+        if (compiled.is_culled)
+            virt.state |= virtual_resource::sb_culled;
+
+        virt.associated_physical = compiled.associated_physical;
+        virt.first_use = compiled.first_use;
+        virt.last_use = compiled.last_use;
+        virt.last_state = compiled.last_state;
+    }
+
+    // transitions are stored by physical index, imported handles are patched in here
+    for (auto i = 0u; i < mPasses.size(); ++i)
+    {
+        internal_pass& pass = mPasses[i];
+        pass.is_culled = last.passes_culled[i] != 0;
+        pass.num_released_transitions = last.pass_num_released[i];
+
+        for (auto t = last.pass_transition_offsets[i]; t < last.pass_transition_offsets[i + 1]; ++t)
+        {
+            compiled_transition const& transition = last.transitions[t];
+            pass.transitions_before.push_back({mPhysicalResources[transition.physical].raw_res.handle, transition.target_state, transition.dependent_shaders});
+            pass.transition_physicals.push_back(transition.physical);
+        }
+    }
+
+    for (auto const pass : last.pass_order)
+        mPassOrder.push_back(pass);
+
+    mQueueSchedule.assign(last.schedule);
+    for (auto const& release : last.release_transitions)
+    {
+        compiled_transition const& transition = release.transition;
+        mReleaseTransitions.push_back({release.batch, transition.physical,
+                                       {mPhysicalResources[transition.physical].raw_res.handle, transition.target_state, transition.dependent_shaders}});
+    }
+
+    mMemoryStats = last.memory;
+    mReorderStats = last.reorder;
+    mBarrierStats = last.barriers;
+    return true;
+}
+
+void inc::frag::GraphBuilder::storeCompileResults(const inc::frag::GraphCache& cache)
+{
+    auto& last = mLastCompile;
+    last.is_valid = true;
+    last.structure_hash = mStructureHash;
+    last.cache = &cache;
+    last.enable_aliasing = mEnableAliasing;
+    last.enable_reordering = mEnableReordering;
+    last.enable_barrier_elimination = mEnableBarrierElimination;
+
+    last.pass_order.clear();
+    for (auto const pass : mPassOrder)
+        last.pass_order.push_back(pass);
+
+    last.passes_culled.clear();
+    last.pass_transition_offsets.clear();
+    last.transitions.clear();
+    last.pass_num_released.clear();
     for (auto const& pass : mPasses)
     {
+        last.passes_culled.push_back(pass.is_culled ? 1 : 0);
+        last.pass_num_released.push_back(pass.num_released_transitions);
+        last.pass_transition_offsets.push_back(uint32_t(last.transitions.size()));
+
+        for (auto t = 0u; t < pass.transitions_before.size(); ++t)
+        {
+            auto const& transition = pass.transitions_before[t];
+            last.transitions.push_back({pass.transition_physicals[t], transition.target_state, transition.dependent_shaders});
+        }
+    }
+    last.pass_transition_offsets.push_back(uint32_t(last.transitions.size()));
+
+    last.physicals.clear();
+    for (auto const& phys : mPhysicalResources)
+        last.physicals.push_back({phys, phi::ComputeHash(phys.info), gc_invalid_virtual_res});
+
+    last.virtuals.clear();
+    for (auto i = 0u; i < mVirtualResources.size(); ++i)
+    {
+        auto const& virt = mVirtualResources[i];
+        last.virtuals.push_back({virt.is_culled(), virt.associated_physical, virt.first_use, virt.last_use, virt.last_state});
+
+        if (virt.is_imported() && !virt.is_culled())
+            last.physicals[virt.associated_physical].imported_res = virtual_res_idx(i);
+    }
+
+    last.schedule.assign(mQueueSchedule);
+    last.release_transitions.clear();
+    for (auto const& release : mReleaseTransitions)
+        last.release_transitions.push_back({release.batch, {release.physical, release.transition.target_state, release.transition.dependent_shaders}});
+
+    last.memory = mMemoryStats;
+    last.reorder = mReorderStats;
+    last.barriers = mBarrierStats;
+}
+
+void inc::frag::GraphBuilder::addToStructureHash(e_structure_tag tag, uint64_t a, uint64_t b, uint64_t c, uint64_t d)
+{
+    uint64_t hash = hash_combine(mStructureHash, tag);
+    hash = hash_combine(hash, a);
+    hash = hash_combine(hash, b);
+    hash = hash_combine(hash, c);
+    mStructureHash = hash_combine(hash, d);
+}
+
+uint64_t inc::frag::GraphBuilder::hashPassName(const char* name)
+{
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (; name != nullptr && *name != '\0'; ++name)
+        hash = (hash ^ uint64_t(uint8_t(*name))) * 0x100000001b3ull;
+    return hash;
+}
+
+void inc::frag::GraphBuilder::printState() const
+{
+    for (auto const pass_i : mPassOrder)
+    {
+        auto const& pass = mPasses[pass_i];
         if (pass.is_culled)
             continue;
 
@@ -448,8 +1226,18 @@ void inc::frag::GraphBuilder::printState() const
         if (res.is_culled())
             continue;
 
-        RICH_LOG("resource {}", res.initial_guid);
+        RICH_LOG("resource {}, physical {}, passes {} - {}", res.initial_guid, res.associated_physical, res.first_use, res.last_use);
     }
+
+    RICH_LOG("{} transient resources in {} physical, {} bytes ({} without aliasing, peak live {})", mMemoryStats.num_transient, mMemoryStats.num_physical,
+             mMemoryStats.bytes_with_aliasing, mMemoryStats.bytes_without_aliasing, mMemoryStats.bytes_peak_live);
+    if (mEnableReordering)
+    {
+        RICH_LOG("{} passes reordered, estimated transitions {} -> {}, queue switches {} -> {}", mReorderStats.num_moved, mReorderStats.num_transitions_before,
+                 mReorderStats.num_transitions_after, mReorderStats.num_queue_switches_before, mReorderStats.num_queue_switches_after);
+    }
+    RICH_LOG("{} of {} transitions emitted, {} redundant skipped, {} merged", mBarrierStats.num_emitted, mBarrierStats.num_requested,
+             mBarrierStats.num_eliminated, mBarrierStats.num_merged);
 }
 
 inc::frag::virtual_res_idx inc::frag::GraphBuilder::addResource(inc::frag::pass_idx producer, inc::frag::res_guid_t guid, const phi::arg::resource_description& info)
@@ -471,13 +1259,46 @@ inc::frag::virtual_res_idx inc::frag::GraphBuilder::addResource(inc::frag::pass_
 
 inc::frag::GraphBuilder::guid_state& inc::frag::GraphBuilder::getGuidState(inc::frag::res_guid_t guid)
 {
-    for (auto& state : mGuidStates)
+    CC_ASSERT(!mGuidLookup.empty() && "GraphBuilder uninitialized");
+    size_t const mask = mGuidLookup.size() - 1;
+
+    for (size_t slot = hash_guid(guid) & mask;; slot = (slot + 1) & mask)
     {
-        if (state.guid == guid)
-            return state;
+        uint32_t const state_idx = mGuidLookup[slot];
+
+        if (state_idx == gc_empty_guid_slot)
+        {
+            // not found, insert - keep the table at most half full for short probe sequences
+            if (2 * (mGuidStates.size() + 1) > mGuidLookup.size())
+            {
+                rebuildGuidLookup(2 * mGuidLookup.size());
+                return getGuidState(guid);
+            }
+
+            mGuidLookup[slot] = uint32_t(mGuidStates.size());
+            return mGuidStates.emplace_back(guid);
+        }
+
+        if (mGuidStates[state_idx].guid == guid)
+            return mGuidStates[state_idx];
     }
+}
+
+void inc::frag::GraphBuilder::rebuildGuidLookup(size_t table_size)
+{
+    CC_ASSERT(table_size > 0 && (table_size & (table_size - 1)) == 0 && "lookup size must be a power of two");
 
-    return mGuidStates.emplace_back(guid);
+    mGuidLookup = cc::alloc_vector<uint32_t>::filled(table_size, gc_empty_guid_slot, mAllocator);
+    size_t const mask = table_size - 1;
+
+    for (auto i = 0u; i < mGuidStates.size(); ++i)
+    {
+        size_t slot = hash_guid(mGuidStates[i].guid) & mask;
+        while (mGuidLookup[slot] != gc_empty_guid_slot)
+            slot = (slot + 1) & mask;
+
+        mGuidLookup[slot] = i;
+    }
 }
 
 void inc::frag::GraphBuilder::guid_state::on_create(inc::frag::virtual_res_idx new_res)
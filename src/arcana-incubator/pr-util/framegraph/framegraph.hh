@@ -2,10 +2,11 @@
 
 #include <cstdint>
 #include <type_traits>
+#include <utility>
 
 #include <clean-core/capped_vector.hh>
 #include <clean-core/function_ref.hh>
-#include <clean-core/unique_function.hh>
+#include <clean-core/span.hh>
 #include <clean-core/vector.hh>
 
 #include <phantasm-hardware-interface/fwd.hh>
@@ -18,7 +19,11 @@
 #include <arcana-incubator/pr-util/timestamp_bundle.hh>
 
 #include "fwd.hh"
+#include "pass_arena.hh"
+#include "pass_reorder.hh"
+#include "queue_schedule.hh"
 #include "types.hh"
+#include "worker_pool.hh"
 
 namespace inc::frag
 {
@@ -32,9 +37,42 @@ struct physical_resource
     [[nodiscard]] pr::texture as_texture() const { return {raw_res}; }
 };
 
+// transient (non-imported) resource memory of the last compile, sizes are estimates without placement alignment
+struct memory_stats
+{
+    unsigned num_transient = 0;        // realized virtual resources
+    unsigned num_physical = 0;         // physical resources backing them
+    size_t bytes_without_aliasing = 0; // one physical resource per virtual resource
+    size_t bytes_with_aliasing = 0;    // after reusing physical resources across disjoint lifetimes
+    size_t bytes_peak_live = 0;        // largest combined size of resources alive during a single pass
+};
+
+// resource transitions of the last compile
+struct barrier_stats
+{
+    unsigned num_requested = 0;  // accesses with a set access mode
+    unsigned num_emitted = 0;    // transitions recorded before passes
+    unsigned num_eliminated = 0; // skipped, the physical resource was already in the state (only with barrier elimination)
+    unsigned num_merged = 0;     // combined with another access to the same resource in the same pass
+};
+
+// a contiguous range of passes recorded into its own frame by executeParallel
+struct record_range_timing
+{
+    pass_idx start = 0; // positions [start, end) in the pass order, including culled passes
+    pass_idx end = 0;
+    unsigned num_passes = 0; // non-culled passes in the range
+    float record_ms = 0.f;   // CPU time of executing the passes on the worker thread
+};
+
 class GraphBuilder
 {
 public:
+    GraphBuilder() = default;
+    GraphBuilder(GraphBuilder const&) = delete;
+    GraphBuilder(GraphBuilder&&) = delete;
+    ~GraphBuilder() { destroy(); }
+
     void initialize(cc::allocator* alloc, unsigned max_num_passes, unsigned max_num_guids);
 
     void destroy();
@@ -55,15 +93,63 @@ public:
 
     void printState() const;
 
+    // reuse physical resources of transient resources whose lifetimes do not overlap, on by default
+    void setAliasingEnabled(bool enabled) { mEnableAliasing = enabled; }
+
+    // reorder the passes along their dependencies after culling, to save transitions and cluster queues, off by default
+    // only the dependencies declared during setup are respected (see run_pass_reorder)
+    void setReorderingEnabled(bool enabled) { mEnableReordering = enabled; }
+
+    reorder_stats const& getReorderStats() const { return mReorderStats; }
+
+    // skip transitions into the state a physical resource is already in from an earlier pass, off by default
+    // only valid if exec functions leave every graph resource in the state of its access mode (see exec_context)
+    void setBarrierEliminationEnabled(bool enabled) { mEnableBarrierElimination = enabled; }
+
+    // execution order of the passes after compile
+    cc::span<pass_idx const> getPassOrder() const { return {mPassOrder.data(), mPassOrder.size()}; }
+
+    // if the recorded graph has the same structure as at the last compile, reuse its results, on by default
+    // the structure covers pass names, queues, root flags, accesses with their modes and resource descriptions (not imported handles)
+    // and the compile options (aliasing, reordering, barrier elimination)
+    void setCompileReuseEnabled(bool enabled) { mEnableCompileReuse = enabled; }
+
+    bool wasCompileReused() const { return mLastCompileReused; }
+
+    memory_stats const& getMemoryStats() const { return mMemoryStats; }
+
+    barrier_stats const& getBarrierStats() const { return mBarrierStats; }
+
     // 4.
     size_t getNumPasses() const { return mPasses.size(); }
 
-    // execute a subrange of passes
+    // execute a subrange [start, end) of the pass order
     void executePasses(pr::raii::Frame* frame, size_t start, size_t end, pre::timestamp_bundle* timing = nullptr, int timer_offset = 0);
 
     // execute all passes
     void execute(pr::raii::Frame* frame, pre::timestamp_bundle* timing = nullptr, int timer_offset = 0);
 
+    // execute all passes on up to max_num_threads threads (0: hardware concurrency)
+    // the non-culled passes are split into contiguous ranges, each recorded into its own frame and submitted in graph order
+    // work recorded in other frames must be submitted before (or after) this call, exec functions must be safe to run concurrently
+    // the worker threads are started on first use and kept until destroy
+    // returns the amount of ranges
+    unsigned executeParallel(pr::Context& ctx, unsigned max_num_threads = 0, pre::timestamp_bundle* timing = nullptr, int timer_offset = 0);
+
+    // execute all passes, each batch of consecutive passes on the same queue (see setup_context::set_queue) into its own frame
+    // the frames are submitted to their queues, with fence waits where a batch depends on resources of another queue
+    // the first batch on each queue also waits for the last batch of every other queue in the previous executeScheduled,
+    // resources persist across executions (cached physicals, imports) and must not be accessed by two queues at once
+    void executeScheduled(pr::Context& ctx, pre::timestamp_bundle* timing = nullptr, int timer_offset = 0);
+
+    queue_schedule const& getQueueSchedule() const { return mQueueSchedule; }
+
+    // memory of the pass data and exec functions recorded since the last reset
+    pass_arena_stats const& getPassArenaStats() const { return mPassArena.get_stats(); }
+
+    // CPU timings of the ranges of the last executeParallel, empty after execute
+    cc::span<record_range_timing const> getRecordTimings() const { return {mRecordTimings.data(), mRecordTimings.size()}; }
+
     // after execute
     void performInfoImgui(pre::timestamp_bundle const* timing, bool* isWindowOpen = nullptr) const;
 
@@ -114,6 +200,11 @@ private:
         phi::arg::resource_description resource_info;
         pr::resource imported_resource;
 
+        // lifetime over non-culled passes as positions in the pass order, last_use of root resources extends past the last pass
+        pass_idx first_use = gc_invalid_pass;
+        pass_idx last_use = 0;
+        phi::resource_state last_state = phi::resource_state::undefined; // of the last access with a set mode
+
         virtual_resource(res_guid_t guid, phi::arg::resource_description const& info) : initial_guid(guid), resource_info(info) { }
 
         virtual_resource(res_guid_t guid, pr::resource import_resource, phi::arg::resource_description const& info)
@@ -163,7 +254,9 @@ private:
 
         char const* const debug_name;
         phi::queue_type queue = phi::queue_type::direct;
-        cc::unique_function<void(exec_context&)> execute_func;
+        // closure with the pass data, placed in mPassArena
+        void (*execute_func)(void const* closure, exec_context& exec_ctx) = nullptr;
+        void const* execute_closure = nullptr;
         bool is_root_pass = false;
         bool is_culled = false;
 
@@ -174,6 +267,8 @@ private:
         cc::capped_vector<pass_move, 16> moves;
 
         cc::capped_vector<phi::transition_info, 64> transitions_before;
+        cc::capped_vector<physical_res_idx, 64> transition_physicals; // parallel to transitions_before
+        unsigned num_released_transitions = 0; // the last ones in transitions_before, recorded by the direct queue in executeScheduled
 
         internal_pass(char const* name) : debug_name(name) {}
     };
@@ -198,11 +293,38 @@ private:
         auto const& state = getGuidState(resource);
         CC_ASSERT(state.is_valid() && "attempted to make invalid resource root");
         mVirtualResources[state.virtual_res].state |= virtual_resource::sb_root;
+        addToStructureHash(st_resource_root, resource);
     }
 
-    void makePassRoot(pass_idx pass) { mPasses[pass].is_root_pass = true; }
+    void makePassRoot(pass_idx pass)
+    {
+        mPasses[pass].is_root_pass = true;
+        addToStructureHash(st_pass_root, pass);
+    }
+
+    void setPassQueue(pass_idx pass, phi::queue_type type)
+    {
+        mPasses[pass].queue = type;
+        addToStructureHash(st_pass_queue, pass, uint64_t(type));
+    }
+
+    // operations recorded during setup, combined into mStructureHash
+    enum e_structure_tag : uint64_t
+    {
+        st_pass,
+        st_create,
+        st_import,
+        st_read,
+        st_write,
+        st_move,
+        st_resource_root,
+        st_pass_root,
+        st_pass_queue
+    };
+
+    void addToStructureHash(e_structure_tag tag, uint64_t a, uint64_t b = 0, uint64_t c = 0, uint64_t d = 0);
 
-    void setPassQueue(pass_idx pass, phi::queue_type type) { mPasses[pass].queue = type; }
+    static uint64_t hashPassName(char const* name);
 
     // execute-time API
 private:
@@ -220,10 +342,26 @@ private:
     void runFloodfillCulling(cc::allocator* alloc);
 
     // Step 2
-    void realizePhysicalResources(GraphCache& cache);
+    void calculatePassOrder(cc::allocator* alloc);
 
     // Step 3
-    void calculateBarriers();
+    void calculateLifetimes();
+
+    // Step 4
+    void realizePhysicalResources(GraphCache& cache, cc::allocator* alloc);
+
+    // Step 5
+    void calculateBarriers(cc::allocator* alloc);
+
+    // Step 6
+    void scheduleQueues(cc::allocator* alloc);
+
+    // skip_released: leave out the transitions recorded at the end of a direct batch (see scheduleQueues)
+    void executePass(pr::raii::Frame* frame, pass_idx pass, pre::timestamp_bundle* timing, int timer_offset, bool skip_released);
+
+    // compile results of a graph with unchanged structure, false if they can't be reused
+    bool restoreCompileResults(GraphCache& cache);
+    void storeCompileResults(GraphCache const& cache);
 
 private:
     virtual_res_idx addResource(pass_idx producer, res_guid_t guid, phi::arg::resource_description const& info);
@@ -231,6 +369,9 @@ private:
 
     guid_state& getGuidState(res_guid_t guid);
 
+    // reinserts all GUID states into a lookup table of the given size (power of two)
+    void rebuildGuidLookup(size_t table_size);
+
 private:
     tg::isize2 mMainTargetSize;
     unsigned mNumReadsTotal = 0;
@@ -240,11 +381,106 @@ private:
 
     // virtual resource logic
     cc::alloc_vector<guid_state> mGuidStates;
+    cc::alloc_vector<uint32_t> mGuidLookup; // open addressing (linear probing) from GUID to index into mGuidStates, at most half full
     cc::alloc_vector<virtual_resource> mVirtualResources;
 
     cc::alloc_vector<physical_resource> mPhysicalResources;
+
+    cc::allocator* mAllocator = nullptr;
+    bool mEnableAliasing = true;
+    bool mEnableReordering = false;
+    bool mEnableBarrierElimination = false;
+    cc::alloc_vector<pass_idx> mPassOrder;
+    reorder_stats mReorderStats;
+    memory_stats mMemoryStats;
+    barrier_stats mBarrierStats;
+    cc::alloc_vector<record_range_timing> mRecordTimings;
+    pass_arena mPassArena;
+    worker_pool mRecordPool; // threads of executeParallel, started on first use
+
+    struct batch_transition
+    {
+        uint32_t batch;
+        physical_res_idx physical; // of the transition, to patch imported handles when restoring compile results
+        phi::transition_info transition;
+    };
+
+    queue_schedule mQueueSchedule;
+    cc::alloc_vector<batch_transition> mReleaseTransitions; // recorded at the end of a direct batch, for a compute or copy batch
+
+    phi::Backend* mFenceBackend = nullptr;
+    phi::handle::fence mQueueFences[gc_num_queue_types] = {phi::handle::null_fence, phi::handle::null_fence, phi::handle::null_fence};
+    uint64_t mQueueFenceBases[gc_num_queue_types] = {}; // fence values of previous executions, serials are added to it
+    uint64_t mQueueFenceFinals[gc_num_queue_types] = {}; // value signaled by the last batch of each queue in previous executions, 0: none
+
+    // structure of the graph recorded since the last reset
+    uint64_t mStructureHash = 0;
+    bool mEnableCompileReuse = true;
+    bool mLastCompileReused = false;
+
+    struct compiled_virtual
+    {
+        bool is_culled;
+        physical_res_idx associated_physical;
+        pass_idx first_use;
+        pass_idx last_use;
+        phi::resource_state last_state;
+    };
+
+    struct compiled_physical
+    {
+        physical_resource physical;
+        uint64_t info_hash;           // of transient resources, to reacquire them from the cache
+        virtual_res_idx imported_res; // imported resources are taken from the current graph
+    };
+
+    struct compiled_transition
+    {
+        physical_res_idx physical;
+        phi::resource_state target_state;
+        phi::shader_stage_flags_t dependent_shaders;
+    };
+
+    struct compiled_release
+    {
+        uint32_t batch;
+        compiled_transition transition;
+    };
+
+    struct compile_results
+    {
+        bool is_valid = false;
+        uint64_t structure_hash = 0;
+        GraphCache const* cache = nullptr;
+
+        // options the results were compiled with, changing one requires a full compile
+        bool enable_aliasing = false;
+        bool enable_reordering = false;
+        bool enable_barrier_elimination = false;
+
+        cc::alloc_vector<pass_idx> pass_order;
+        cc::alloc_vector<uint8_t> passes_culled;
+        cc::alloc_vector<uint32_t> pass_transition_offsets; // the transitions of pass i are [offsets[i], offsets[i + 1])
+        cc::alloc_vector<compiled_transition> transitions;
+        cc::alloc_vector<uint32_t> pass_num_released; // internal_pass::num_released_transitions
+        cc::alloc_vector<compiled_virtual> virtuals;
+        cc::alloc_vector<compiled_physical> physicals;
+
+        // results of scheduleQueues, transitions above are stored after it moved the released ones to the end
+        queue_schedule schedule;
+        cc::alloc_vector<compiled_release> release_transitions;
+
+        memory_stats memory;
+        reorder_stats reorder;
+        barrier_stats barriers;
+    };
+
+    compile_results mLastCompile;
 };
 
+// passed to the setup function of a pass, declares its resource accesses
+// a set access mode is the state the graph transitions the resource to before the pass executes,
+// exec functions that leave a resource in another state must declare that (see exec_context)
 struct setup_context
 {
     res_handle create(res_guid_t guid, phi::arg::resource_description const& info, access_mode mode = {})
@@ -317,6 +553,10 @@ private:
     tg::isize2 const _backbuf_size;
 };
 
+// passed to the exec function of a pass
+// with barrier elimination (GraphBuilder::setBarrierEliminationEnabled), the transitions before a pass assume each
+// resource is in the state of its last declared access mode: exec functions that transition a graph resource
+// themselves must transition it back, or declare the state they leave it in as the access mode
 struct exec_context
 {
     physical_resource const& get(res_handle handle) const { return _parent->getPhysical(handle); }
@@ -350,13 +590,25 @@ pass_idx GraphBuilder::addPass(char const* debug_name, cc::function_ref<void(Pas
     internal_pass& new_pass = mPasses.emplace_back(debug_name);
 
     // immediately execute setup
+    addToStructureHash(st_pass, hashPassName(debug_name));
+
     PassDataT pass_data = {};
     setup_context setup_ctx = {new_pass_idx, this, mMainTargetSize};
     setup_func(pass_data, setup_ctx);
 
-    // capture pass_data per value, move user exec lambda into capture
-    new_pass.execute_func = cc::unique_function<void(exec_context&)>(
-        [pass_data, user_func = cc::move(exec_func)](exec_context& exec_ctx) { user_func(pass_data, exec_ctx); }, cc::system_allocator);
+    // move pass_data and the user exec lambda into the arena, destroyed in reset
+    struct pass_closure
+    {
+        PassDataT pass_data;
+        std::decay_t<ExecF> user_func;
+    };
+
+    new_pass.execute_closure = mPassArena.emplace<pass_closure>(cc::move(pass_data), std::forward<ExecF>(exec_func));
+    new_pass.execute_func = [](void const* closure, exec_context& exec_ctx)
+    {
+        auto const& typed_closure = *static_cast<pass_closure const*>(closure);
+        typed_closure.user_func(typed_closure.pass_data, exec_ctx);
+    };
 
     return new_pass_idx;
 }
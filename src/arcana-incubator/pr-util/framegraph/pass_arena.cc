@@ -0,0 +1,126 @@
+#include "pass_arena.hh"
+
+#include <cstdint>
+
+#include <clean-core/allocator.hh>
+#include <clean-core/assert.hh>
+#include <clean-core/utility.hh>
+
+namespace
+{
+size_t align_up(size_t value, size_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+}
+
+void inc::frag::pass_arena::initialize(cc::allocator* backing_alloc, size_t chunk_size_bytes)
+{
+    CC_ASSERT(_backing_alloc == nullptr && "double init");
+    CC_ASSERT(backing_alloc != nullptr && chunk_size_bytes > 0 && "invalid pass arena");
+
+    _backing_alloc = backing_alloc;
+    _chunk_size = chunk_size_bytes;
+    _stats = {};
+}
+
+void inc::frag::pass_arena::destroy()
+{
+    if (_backing_alloc == nullptr)
+        return;
+
+    reset();
+
+    for (chunk* c = _first_chunk; c != nullptr;)
+    {
+        chunk* const next = c->next;
+        _backing_alloc->free(c);
+        c = next;
+    }
+
+    _first_chunk = nullptr;
+    _current_chunk = nullptr;
+    _backing_alloc = nullptr;
+    _stats = {};
+}
+
+void* inc::frag::pass_arena::allocate(size_t size_bytes, size_t alignment)
+{
+    CC_ASSERT(_backing_alloc != nullptr && "pass_arena uninitialized");
+    CC_ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0 && "alignment must be a power of two");
+
+    ++_stats.num_allocations;
+
+    while (_current_chunk != nullptr)
+    {
+        size_t const offset = get_aligned_offset(_current_chunk, _current_offset, alignment);
+        if (offset + size_bytes <= _current_chunk->size_bytes)
+        {
+            _stats.bytes_used += offset + size_bytes - _current_offset;
+            _current_offset = offset + size_bytes;
+            return get_data(_current_chunk) + offset;
+        }
+
+        // the rest of this chunk stays unused, continue in the next one kept from previous frames
+        _stats.bytes_used += _current_chunk->size_bytes - _current_offset;
+        if (_current_chunk->next == nullptr)
+            break;
+
+        _current_chunk = _current_chunk->next;
+        _current_offset = 0;
+    }
+
+    // out of chunks, oversized allocations get a chunk of their own size
+    // the chunk data is only aligned to alignof(std::max_align_t), overaligned allocations reserve room to align within it
+    size_t const max_padding = alignment > alignof(std::max_align_t) ? alignment - 1 : 0;
+    size_t const data_size = cc::max(_chunk_size, size_bytes + max_padding);
+    auto* const new_chunk = reinterpret_cast<chunk*>(_backing_alloc->alloc(sizeof(chunk) + data_size, alignof(std::max_align_t)));
+    new_chunk->next = nullptr;
+    new_chunk->size_bytes = data_size;
+
+    if (_current_chunk != nullptr)
+        _current_chunk->next = new_chunk;
+    else
+        _first_chunk = new_chunk;
+
+    size_t const offset = get_aligned_offset(new_chunk, 0, alignment);
+    CC_ASSERT(offset + size_bytes <= data_size);
+
+    _current_chunk = new_chunk;
+    _current_offset = offset + size_bytes;
+
+    ++_stats.num_backing_allocations;
+    _stats.bytes_used += offset + size_bytes;
+    _stats.bytes_reserved += data_size;
+    return get_data(new_chunk) + offset;
+}
+
+size_t inc::frag::pass_arena::get_aligned_offset(chunk* c, size_t offset, size_t alignment)
+{
+    // aligns the address, not the offset, the chunk data itself might be less aligned
+    auto const data_address = reinterpret_cast<uintptr_t>(get_data(c));
+    return align_up(data_address + offset, alignment) - data_address;
+}
+
+void inc::frag::pass_arena::reset()
+{
+    for (destructor_node* node = _destructors; node != nullptr; node = node->next)
+        node->func(node->object);
+
+    _destructors = nullptr;
+    _current_chunk = _first_chunk;
+    _current_offset = 0;
+
+    _stats.num_allocations = 0;
+    _stats.num_backing_allocations = 0;
+    _stats.bytes_used = 0;
+}
+
+void inc::frag::pass_arena::register_destructor(void* object, void (*func)(void*))
+{
+    // the node lives in the arena as well, it is only read during reset
+    auto* const node = static_cast<destructor_node*>(allocate(sizeof(destructor_node), alignof(destructor_node)));
+    node->func = func;
+    node->object = object;
+    node->next = _destructors;
+    _destructors = node;
+
+    --_stats.num_allocations; // bookkeeping, not a placed object
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <clean-core/fwd.hh>
+
+namespace inc::frag
+{
+struct pass_arena_stats
+{
+    size_t num_allocations = 0;         // objects placed since the last reset
+    size_t num_backing_allocations = 0; // chunks allocated since the last reset, zero in steady state
+    size_t bytes_used = 0;              // since the last reset, including alignment padding
+    size_t bytes_reserved = 0;          // of all chunks
+};
+
+// linear memory for the pass data and closures of one recorded frame
+// chunks are kept across resets, once the largest frame was recorded no further allocations happen
+// objects are never destroyed individually, non-trivial destructors run in bulk (in reverse order) on reset
+// any power of two alignment is supported, overaligned objects can waste up to their alignment in padding
+struct pass_arena
+{
+public:
+    pass_arena() = default;
+    pass_arena(pass_arena const&) = delete;
+    pass_arena(pass_arena&&) = delete;
+    pass_arena& operator=(pass_arena const&) = delete;
+    pass_arena& operator=(pass_arena&&) = delete;
+    ~pass_arena() { destroy(); }
+
+    void initialize(cc::allocator* backing_alloc, size_t chunk_size_bytes);
+    void destroy();
+
+    [[nodiscard]] void* allocate(size_t size_bytes, size_t alignment);
+
+    template <class T, class... Args>
+    T* emplace(Args&&... args)
+    {
+        void* const mem = allocate(sizeof(T), alignof(T));
+        T* const res = new (mem) T{std::forward<Args>(args)...};
+
+        if constexpr (!std::is_trivially_destructible_v<T>)
+            register_destructor(res, [](void* obj) { static_cast<T*>(obj)->~T(); });
+
+        return res;
+    }
+
+    // runs the destructors and rewinds to the first chunk
+    void reset();
+
+    pass_arena_stats const& get_stats() const { return _stats; }
+
+private:
+    struct chunk
+    {
+        chunk* next;
+        size_t size_bytes; // usable, following the header
+    };
+
+    struct destructor_node
+    {
+        void (*func)(void*);
+        void* object;
+        destructor_node* next;
+    };
+
+    void register_destructor(void* object, void (*func)(void*));
+
+    // the usable memory of a chunk directly follows its header
+    static std::byte* get_data(chunk* c) { return reinterpret_cast<std::byte*>(c + 1); }
+
+    // smallest offset at or after the given one with an address of the given alignment
+    static size_t get_aligned_offset(chunk* c, size_t offset, size_t alignment);
+
+private:
+    cc::allocator* _backing_alloc = nullptr;
+    size_t _chunk_size = 0;
+
+    chunk* _first_chunk = nullptr;
+    chunk* _current_chunk = nullptr;
+    size_t _current_offset = 0; // into the current chunk
+
+    destructor_node* _destructors = nullptr; // most recent first
+
+    pass_arena_stats _stats;
+};
+}
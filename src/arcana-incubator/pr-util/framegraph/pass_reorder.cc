@@ -0,0 +1,262 @@
+#include "pass_reorder.hh"
+
+#include <clean-core/alloc_vector.hh>
+#include <clean-core/assert.hh>
+#include <clean-core/utility.hh>
+
+namespace
+{
+using inc::frag::pass_idx;
+
+constexpr pass_idx gc_no_pass = pass_idx(-1);
+
+// the accesses of pass i are [offsets[i], offsets[i + 1])
+cc::alloc_vector<unsigned> build_access_offsets(cc::span<inc::frag::reorder_access const> accesses, size_t num_passes, cc::allocator* alloc)
+{
+    auto offsets = cc::alloc_vector<unsigned>::filled(num_passes + 1, 0, alloc);
+    for (auto const& access : accesses)
+        ++offsets[access.pass + 1];
+
+    for (auto i = 0u; i < num_passes; ++i)
+        offsets[i + 1] += offsets[i];
+
+    return offsets;
+}
+
+unsigned count_transitions(cc::span<inc::frag::reorder_access const> accesses, cc::span<unsigned const> access_offsets, cc::span<phi::resource_state> states, pass_idx pass)
+{
+    unsigned res = 0;
+    for (auto i = access_offsets[pass]; i < access_offsets[pass + 1]; ++i)
+    {
+        auto const& access = accesses[i];
+        if (access.required_state != phi::resource_state::undefined && states[access.resource] != access.required_state)
+            ++res;
+    }
+    return res;
+}
+
+void apply_states(cc::span<inc::frag::reorder_access const> accesses, cc::span<unsigned const> access_offsets, cc::span<phi::resource_state> states, pass_idx pass)
+{
+    for (auto i = access_offsets[pass]; i < access_offsets[pass + 1]; ++i)
+    {
+        auto const& access = accesses[i];
+        if (access.required_state != phi::resource_state::undefined)
+            states[access.resource] = access.required_state;
+    }
+}
+}
+
+void inc::frag::run_pass_reorder(cc::span<inc::frag::pass_idx> out_order,
+                                 inc::frag::reorder_stats& out_stats,
+                                 cc::span<const phi::queue_type> pass_queues,
+                                 cc::span<const bool> pass_culled,
+                                 cc::span<const inc::frag::reorder_access> accesses,
+                                 size_t num_resources,
+                                 cc::allocator* alloc)
+{
+    size_t const num_passes = pass_queues.size();
+    CC_ASSERT(pass_culled.size() == num_passes && out_order.size() == num_passes && "pass spans differ in size");
+
+    out_stats = {};
+
+    auto const access_offsets = build_access_offsets(accesses, num_passes, alloc);
+    cc::span<unsigned const> const offsets = {access_offsets.data(), access_offsets.size()};
+
+    // phase one - dependency edges, from the producer to the consumer
+    struct edge
+    {
+        pass_idx from;
+        pass_idx to;
+    };
+
+    cc::alloc_vector<edge> edges(alloc);
+    edges.reserve(accesses.size() * 2);
+
+    {
+        // the reads since the last write of each resource, as singly linked lists
+        struct read_node
+        {
+            pass_idx pass;
+            unsigned next;
+        };
+
+        constexpr unsigned no_node = unsigned(-1);
+
+        auto last_writes = cc::alloc_vector<pass_idx>::filled(num_resources, gc_no_pass, alloc);
+        auto read_heads = cc::alloc_vector<unsigned>::filled(num_resources, no_node, alloc);
+        cc::alloc_vector<read_node> read_nodes(alloc);
+        read_nodes.reserve(accesses.size());
+
+        pass_idx prev_pass = 0;
+        for (auto const& access : accesses)
+        {
+            CC_ASSERT(access.pass >= prev_pass && "accesses must be in registration order");
+            prev_pass = access.pass;
+
+            if (pass_culled[access.pass])
+                continue;
+
+            pass_idx& last_write = last_writes[access.resource];
+            unsigned& read_head = read_heads[access.resource];
+
+            if (last_write != gc_no_pass && last_write != access.pass)
+                edges.push_back({last_write, access.pass});
+
+            if (access.is_write)
+            {
+                for (auto node = read_head; node != no_node; node = read_nodes[node].next)
+                {
+                    if (read_nodes[node].pass != access.pass)
+                        edges.push_back({read_nodes[node].pass, access.pass});
+                }
+
+                read_head = no_node;
+                last_write = access.pass;
+            }
+            else
+            {
+                read_nodes.push_back({access.pass, read_head});
+                read_head = unsigned(read_nodes.size() - 1);
+            }
+        }
+    }
+
+    // successors bucketed by producer (CSR)
+    auto successor_offsets = cc::alloc_vector<unsigned>::filled(num_passes + 1, 0, alloc);
+    auto successors = cc::alloc_vector<pass_idx>::uninitialized(edges.size(), alloc);
+    auto num_unscheduled_preds = cc::alloc_vector<unsigned>::filled(num_passes, 0, alloc);
+    {
+        for (auto const& e : edges)
+        {
+            ++successor_offsets[e.from + 1];
+            ++num_unscheduled_preds[e.to];
+        }
+
+        for (auto i = 0u; i < num_passes; ++i)
+            successor_offsets[i + 1] += successor_offsets[i];
+
+        auto cursors = cc::alloc_vector<unsigned>::uninitialized(num_passes, alloc);
+        for (auto i = 0u; i < num_passes; ++i)
+            cursors[i] = successor_offsets[i];
+
+        for (auto const& e : edges)
+            successors[cursors[e.from]++] = e.to;
+    }
+
+    // phase two - list scheduling
+    auto states = cc::alloc_vector<phi::resource_state>::filled(num_resources, phi::resource_state::undefined, alloc);
+    cc::span<phi::resource_state> const state_span = {states.data(), states.size()};
+
+    // position of the latest scheduled producer of each pass, +1 (0: none)
+    auto latest_producer = cc::alloc_vector<unsigned>::filled(num_passes, 0, alloc);
+
+    cc::alloc_vector<pass_idx> ready(alloc);
+    ready.reserve(num_passes);
+    for (pass_idx i = 0; i < num_passes; ++i)
+    {
+        if (!pass_culled[i] && num_unscheduled_preds[i] == 0)
+            ready.push_back(i);
+    }
+
+    unsigned num_scheduled = 0;
+    bool has_prev_queue = false;
+    phi::queue_type prev_queue = phi::queue_type::direct;
+
+    while (!ready.empty())
+    {
+        size_t best_ready_idx = 0;
+        unsigned best_transitions = 0;
+        bool best_switches_queue = false;
+
+        for (auto r = 0u; r < ready.size(); ++r)
+        {
+            pass_idx const candidate = ready[r];
+            unsigned const transitions = count_transitions(accesses, offsets, state_span, candidate);
+            bool const switches_queue = has_prev_queue && pass_queues[candidate] != prev_queue;
+
+            if (r > 0)
+            {
+                pass_idx const best = ready[best_ready_idx];
+
+                bool is_better;
+                if (transitions != best_transitions)
+                    is_better = transitions < best_transitions;
+                else if (switches_queue != best_switches_queue)
+                    is_better = !switches_queue;
+                else if (latest_producer[candidate] != latest_producer[best])
+                    is_better = latest_producer[candidate] < latest_producer[best];
+                else
+                    is_better = candidate < best;
+
+                if (!is_better)
+                    continue;
+            }
+
+            best_ready_idx = r;
+            best_transitions = transitions;
+            best_switches_queue = switches_queue;
+        }
+
+        pass_idx const pass = ready[best_ready_idx];
+        ready[best_ready_idx] = ready.back();
+        ready.pop_back();
+
+        apply_states(accesses, offsets, state_span, pass);
+        has_prev_queue = true;
+        prev_queue = pass_queues[pass];
+
+        out_order[num_scheduled] = pass;
+        ++num_scheduled;
+
+        for (auto s = successor_offsets[pass]; s < successor_offsets[pass + 1]; ++s)
+        {
+            pass_idx const successor = successors[s];
+            latest_producer[successor] = cc::max(latest_producer[successor], num_scheduled);
+
+            if (--num_unscheduled_preds[successor] == 0)
+                ready.push_back(successor);
+        }
+    }
+
+    for (pass_idx i = 0; i < num_passes; ++i)
+    {
+        if (pass_culled[i])
+            out_order[num_scheduled++] = i;
+    }
+
+    CC_ASSERT(num_scheduled == num_passes && "dependency cycle between passes");
+
+    // phase three - stats, the registration order against the new one
+    auto f_simulate = [&](auto&& f_get_pass, unsigned& out_transitions, unsigned& out_queue_switches)
+    {
+        for (auto& state : states)
+            state = phi::resource_state::undefined;
+
+        bool has_prev = false;
+        phi::queue_type prev = phi::queue_type::direct;
+        for (pass_idx i = 0; i < num_passes; ++i)
+        {
+            pass_idx const pass = f_get_pass(i);
+            if (pass_culled[pass])
+                continue;
+
+            out_transitions += count_transitions(accesses, offsets, state_span, pass);
+            apply_states(accesses, offsets, state_span, pass);
+
+            if (has_prev && pass_queues[pass] != prev)
+                ++out_queue_switches;
+
+            has_prev = true;
+            prev = pass_queues[pass];
+        }
+    };
+
+    f_simulate([](pass_idx i) { return i; }, out_stats.num_transitions_before, out_stats.num_queue_switches_before);
+    f_simulate([&](pass_idx i) { return out_order[i]; }, out_stats.num_transitions_after, out_stats.num_queue_switches_after);
+
+    for (pass_idx i = 0; i < num_passes; ++i)
+    {
+        if (out_order[i] != i)
+            ++out_stats.num_moved;
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <clean-core/fwd.hh>
+#include <clean-core/span.hh>
+
+#include <phantasm-hardware-interface/types.hh>
+
+#include "types.hh"
+
+namespace inc::frag
+{
+// a pass accessing a virtual resource, in registration order
+struct reorder_access
+{
+    pass_idx pass;
+    virtual_res_idx resource;
+    bool is_write;                     // creates, writes, imports and moves
+    phi::resource_state required_state; // undefined if the access requests no state
+};
+
+struct reorder_stats
+{
+    // estimated from the requested states of virtual resources, physical aliasing is not known yet
+    unsigned num_transitions_before = 0;
+    unsigned num_transitions_after = 0;
+
+    unsigned num_queue_switches_before = 0; // between consecutive non-culled passes
+    unsigned num_queue_switches_after = 0;
+
+    unsigned num_moved = 0; // passes at a different position than in registration order
+};
+
+// topological sort of the non-culled passes along their dependencies (read after write, write after read, write after write)
+// list scheduling, of all passes with satisfied dependencies the next one is picked by, in this order:
+//   - fewest state transitions given the states the resources are in at that point
+//   - same queue as the previous pass
+//   - producers scheduled longest ago, to increase the distance between producers and consumers
+//   - lowest registration index, keeping the result deterministic
+// culled passes are placed at the end in registration order
+void run_pass_reorder(cc::span<pass_idx> out_order,
+                      reorder_stats& out_stats,
+                      cc::span<phi::queue_type const> pass_queues,
+                      cc::span<bool const> pass_culled,
+                      cc::span<reorder_access const> accesses,
+                      size_t num_resources,
+                      cc::allocator* alloc = cc::system_allocator);
+}
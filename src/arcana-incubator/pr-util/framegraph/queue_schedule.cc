@@ -0,0 +1,213 @@
+#include "queue_schedule.hh"
+
+#include <clean-core/assert.hh>
+#include <clean-core/utility.hh>
+
+namespace
+{
+using inc::frag::gc_num_queue_types;
+
+constexpr uint32_t gc_invalid_batch = uint32_t(-1);
+
+unsigned queue_index(phi::queue_type queue)
+{
+    CC_ASSERT(unsigned(queue) < gc_num_queue_types && "unknown queue type");
+    return unsigned(queue);
+}
+
+// latest serial of each queue known to be complete
+struct vector_clock
+{
+    uint64_t serials[gc_num_queue_types] = {};
+};
+
+struct resource_history
+{
+    uint32_t last_write_batch = gc_invalid_batch;
+    uint32_t last_read_batches[gc_num_queue_types] = {gc_invalid_batch, gc_invalid_batch, gc_invalid_batch}; // since the last write
+    uint32_t last_access_batch = gc_invalid_batch;
+};
+}
+
+void inc::frag::queue_schedule::reset_reserve(cc::allocator* alloc, size_t num_passes)
+{
+    batches.reset_reserve(alloc, num_passes);
+    passes.reset_reserve(alloc, num_passes);
+    handoffs.reset_reserve(alloc, num_passes);
+    num_dependencies = 0;
+    num_waits = 0;
+}
+
+void inc::frag::queue_schedule::clear()
+{
+    batches.clear();
+    passes.clear();
+    handoffs.clear();
+    num_dependencies = 0;
+    num_waits = 0;
+}
+
+void inc::frag::queue_schedule::assign(const inc::frag::queue_schedule& other)
+{
+    clear();
+    for (auto const& batch : other.batches)
+        batches.push_back(batch);
+    for (auto const pass : other.passes)
+        passes.push_back(pass);
+    for (auto const& handoff : other.handoffs)
+        handoffs.push_back(handoff);
+    num_dependencies = other.num_dependencies;
+    num_waits = other.num_waits;
+}
+
+void inc::frag::run_queue_schedule(inc::frag::queue_schedule& out,
+                                   cc::span<const phi::queue_type> pass_queues,
+                                   cc::span<const bool> pass_culled,
+                                   cc::span<const inc::frag::schedule_access> accesses,
+                                   size_t num_physicals,
+                                   cc::allocator* alloc)
+{
+    CC_ASSERT(pass_queues.size() == pass_culled.size() && "pass spans differ in size");
+    out.clear();
+
+    // phase one - batches of consecutive passes on the same queue
+    auto pass_batches = cc::alloc_vector<uint32_t>::filled(pass_queues.size(), gc_invalid_batch, alloc);
+    cc::alloc_vector<uint32_t> queue_batches[gc_num_queue_types] = {cc::alloc_vector<uint32_t>(alloc), cc::alloc_vector<uint32_t>(alloc),
+                                                                     cc::alloc_vector<uint32_t>(alloc)};
+
+    for (pass_idx i = 0; i < pass_queues.size(); ++i)
+    {
+        if (pass_culled[i])
+            continue;
+
+        auto const queue = pass_queues[i];
+        if (out.batches.empty() || out.batches.back().queue != queue)
+        {
+            auto& batch_indices = queue_batches[queue_index(queue)];
+
+            queue_batch batch;
+            batch.queue = queue;
+            batch.passes_start = uint32_t(out.passes.size());
+            batch.serial = batch_indices.size() + 1;
+
+            batch_indices.push_back(uint32_t(out.batches.size()));
+            out.batches.push_back(batch);
+        }
+
+        out.passes.push_back(i);
+        out.batches.back().passes_end = uint32_t(out.passes.size());
+        pass_batches[i] = uint32_t(out.batches.size() - 1);
+    }
+
+    // phase two - latest serial each batch depends on per other queue
+    // writes depend on the last write and all reads since, reads only on the last write
+    auto required = cc::alloc_vector<vector_clock>::filled(out.batches.size(), vector_clock{}, alloc);
+    auto histories = cc::alloc_vector<resource_history>::filled(num_physicals, resource_history{}, alloc);
+
+    auto f_depend = [&](uint32_t batch_idx, uint32_t dependency_idx)
+    {
+        if (dependency_idx == gc_invalid_batch)
+            return;
+
+        queue_batch const& dependency = out.batches[dependency_idx];
+        if (dependency.queue == out.batches[batch_idx].queue)
+            return; // ordered by the queue itself
+
+        uint64_t& serial = required[batch_idx].serials[queue_index(dependency.queue)];
+        serial = cc::max(serial, dependency.serial);
+        ++out.num_dependencies;
+    };
+
+    for (schedule_access const& access : accesses)
+    {
+        uint32_t const batch_idx = pass_batches[access.pass];
+        if (batch_idx == gc_invalid_batch)
+            continue;
+
+        resource_history& history = histories[access.physical];
+        auto const queue = out.batches[batch_idx].queue;
+
+        if (history.last_access_batch != gc_invalid_batch && out.batches[history.last_access_batch].queue != queue)
+            out.handoffs.push_back({access.physical, history.last_access_batch, batch_idx, access.pass});
+
+        f_depend(batch_idx, history.last_write_batch);
+
+        if (access.is_write)
+        {
+            for (auto& read_batch : history.last_read_batches)
+            {
+                f_depend(batch_idx, read_batch);
+                read_batch = gc_invalid_batch;
+            }
+
+            history.last_write_batch = batch_idx;
+        }
+        else
+        {
+            // accesses are in pass order, this is the latest read on the queue
+            history.last_read_batches[queue_index(queue)] = batch_idx;
+        }
+
+        history.last_access_batch = batch_idx;
+    }
+
+    // phase three - minimal waits, in batch order
+    // a dependency is dropped if the queue order or the clock of another waited-for batch already covers it
+    auto clocks = cc::alloc_vector<vector_clock>::filled(out.batches.size(), vector_clock{}, alloc);
+    uint32_t prev_batches[gc_num_queue_types] = {gc_invalid_batch, gc_invalid_batch, gc_invalid_batch};
+
+    for (uint32_t b = 0; b < out.batches.size(); ++b)
+    {
+        queue_batch& batch = out.batches[b];
+        unsigned const qi = queue_index(batch.queue);
+
+        vector_clock clock = prev_batches[qi] != gc_invalid_batch ? clocks[prev_batches[qi]] : vector_clock{};
+        clock.serials[qi] = batch.serial - 1;
+
+        vector_clock req = required[b];
+        for (auto q = 0u; q < gc_num_queue_types; ++q)
+        {
+            if (q == qi || req.serials[q] <= clock.serials[q])
+                req.serials[q] = 0;
+        }
+
+        auto f_get_batch = [&](unsigned q, uint64_t serial) { return queue_batches[q][serial - 1]; };
+
+        for (auto q = 0u; q < gc_num_queue_types; ++q)
+        {
+            if (req.serials[q] == 0)
+                continue;
+
+            bool is_implied = false;
+            for (auto other_q = 0u; other_q < gc_num_queue_types; ++other_q)
+            {
+                if (other_q != q && req.serials[other_q] > 0 && clocks[f_get_batch(other_q, req.serials[other_q])].serials[q] >= req.serials[q])
+                    is_implied = true;
+            }
+
+            if (!is_implied)
+            {
+                batch.wait_serials[q] = req.serials[q];
+                ++out.num_waits;
+            }
+        }
+
+        // completing the waited-for batches implies everything they waited for
+        for (auto q = 0u; q < gc_num_queue_types; ++q)
+        {
+            if (batch.wait_serials[q] == 0)
+                continue;
+
+            uint32_t const waited_idx = f_get_batch(q, batch.wait_serials[q]);
+            out.batches[waited_idx].needs_signal = true;
+
+            for (auto i = 0u; i < gc_num_queue_types; ++i)
+                clock.serials[i] = cc::max(clock.serials[i], clocks[waited_idx].serials[i]);
+
+            clock.serials[q] = cc::max(clock.serials[q], batch.wait_serials[q]);
+        }
+
+        clocks[b] = clock;
+        prev_batches[qi] = b;
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <clean-core/alloc_vector.hh>
+#include <clean-core/fwd.hh>
+#include <clean-core/span.hh>
+
+#include <phantasm-hardware-interface/types.hh>
+
+#include "types.hh"
+
+namespace inc::frag
+{
+inline constexpr unsigned gc_num_queue_types = 3; // indexed by phi::queue_type
+
+// a pass accessing a physical resource, in pass order
+struct schedule_access
+{
+    pass_idx pass;
+    physical_res_idx physical;
+    bool is_write; // writes the resource or changes its state (transitions)
+};
+
+// consecutive passes on the same queue, recorded into one command list
+struct queue_batch
+{
+    phi::queue_type queue = phi::queue_type::direct;
+    uint32_t passes_start = 0; // into queue_schedule::passes
+    uint32_t passes_end = 0;
+    uint64_t serial = 0;         // 1-based position among the batches of its queue, the value it signals
+    bool needs_signal = false;   // a batch on another queue waits for it
+    uint64_t wait_serials[gc_num_queue_types] = {}; // serial to wait for on each other queue before executing, 0: none
+};
+
+// a resource accessed on a different queue than in its previous access
+struct queue_handoff
+{
+    physical_res_idx physical;
+    uint32_t src_batch;
+    uint32_t dest_batch;
+    pass_idx dest_pass;
+};
+
+struct queue_schedule
+{
+    cc::alloc_vector<queue_batch> batches;
+    cc::alloc_vector<pass_idx> passes; // non-culled passes of all batches
+    cc::alloc_vector<queue_handoff> handoffs;
+
+    unsigned num_dependencies = 0; // on batches of other queues
+    unsigned num_waits = 0;        // after removing the dependencies already covered by queue order or other waits
+
+    void reset_reserve(cc::allocator* alloc, size_t num_passes);
+    void clear();
+
+    // copies the contents, keeps the own allocations
+    void assign(queue_schedule const& other);
+};
+
+// splits the non-culled passes into batches of consecutive passes on the same queue
+// and computes the fence waits between queues needed by the accesses, each batch waits at most once per other queue
+// completion knowledge is tracked per batch as a vector clock (latest serial of each queue known to be complete)
+void run_queue_schedule(queue_schedule& out,
+                        cc::span<phi::queue_type const> pass_queues,
+                        cc::span<bool const> pass_culled,
+                        cc::span<schedule_access const> accesses,
+                        size_t num_physicals,
+                        cc::allocator* alloc = cc::system_allocator);
+}
@@ -3,6 +3,235 @@
 #include <phantasm-renderer/Context.hh>
 
 #include <phantasm-hardware-interface/common/hash.hh>
+#include <phantasm-hardware-interface/util.hh>
+
+size_t inc::frag::get_resource_size_bytes(phi::arg::resource_description const& desc)
+{
+    if (desc.type == phi::arg::resource_description::e_resource_buffer)
+        return desc.info_buffer.size_bytes;
+
+    auto const& tex = desc.info_texture;
+    int const num_mips = tex.num_mips > 0 ? int(tex.num_mips) : phi::util::get_num_mips(tex.width, tex.height);
+    auto const size_bytes = phi::util::get_texture_size_bytes({tex.width, tex.height, int(tex.depth_or_array_size)}, tex.fmt, num_mips, false);
+    return size_t(size_bytes) * cc::max(1u, unsigned(tex.num_samples));
+}
+
+void inc::frag::resource_cache::reserve(size_t num_elems)
+{
+    _entries.reserve(num_elems);
+
+    size_t num_buckets = 16;
+    while (num_buckets < num_elems)
+        num_buckets *= 2;
+
+    if (num_buckets > _buckets.size())
+        rebuild_buckets(num_buckets);
+}
+
+pr::resource inc::frag::resource_cache::acquire(uint64_t key)
+{
+    if (!_buckets.empty())
+    {
+        for (auto idx = _buckets[get_bucket(key)]; idx != invalid_entry; idx = _entries[idx].bucket_next)
+        {
+            entry& e = _entries[idx];
+            if (e.key == key && e.used_frame < _current_frame)
+            {
+                e.used_frame = _current_frame;
+                lru_unlink(idx);
+                lru_push_back(idx);
+
+                ++_stats.num_hits;
+                return e.value;
+            }
+        }
+    }
+
+    ++_stats.num_misses;
+    return {phi::handle::null_resource};
+}
+
+bool inc::frag::resource_cache::reacquire(uint64_t key, pr::resource val)
+{
+    if (_buckets.empty())
+        return false;
+
+    for (auto idx = _buckets[get_bucket(key)]; idx != invalid_entry; idx = _entries[idx].bucket_next)
+    {
+        entry& e = _entries[idx];
+        if (e.key == key && e.value.handle == val.handle && e.used_frame < _current_frame)
+        {
+            e.used_frame = _current_frame;
+            lru_unlink(idx);
+            lru_push_back(idx);
+
+            ++_stats.num_hits;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool inc::frag::resource_cache::can_reacquire(uint64_t key, pr::resource val) const
+{
+    if (_buckets.empty())
+        return false;
+
+    for (auto idx = _buckets[get_bucket(key)]; idx != invalid_entry; idx = _entries[idx].bucket_next)
+    {
+        entry const& e = _entries[idx];
+        if (e.key == key && e.value.handle == val.handle && e.used_frame < _current_frame)
+            return true;
+    }
+
+    return false;
+}
+
+void inc::frag::resource_cache::add_elem(uint64_t key, pr::resource val, size_t size_bytes)
+{
+    // at most one element per bucket on average
+    if (_stats.num_resident + 1 > _buckets.size())
+        rebuild_buckets(cc::max<size_t>(16, 2 * _buckets.size()));
+
+    uint32_t idx;
+    if (_free_head != invalid_entry)
+    {
+        idx = _free_head;
+        _free_head = _entries[idx].bucket_next;
+    }
+    else
+    {
+        idx = uint32_t(_entries.size());
+        _entries.emplace_back();
+    }
+
+    entry& e = _entries[idx];
+    e.key = key;
+    e.used_frame = _current_frame;
+    e.value = val;
+    e.size_bytes = size_bytes;
+
+    size_t const bucket = get_bucket(key);
+    e.bucket_next = _buckets[bucket];
+    _buckets[bucket] = idx;
+
+    lru_push_back(idx);
+
+    ++_stats.num_resident;
+    _stats.resident_bytes += size_bytes;
+}
+
+void inc::frag::resource_cache::evict(unsigned max_unused_frames, size_t budget_bytes, cc::function_ref<void(pr::resource)> free_func)
+{
+    // the LRU list is ordered by used_frame, stop at the first element that must stay
+    while (_lru_head != invalid_entry)
+    {
+        auto const idx = _lru_head;
+        entry const& e = _entries[idx];
+
+        bool const is_recently_used = e.used_frame + 1 >= _current_frame;
+        bool const is_expired = e.used_frame + max_unused_frames < _current_frame;
+        bool const is_over_budget = budget_bytes > 0 && _stats.resident_bytes > budget_bytes;
+
+        if (is_recently_used || (!is_expired && !is_over_budget))
+            break;
+
+        free_func(e.value);
+        remove(idx);
+        ++_stats.num_evictions;
+    }
+}
+
+void inc::frag::resource_cache::for_each(cc::function_ref<void(pr::resource)> func) const
+{
+    for (auto idx = _lru_head; idx != invalid_entry; idx = _entries[idx].lru_next)
+        func(_entries[idx].value);
+}
+
+void inc::frag::resource_cache::reset()
+{
+    _entries.clear();
+    for (auto& bucket : _buckets)
+        bucket = invalid_entry;
+
+    _free_head = invalid_entry;
+    _lru_head = invalid_entry;
+    _lru_tail = invalid_entry;
+
+    _stats.num_resident = 0;
+    _stats.resident_bytes = 0;
+}
+
+void inc::frag::resource_cache::lru_unlink(uint32_t idx)
+{
+    entry& e = _entries[idx];
+
+    if (e.lru_prev != invalid_entry)
+        _entries[e.lru_prev].lru_next = e.lru_next;
+    else
+        _lru_head = e.lru_next;
+
+    if (e.lru_next != invalid_entry)
+        _entries[e.lru_next].lru_prev = e.lru_prev;
+    else
+        _lru_tail = e.lru_prev;
+}
+
+void inc::frag::resource_cache::lru_push_back(uint32_t idx)
+{
+    entry& e = _entries[idx];
+    e.lru_prev = _lru_tail;
+    e.lru_next = invalid_entry;
+
+    if (_lru_tail != invalid_entry)
+        _entries[_lru_tail].lru_next = idx;
+    else
+        _lru_head = idx;
+
+    _lru_tail = idx;
+}
+
+void inc::frag::resource_cache::remove(uint32_t idx)
+{
+    entry& e = _entries[idx];
+
+    // unlink from the bucket
+    uint32_t* link = &_buckets[get_bucket(e.key)];
+    while (*link != idx)
+        link = &_entries[*link].bucket_next;
+    *link = e.bucket_next;
+
+    lru_unlink(idx);
+
+    --_stats.num_resident;
+    _stats.resident_bytes -= e.size_bytes;
+
+    e.value = {phi::handle::null_resource};
+    e.bucket_next = _free_head;
+    _free_head = idx;
+}
+
+void inc::frag::resource_cache::rebuild_buckets(size_t num_buckets)
+{
+    _buckets.resize(num_buckets);
+    for (auto& bucket : _buckets)
+        bucket = invalid_entry;
+
+    // only live entries are in the LRU list
+    for (auto idx = _lru_head; idx != invalid_entry; idx = _entries[idx].lru_next)
+    {
+        size_t const bucket = get_bucket(_entries[idx].key);
+        _entries[idx].bucket_next = _buckets[bucket];
+        _buckets[bucket] = idx;
+    }
+}
+
+void inc::frag::GraphCache::onNewFrame()
+{
+    _cache.on_new_frame();
+    _cache.evict(_max_unused_frames, _budget_bytes, [&](pr::resource res) { _backend->free_deferred(res); });
+}
 
 pr::resource inc::frag::GraphCache::get(pr::generic_resource_info const& info, const char* debug_name)
 {
@@ -12,17 +241,14 @@ pr::resource inc::frag::GraphCache::get(pr::generic_resource_info const& info, c
         return lookup;
 
     auto const res = _backend->make_untyped_unlocked(info, debug_name);
-    _cache.add_elem(hash, res);
+    _cache.add_elem(hash, res, get_resource_size_bytes(info));
     return res;
 }
 
 uint32_t inc::frag::GraphCache::freeAll()
 {
-    auto const res = (uint32_t)_cache._values.size();
-    for (auto const& val : _cache._values)
-    {
-        _backend->free_deferred(val);
-    }
+    auto const res = uint32_t(_cache.get_stats().num_resident);
+    _cache.for_each([&](pr::resource val) { _backend->free_deferred(val); });
 
     _cache.reset();
     return res;
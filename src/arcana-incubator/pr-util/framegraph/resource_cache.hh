@@ -1,5 +1,6 @@
 #pragma once
 
+#include <clean-core/function_ref.hh>
 #include <clean-core/vector.hh>
 
 #include <phantasm-renderer/common/hashable_storage.hh>
@@ -7,52 +8,80 @@
 
 namespace inc::frag
 {
-// key-value relation 1:1
+// estimate of the memory a resource occupies, without placement alignment
+[[nodiscard]] size_t get_resource_size_bytes(phi::arg::resource_description const& desc);
+
+struct resource_cache_stats
+{
+    size_t num_hits = 0;
+    size_t num_misses = 0;
+    size_t num_evictions = 0;
+    size_t num_resident = 0;
+    size_t resident_bytes = 0; // estimated, see get_resource_size_bytes
+};
+
+// key-value relation 1:N
+// hash buckets of the keys and a least recently used list over all elements
 struct resource_cache
 {
 public:
-    void reserve(size_t num_elems)
-    {
-        _hashes.reserve(num_elems);
-        _values.reserve(num_elems);
-    }
+    void reserve(size_t num_elems);
 
-    [[nodiscard]] pr::resource acquire(uint64_t key)
-    {
-        for (auto i = 0u; i < _hashes.size(); ++i)
-        {
-            if (_hashes[i].hash == key && _hashes[i].used_frame < _current_frame)
-            {
-                _hashes[i].used_frame = _current_frame;
-                return _values[i];
-            }
-        }
+    // returns an element of the key that was not acquired this frame, or a null resource (miss)
+    [[nodiscard]] pr::resource acquire(uint64_t key);
 
-        return {phi::handle::null_resource};
-    }
-    void add_elem(uint64_t key, pr::resource val)
-    {
-        _hashes.push_back({key, _current_frame});
-        _values.push_back(val);
-    }
+    // acquires the given element again if it is still cached and was not acquired this frame
+    [[nodiscard]] bool reacquire(uint64_t key, pr::resource val);
+
+    // true if reacquire would succeed, without acquiring
+    [[nodiscard]] bool can_reacquire(uint64_t key, pr::resource val) const;
+
+    // the new element counts as acquired this frame
+    void add_elem(uint64_t key, pr::resource val, size_t size_bytes);
+
+    // removes elements unused for more than max_unused_frames, then the least recently used ones until resident within budget_bytes (0: no budget)
+    // elements used in the current or the previous frame are never removed
+    void evict(unsigned max_unused_frames, size_t budget_bytes, cc::function_ref<void(pr::resource)> free_func);
+
+    void for_each(cc::function_ref<void(pr::resource)> func) const;
 
     void on_new_frame() { ++_current_frame; }
-    void reset()
-    {
-        _hashes.clear();
-        _values.clear();
-    }
+    void reset();
 
-public:
-    struct map_element
+    resource_cache_stats const& get_stats() const { return _stats; }
+
+private:
+    static constexpr uint32_t invalid_entry = uint32_t(-1);
+
+    struct entry
     {
-        uint64_t hash;
+        uint64_t key;
         uint64_t used_frame;
+        pr::resource value;
+        size_t size_bytes;
+        uint32_t bucket_next; // next entry in the bucket, or in the free list
+        uint32_t lru_prev;    // towards less recently used
+        uint32_t lru_next;    // towards more recently used
     };
 
+    size_t get_bucket(uint64_t key) const { return size_t(key) & (_buckets.size() - 1); }
+
+    void lru_unlink(uint32_t idx);
+    void lru_push_back(uint32_t idx);
+
+    void remove(uint32_t idx);
+    void rebuild_buckets(size_t num_buckets);
+
+private:
     uint64_t _current_frame = 0;
-    cc::vector<map_element> _hashes;
-    cc::vector<pr::resource> _values;
+
+    cc::vector<entry> _entries;
+    cc::vector<uint32_t> _buckets; // first entry of each bucket, power of two size
+    uint32_t _free_head = invalid_entry;
+    uint32_t _lru_head = invalid_entry; // least recently used
+    uint32_t _lru_tail = invalid_entry; // most recently used
+
+    resource_cache_stats _stats;
 };
 
 class GraphCache
@@ -81,14 +110,32 @@ public:
         }
     }
 
-    void onNewFrame() { _cache.on_new_frame(); }
+    // evicts resources according to the policy, they are freed once no longer in flight
+    void onNewFrame();
 
     pr::resource get(pr::generic_resource_info const& info, char const* debug_name);
 
+    // marks a resource previously returned by get as used this frame, false if it was evicted or freed since
+    [[nodiscard]] bool reacquire(uint64_t info_hash, pr::resource res) { return _cache.reacquire(info_hash, res); }
+
+    // true if reacquire would succeed, without marking the resource as used
+    [[nodiscard]] bool canReacquire(uint64_t info_hash, pr::resource res) const { return _cache.can_reacquire(info_hash, res); }
+
     uint32_t freeAll();
 
+    // resources unused for more than max_unused_frames are evicted, as are the least recently used ones while above budget_bytes (0: no budget)
+    void setEvictionPolicy(unsigned max_unused_frames, size_t budget_bytes = 0)
+    {
+        _max_unused_frames = max_unused_frames;
+        _budget_bytes = budget_bytes;
+    }
+
+    resource_cache_stats const& getStats() const { return _cache.get_stats(); }
+
 private:
     pr::Context* _backend = nullptr;
     resource_cache _cache;
+    unsigned _max_unused_frames = 120;
+    size_t _budget_bytes = 0;
 };
 } // namespace inc::frag
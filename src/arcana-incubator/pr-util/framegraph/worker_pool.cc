@@ -0,0 +1,101 @@
+#include "worker_pool.hh"
+
+#include <clean-core/assert.hh>
+#include <clean-core/utility.hh>
+
+void inc::frag::worker_pool::destroy()
+{
+    if (_workers.empty())
+        return;
+
+    {
+        std::lock_guard lg(_mutex);
+        CC_ASSERT(_num_pending == 0 && "destroyed during run");
+        _is_shutting_down = true;
+    }
+    _work_cv.notify_all();
+
+    for (auto& worker : _workers)
+        worker.join();
+
+    _workers.clear();
+    _is_shutting_down = false;
+}
+
+void inc::frag::worker_pool::run(unsigned num_jobs, cc::function_ref<void(unsigned)> func)
+{
+    if (num_jobs == 0)
+        return;
+
+    // started before the run is published, new workers wait for it like the others
+    unsigned const num_workers = cc::min(num_jobs - 1, gc_max_num_pool_workers);
+    while (_workers.size() < num_workers)
+        _workers.emplace_back([this] { worker_main(); });
+
+    {
+        std::lock_guard lg(_mutex);
+        CC_ASSERT(_num_pending == 0 && "worker_pool::run is not reentrant");
+        _func = &func;
+        _num_jobs = num_jobs;
+        _next_job = 0;
+        _num_pending = num_jobs;
+    }
+    _work_cv.notify_all();
+
+    // the calling thread works as well, then waits for jobs taken by the workers
+    std::unique_lock lock(_mutex);
+    unsigned job;
+    while (try_take_job(job))
+    {
+        lock.unlock();
+        finish_job(job);
+        lock.lock();
+    }
+
+    _done_cv.wait(lock, [&] { return _num_pending == 0; });
+    _func = nullptr;
+}
+
+void inc::frag::worker_pool::worker_main()
+{
+    std::unique_lock lock(_mutex);
+    while (true)
+    {
+        unsigned job;
+        _work_cv.wait(lock, [&] { return _is_shutting_down || _next_job < _num_jobs; });
+
+        if (_is_shutting_down)
+            return;
+
+        while (try_take_job(job))
+        {
+            lock.unlock();
+            finish_job(job);
+            lock.lock();
+        }
+    }
+}
+
+bool inc::frag::worker_pool::try_take_job(unsigned& out_job)
+{
+    if (_next_job >= _num_jobs)
+        return false;
+
+    out_job = _next_job++;
+    return true;
+}
+
+void inc::frag::worker_pool::finish_job(unsigned job)
+{
+    (*_func)(job);
+
+    bool is_last;
+    {
+        std::lock_guard lg(_mutex);
+        CC_ASSERT(_num_pending > 0);
+        is_last = --_num_pending == 0;
+    }
+
+    if (is_last)
+        _done_cv.notify_one();
+}
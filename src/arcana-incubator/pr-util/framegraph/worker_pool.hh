@@ -0,0 +1,61 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <clean-core/capped_vector.hh>
+#include <clean-core/function_ref.hh>
+
+namespace inc::frag
+{
+inline constexpr unsigned gc_max_num_pool_workers = 31;
+
+// persistent threads for the ranges of GraphBuilder::executeParallel
+// workers are started on demand by run and kept until destroy, a run only wakes them instead of creating threads
+// the calling thread takes jobs as well, jobs are handed out in order, not to a fixed thread
+struct worker_pool
+{
+public:
+    worker_pool() = default;
+    worker_pool(worker_pool const&) = delete;
+    worker_pool(worker_pool&&) = delete;
+    worker_pool& operator=(worker_pool const&) = delete;
+    worker_pool& operator=(worker_pool&&) = delete;
+    ~worker_pool() { destroy(); }
+
+    // joins the workers, can be used again afterwards
+    void destroy();
+
+    // calls func(i) for each i in [0, num_jobs) on the calling thread and up to num_jobs - 1 workers
+    // returns once all jobs completed, func must be safe to run concurrently
+    // not reentrant, only one thread may run jobs at a time
+    void run(unsigned num_jobs, cc::function_ref<void(unsigned)> func);
+
+    unsigned get_num_workers() const { return unsigned(_workers.size()); }
+
+private:
+    void worker_main();
+
+    // takes the next job if one is left, the lock must be held
+    bool try_take_job(unsigned& out_job);
+
+    // runs the job and counts it down, the lock must not be held
+    void finish_job(unsigned job);
+
+private:
+    cc::capped_vector<std::thread, gc_max_num_pool_workers> _workers;
+
+    std::mutex _mutex;
+    std::condition_variable _work_cv; // workers wait for jobs or shutdown
+    std::condition_variable _done_cv; // run waits for the last job (a latch over _num_pending)
+
+    // the current run, valid while _num_pending > 0
+    cc::function_ref<void(unsigned)>* _func = nullptr;
+    unsigned _num_jobs = 0;
+    unsigned _next_job = 0;
+    unsigned _num_pending = 0; // taken or not, counted down once finished
+
+    bool _is_shutting_down = false;
+};
+}
@@ -0,0 +1,371 @@
+#include "ibl_cache.hh"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#include <clean-core/capped_vector.hh>
+#include <clean-core/utility.hh>
+
+#include <phantasm-hardware-interface/Backend.hh>
+#include <phantasm-hardware-interface/common/byte_util.hh>
+#include <phantasm-hardware-interface/common/format_size.hh>
+
+#include <phantasm-renderer/Context.hh>
+#include <phantasm-renderer/Frame.hh>
+
+#include <arcana-incubator/phi-util/unique_buffer.hh>
+
+#include "texture_processing.hh"
+
+namespace
+{
+constexpr uint32_t gc_cooked_texture_magic = 0x54434E49; // "INCT"
+constexpr uint32_t gc_cooked_texture_version = 1;
+
+constexpr uint32_t gc_ibl_cache_magic = 0x4C424943; // "CIBL"
+constexpr uint32_t gc_ibl_cache_version = 3;         // bump when texture_processing bakes change
+
+constexpr unsigned gc_max_num_subresources = 6 * 16;
+
+struct ibl_cache_header
+{
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint64_t key = 0;
+};
+
+struct subresource_layout
+{
+    unsigned mip = 0;
+    unsigned array_slice = 0;
+    unsigned num_rows = 0;
+    size_t row_size_bytes = 0;
+    size_t row_pitch_bytes = 0;
+    size_t offset_pitched = 0; // offset in an upload or readback buffer
+    size_t offset_packed = 0;  // offset in the cooked data
+};
+
+using subresource_layouts = cc::capped_vector<subresource_layout, gc_max_num_subresources>;
+
+// computes the layout of all subresources in a GPU buffer and in cooked data
+// in D3D12, rows are 256-byte aligned and subresources are 512-byte aligned
+void get_subresource_layouts(inc::pre::cooked_texture_header const& header, bool align_rows, subresource_layouts& out_layouts, size_t& out_size_pitched, size_t& out_size_packed)
+{
+    auto const bytes_per_pixel = phi::util::get_format_size_bytes(pr::format(header.fmt));
+
+    out_size_pitched = 0;
+    out_size_packed = 0;
+    for (auto a = 0u; a < header.array_size; ++a)
+    {
+        for (auto m = 0u; m < header.num_mips; ++m)
+        {
+            subresource_layout& layout = out_layouts.emplace_back();
+            layout.mip = m;
+            layout.array_slice = a;
+            layout.num_rows = cc::max(1u, header.height >> m);
+            layout.row_size_bytes = size_t(bytes_per_pixel) * cc::max(1u, header.width >> m);
+            layout.row_pitch_bytes = align_rows ? phi::util::align_up(layout.row_size_bytes, 256) : layout.row_size_bytes;
+
+            if (align_rows)
+                out_size_pitched = phi::util::align_up(out_size_pitched, 512);
+
+            layout.offset_pitched = out_size_pitched;
+            layout.offset_packed = out_size_packed;
+
+            out_size_pitched += layout.row_pitch_bytes * layout.num_rows;
+            out_size_packed += layout.row_size_bytes * layout.num_rows;
+        }
+    }
+}
+
+bool is_d3d12(pr::Context& ctx) { return ctx.get_backend().getBackendType() == phi::backend_type::d3d12; }
+
+// FNV-1a
+uint64_t hash_bytes(cc::span<std::byte const> data, uint64_t hash = 14695981039346656037ull)
+{
+    for (std::byte const b : data)
+    {
+        hash ^= uint64_t(b);
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+uint64_t hash_value(uint64_t value, uint64_t hash) { return hash_bytes({reinterpret_cast<std::byte const*>(&value), sizeof(value)}, hash); }
+
+// writes to a temporary file next to path and renames it into place
+bool write_file_atomic(inc::unique_buffer& data, char const* path)
+{
+    char temp_path[1040];
+    std::snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+    if (!data.write_to_binary_file(temp_path))
+    {
+        std::remove(temp_path);
+        return false;
+    }
+
+    // replaces an existing file (unlike std::rename on Windows)
+    std::error_code ec;
+    std::filesystem::rename(temp_path, path, ec);
+    if (ec)
+    {
+        std::remove(temp_path);
+        return false;
+    }
+
+    return true;
+}
+
+// readbacks of several textures, resolved with a single GPU flush
+struct texture_readback
+{
+    inc::pre::cooked_texture_header header;
+    subresource_layouts layouts;
+    size_t size_pitched = 0;
+    pr::auto_buffer buffer;
+
+    void record(pr::raii::Frame& frame, pr::texture const& texture)
+    {
+        auto& ctx = frame.context();
+        auto const& info = ctx.get_texture_info(texture);
+
+        header.magic = gc_cooked_texture_magic;
+        header.version = gc_cooked_texture_version;
+        header.fmt = uint32_t(info.fmt);
+        header.width = uint32_t(info.width);
+        header.height = uint32_t(info.height);
+        header.num_mips = uint32_t(info.num_mips);
+        header.array_size = uint32_t(info.depth_or_array_size);
+
+        size_t size_packed = 0;
+        get_subresource_layouts(header, is_d3d12(ctx), layouts, size_pitched, size_packed);
+        header.data_size_bytes = size_packed;
+
+        buffer = ctx.make_readback_buffer(unsigned(size_pitched));
+
+        frame.transition(texture, pr::state::copy_src);
+        for (auto const& layout : layouts)
+            frame.copy(texture, buffer, layout.offset_pitched, layout.mip, layout.array_slice);
+    }
+
+    // must only be called after the GPU has finished the copies
+    void resolve(pr::Context& ctx, std::byte* out_data)
+    {
+        std::byte const* const map = ctx.map_buffer(buffer);
+
+        for (auto const& layout : layouts)
+        {
+            for (auto y = 0u; y < layout.num_rows; ++y)
+            {
+                std::memcpy(out_data + layout.offset_packed + y * layout.row_size_bytes, map + layout.offset_pitched + y * layout.row_pitch_bytes,
+                            layout.row_size_bytes);
+            }
+        }
+
+        ctx.unmap_buffer(buffer);
+    }
+};
+
+// parses a cooked texture at the front of data, advancing it
+bool parse_cooked_texture(cc::span<std::byte const>& inout_data, inc::pre::cooked_texture_header& out_header, cc::span<std::byte const>& out_texels)
+{
+    if (inout_data.size() < sizeof(out_header))
+        return false;
+
+    std::memcpy(&out_header, inout_data.data(), sizeof(out_header));
+    inout_data = inout_data.subspan(sizeof(out_header));
+
+    if (out_header.magic != gc_cooked_texture_magic || out_header.version != gc_cooked_texture_version || inout_data.size() < out_header.data_size_bytes)
+        return false;
+
+    if (out_header.array_size * out_header.num_mips > gc_max_num_subresources)
+        return false;
+
+    out_texels = inout_data.subspan(0, out_header.data_size_bytes);
+    inout_data = inout_data.subspan(out_header.data_size_bytes);
+    return true;
+}
+}
+
+bool inc::pre::read_back_cooked_texture(pr::Context& ctx, const pr::texture& texture, inc::pre::cooked_texture_header& out_header, cc::vector<std::byte>& out_data)
+{
+    texture_readback readback;
+    {
+        auto frame = ctx.make_frame();
+        readback.record(frame, texture);
+        ctx.submit(cc::move(frame));
+    }
+
+    ctx.flush();
+
+    out_header = readback.header;
+    out_data.resize(readback.header.data_size_bytes);
+    readback.resolve(ctx, out_data.data());
+    return true;
+}
+
+pr::auto_texture inc::pre::upload_cooked_texture(pr::raii::Frame& frame, const inc::pre::cooked_texture_header& header, cc::span<const std::byte> data)
+{
+    CC_ASSERT(header.magic == gc_cooked_texture_magic && data.size() >= header.data_size_bytes && "invalid cooked texture");
+    auto& ctx = frame.context();
+
+    subresource_layouts layouts;
+    size_t size_pitched = 0;
+    size_t size_packed = 0;
+    get_subresource_layouts(header, is_d3d12(ctx), layouts, size_pitched, size_packed);
+
+    auto const fmt = pr::format(header.fmt);
+    tg::isize2 const size = {int(header.width), int(header.height)};
+    auto res = header.array_size == 6 ? ctx.make_texture_cube(size, fmt, header.num_mips, true) : ctx.make_texture(size, fmt, header.num_mips, true);
+
+    auto b_upload = ctx.make_upload_buffer(unsigned(size_pitched)).disown();
+    std::byte* const map = ctx.map_buffer(b_upload);
+    for (auto const& layout : layouts)
+    {
+        for (auto y = 0u; y < layout.num_rows; ++y)
+        {
+            std::memcpy(map + layout.offset_pitched + y * layout.row_pitch_bytes, data.data() + layout.offset_packed + y * layout.row_size_bytes,
+                        layout.row_size_bytes);
+        }
+    }
+    ctx.unmap_buffer(b_upload);
+
+    frame.transition(res, pr::state::copy_dest);
+    for (auto const& layout : layouts)
+        frame.copy(b_upload, res, layout.offset_pitched, layout.mip, layout.array_slice);
+
+    frame.free_deferred_after_submit(b_upload);
+    return res;
+}
+
+inc::pre::ibl_bake_result inc::pre::load_or_bake_ibl(
+    pr::Context& ctx, inc::pre::texture_processing& tex, const char* hdr_equirect_path, const char* cache_dir, const inc::pre::ibl_bake_params& params)
+{
+    // key: source path, size and modification time (optionally its contents) and the bake parameters
+    std::error_code ec;
+    auto const source_size = std::filesystem::file_size(hdr_equirect_path, ec);
+    CC_RUNTIME_ASSERT(!ec && "failed to open IBL source image");
+    auto const source_mtime = std::filesystem::last_write_time(hdr_equirect_path, ec).time_since_epoch().count();
+
+    uint64_t key = hash_bytes({reinterpret_cast<std::byte const*>(hdr_equirect_path), std::strlen(hdr_equirect_path)});
+    key = hash_value(uint64_t(source_size), key);
+    key = hash_value(uint64_t(source_mtime), key);
+    key = hash_value(uint64_t(params.specular_cube_width_height), key);
+    key = hash_value(uint64_t(params.irradiance_cube_width_height), key);
+    key = hash_value(uint64_t(params.brdf_lut_width_height), key);
+    key = hash_value(gc_ibl_cache_version, key);
+
+    // the source is only read on a miss, unless its contents are part of the key
+    inc::unique_buffer source;
+    if (params.hash_source_contents)
+    {
+        source = inc::unique_buffer::create_from_binary_file(hdr_equirect_path);
+        CC_RUNTIME_ASSERT(source.is_valid() && "failed to load IBL source image");
+        key = hash_bytes({source.data(), source.size()}, key);
+    }
+
+    char cache_path[1024];
+    std::snprintf(cache_path, sizeof(cache_path), "%s/ibl_%016" PRIx64 ".bin", cache_dir, key);
+
+    ibl_bake_result res;
+
+    // cache hit: upload the cooked results
+    {
+        auto const cached = inc::unique_buffer::create_from_binary_file(cache_path);
+        if (cached.is_valid() && cached.size() >= sizeof(ibl_cache_header))
+        {
+            cc::span<std::byte const> data = {cached.data(), cached.size()};
+
+            ibl_cache_header file_header;
+            std::memcpy(&file_header, data.data(), sizeof(file_header));
+            data = data.subspan(sizeof(file_header));
+
+            cooked_texture_header tex_headers[3];
+            cc::span<std::byte const> tex_texels[3];
+            bool is_valid = file_header.magic == gc_ibl_cache_magic && file_header.version == gc_ibl_cache_version && file_header.key == key;
+
+            for (auto i = 0; i < 3 && is_valid; ++i)
+                is_valid = parse_cooked_texture(data, tex_headers[i], tex_texels[i]);
+
+            if (is_valid)
+            {
+                auto frame = ctx.make_frame();
+                res.filtered_specular = upload_cooked_texture(frame, tex_headers[0], tex_texels[0]);
+                res.diffuse_irradiance = upload_cooked_texture(frame, tex_headers[1], tex_texels[1]);
+                res.brdf_lut = upload_cooked_texture(frame, tex_headers[2], tex_texels[2]);
+                ctx.submit(cc::move(frame));
+
+                res.is_from_cache = true;
+                return res;
+            }
+        }
+    }
+
+    // cache miss: bake
+    if (!source.is_valid())
+    {
+        source = inc::unique_buffer::create_from_binary_file(hdr_equirect_path);
+        CC_RUNTIME_ASSERT(source.is_valid() && "failed to load IBL source image");
+    }
+
+    // the BRDF LUT does not depend on the source, it is shared by all bakes of the same size
+    char brdf_lut_path[1024];
+    std::snprintf(brdf_lut_path, sizeof(brdf_lut_path), "%s/brdf_lut_%d.bin", cache_dir, params.brdf_lut_width_height);
+
+    {
+        auto frame = ctx.make_frame();
+
+        auto specular = tex.load_filtered_specular_map_from_memory(frame, {source.data(), source.size()}, params.specular_cube_width_height);
+        res.diffuse_irradiance = tex.create_diffuse_irradiance_map(frame, specular.unfiltered_env, params.irradiance_cube_width_height);
+        res.brdf_lut = tex.load_brdf_lut(frame, brdf_lut_path, params.brdf_lut_width_height);
+        res.filtered_specular = cc::move(specular.filtered_env);
+
+        ctx.submit(cc::move(frame));
+    }
+
+    // read back and write the cache file
+    {
+        texture_readback readbacks[3];
+        {
+            auto frame = ctx.make_frame();
+            readbacks[0].record(frame, res.filtered_specular);
+            readbacks[1].record(frame, res.diffuse_irradiance);
+            readbacks[2].record(frame, res.brdf_lut);
+            ctx.submit(cc::move(frame));
+        }
+
+        ctx.flush();
+
+        size_t file_size = sizeof(ibl_cache_header);
+        for (auto const& rb : readbacks)
+            file_size += sizeof(cooked_texture_header) + rb.header.data_size_bytes;
+
+        auto file_data = inc::unique_buffer(file_size);
+        std::byte* cursor = file_data.data();
+
+        ibl_cache_header file_header;
+        file_header.magic = gc_ibl_cache_magic;
+        file_header.version = gc_ibl_cache_version;
+        file_header.key = key;
+        std::memcpy(cursor, &file_header, sizeof(file_header));
+        cursor += sizeof(file_header);
+
+        for (auto& rb : readbacks)
+        {
+            std::memcpy(cursor, &rb.header, sizeof(rb.header));
+            cursor += sizeof(rb.header);
+
+            rb.resolve(ctx, cursor);
+            cursor += rb.header.data_size_bytes;
+        }
+
+        if (!write_file_atomic(file_data, cache_path))
+            std::fprintf(stderr, "[ibl_cache] failed to write IBL cache file %s\n", cache_path);
+    }
+
+    return res;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+
+#include <clean-core/span.hh>
+#include <clean-core/vector.hh>
+
+#include <phantasm-renderer/fwd.hh>
+#include <phantasm-renderer/resource_types.hh>
+
+namespace inc::pre
+{
+struct texture_processing;
+
+struct ibl_bake_params
+{
+    int specular_cube_width_height = 512;
+    int irradiance_cube_width_height = 32;
+    int brdf_lut_width_height = 256;
+
+    // the cache key is the source path, file size and modification time
+    // if enabled, the source contents are hashed as well (reads the source on every call, also on cache hits)
+    bool hash_source_contents = false;
+};
+
+struct ibl_bake_result
+{
+    pr::auto_texture filtered_specular;  // filtered specular cubemap with mips
+    pr::auto_texture diffuse_irradiance; // diffuse irradiance cubemap
+    pr::auto_texture brdf_lut;           // split-sum BRDF LUT
+    bool is_from_cache = false;
+};
+
+/// header of a cooked texture, followed by the tightly packed texels of all subresources (array slice-major, then mips)
+struct cooked_texture_header
+{
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint32_t fmt = 0; // pr::format
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t num_mips = 0;
+    uint32_t array_size = 0; // 6 for cubemaps
+    uint32_t _padding = 0;
+    uint64_t data_size_bytes = 0;
+};
+
+/// loads the IBL textures from cache_dir if a bake of the same source image and params exists,
+/// otherwise runs the bake using tex, reads the results back and writes them to cache_dir
+/// on a hit, the source image is not read (unless params.hash_source_contents) and the cooked texels are uploaded directly
+/// the resulting textures are in state copy_dest (cache hit) or copy_src (cache miss, left by the readback)
+/// on a miss, the BRDF LUT is loaded from (or cooked to) cache_dir/brdf_lut_<size>.bin, see texture_processing::load_brdf_lut
+/// the cache file is written to a temporary file first and renamed into place, concurrent readers never see a partial file
+/// NOTE: a cache miss flushes the GPU
+[[nodiscard]] ibl_bake_result load_or_bake_ibl(
+    pr::Context& ctx, texture_processing& tex, char const* hdr_equirect_path, char const* cache_dir, ibl_bake_params const& params = {});
+
+/// reads a texture back to the CPU in the cooked format (header + tightly packed texels)
+/// NOTE: flushes the GPU
+[[nodiscard]] bool read_back_cooked_texture(pr::Context& ctx, pr::texture const& texture, cooked_texture_header& out_header, cc::vector<std::byte>& out_data);
+
+/// creates a texture from cooked data and records its upload
+[[nodiscard]] pr::auto_texture upload_cooked_texture(pr::raii::Frame& frame, cooked_texture_header const& header, cc::span<std::byte const> data);
+}
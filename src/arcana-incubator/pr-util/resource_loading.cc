@@ -7,12 +7,15 @@
 #include <clean-core/defer.hh>
 
 #include <phantasm-hardware-interface/Backend.hh>
+#include <phantasm-hardware-interface/commands.hh>
 
 #include <phantasm-renderer/CompiledFrame.hh>
 #include <phantasm-renderer/Context.hh>
 #include <phantasm-renderer/Frame.hh>
 
 #include <arcana-incubator/asset-loading/mesh_loader.hh>
+#include <arcana-incubator/phi-util/mesh_util.hh>
+#include <arcana-incubator/phi-util/upload_ring.hh>
 
 bool inc::pre::is_shader_present(const char* path, const char* path_prefix)
 {
@@ -72,3 +75,35 @@ inc::pre::pr_mesh inc::pre::load_mesh(pr::Context& ctx, cc::span<const uint32_t>
 
     return res;
 }
+
+inc::pre::pr_mesh inc::pre::load_mesh(pr::Context& ctx, inc::upload_ring& staging, const char* path, bool binary)
+{
+    auto const data = binary ? inc::assets::load_binary_mesh(path) : inc::assets::load_obj_mesh(path);
+    return load_mesh(ctx, staging, data.indices, data.vertices);
+}
+
+inc::pre::pr_mesh inc::pre::load_mesh(pr::Context& ctx,
+                                      inc::upload_ring& staging,
+                                      cc::span<const uint32_t> indices,
+                                      cc::span<const inc::assets::simple_vertex> vertices)
+{
+    pr_mesh res;
+    res.vertex = ctx.make_buffer(uint32_t(vertices.size_bytes()), sizeof(inc::assets::simple_vertex));
+    res.index = ctx.make_buffer(uint32_t(indices.size_bytes()), sizeof(uint32_t));
+
+    // the ring is a raw phi buffer, the copy is recorded and submitted through the backend
+    // vertices and indices are copied with buffer copies, 16 byte alignment suffices
+    auto const upload = staging.allocate(vertices.size_bytes() + indices.size_bytes(), 16);
+
+    std::byte cmd_buffer[2 * sizeof(phi::cmd::transition_resources) + 2 * sizeof(phi::cmd::copy_buffer)];
+    phi::command_stream_writer writer(cmd_buffer, sizeof(cmd_buffer));
+    inc::record_mesh_upload(writer, res.vertex.data.res.handle, res.index.data.res.handle, upload, vertices.data(), vertices.size_bytes(),
+                            indices.data(), indices.size_bytes());
+
+    auto& backend = ctx.get_backend();
+    auto const cmd_list = backend.recordCommandList(writer.buffer(), writer.size());
+    backend.submit(cc::span{cmd_list});
+    staging.signal_submit(phi::queue_type::direct);
+
+    return res;
+}
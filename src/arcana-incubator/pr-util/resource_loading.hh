@@ -9,6 +9,11 @@
 
 #include <arcana-incubator/phi-util/unique_buffer.hh>
 
+namespace inc
+{
+struct upload_ring;
+}
+
 namespace inc::assets
 {
 struct simple_vertex;
@@ -34,4 +39,9 @@ struct pr_mesh
 
 /// loads a mesh from memory to GPU
 [[nodiscard]] pr_mesh load_mesh(pr::Context& ctx, cc::span<uint32_t const> indices, cc::span<inc::assets::simple_vertex const> vertices);
+
+/// loads a mesh, staged in the upload ring instead of a per-mesh upload buffer
+/// submitted on the direct queue right away (like ctx.submit), staging must be initialized with ctx.get_backend()
+[[nodiscard]] pr_mesh load_mesh(pr::Context& ctx, upload_ring& staging, char const* path, bool binary = false);
+[[nodiscard]] pr_mesh load_mesh(pr::Context& ctx, upload_ring& staging, cc::span<uint32_t const> indices, cc::span<inc::assets::simple_vertex const> vertices);
 } // namespace inc::pre
@@ -1,9 +1,14 @@
 #include "texture_processing.hh"
 
+#include <cstdio>
+#include <cstring>
+
 #include <clean-core/bits.hh>
+#include <clean-core/capped_vector.hh>
 #include <clean-core/defer.hh>
 #include <clean-core/utility.hh>
 
+#include <phantasm-hardware-interface/commands.hh>
 #include <phantasm-hardware-interface/common/byte_util.hh>
 #include <phantasm-hardware-interface/common/format_size.hh>
 #include <phantasm-hardware-interface/util.hh>
@@ -12,12 +17,23 @@
 #include <phantasm-renderer/Frame.hh>
 #include <phantasm-renderer/pass_info.hh>
 
+#include <arcana-incubator/asset-loading/brdf_lut.hh>
 #include <arcana-incubator/asset-loading/image_loader.hh>
+#include <arcana-incubator/asset-loading/image_resize.hh>
+#include <arcana-incubator/phi-util/texture_util.hh>
 
 #include "resource_loading.hh"
 
+namespace
+{
+constexpr unsigned gc_max_mip_array_size = 16;
+}
+
 void inc::pre::texture_processing::init(pr::Context& ctx, const char* path_prefix, char const* file_ending_override)
 {
+    std::snprintf(shader_path_prefix, sizeof(shader_path_prefix), "%s", path_prefix);
+    std::snprintf(shader_file_ending, sizeof(shader_file_ending), "%s", file_ending_override ? file_ending_override : "");
+
     {
         auto [cs_mipgen, b1] = load_shader(ctx, "mipgen", phi::shader_stage::compute, path_prefix, file_ending_override);
         auto [cs_mipgen_gamma, b2] = load_shader(ctx, "mipgen_gamma", phi::shader_stage::compute, path_prefix, file_ending_override);
@@ -27,16 +43,34 @@ void inc::pre::texture_processing::init(pr::Context& ctx, const char* path_prefi
         pso_mipgen_gamma = ctx.make_pipeline_state(pr::compute_pass(cs_mipgen_gamma).arg(1, 1));
         pso_mipgen_array = ctx.make_pipeline_state(pr::compute_pass(cs_mipgen_array).arg(1, 1));
     }
+    if (is_shader_present("mipgen_spd", path_prefix))
+    {
+        auto [cs_mipgen_spd, b8] = load_shader(ctx, "mipgen_spd", phi::shader_stage::compute, path_prefix, file_ending_override);
+
+        // SRV: mip 0, UAVs: mips 1 to 12, atomic counters
+        pso_mipgen_spd = ctx.make_pipeline_state(pr::compute_pass(cs_mipgen_spd).arg(1, inc::gc_spd_max_num_mips + 1).enable_constants());
+
+        // the counters must start at zero, the shader resets them after each use
+        unsigned const counters_size = sizeof(uint32_t) * gc_max_mip_array_size;
+        buf_spd_counters = ctx.make_buffer(counters_size, sizeof(uint32_t), true);
+
+        auto b_upload = ctx.make_upload_buffer(counters_size).disown();
+        std::memset(ctx.map_buffer(b_upload), 0, counters_size);
+        ctx.unmap_buffer(b_upload);
+
+        auto frame = ctx.make_frame();
+        frame.copy(b_upload, buf_spd_counters);
+        frame.free_deferred_after_submit(b_upload);
+        ctx.submit(cc::move(frame));
+    }
     {
         auto [cs_equirect_cube, b4] = load_shader(ctx, "equirect_to_cube", phi::shader_stage::compute, path_prefix, file_ending_override);
         auto [cs_spec_filter, b5] = load_shader(ctx, "specular_map_filter", phi::shader_stage::compute, path_prefix, file_ending_override);
         auto [cs_irr_filter, b6] = load_shader(ctx, "irradiance_map_filter", phi::shader_stage::compute, path_prefix, file_ending_override);
-        auto [cs_lut_gen, b7] = load_shader(ctx, "brdf_lut_gen", phi::shader_stage::compute, path_prefix, file_ending_override);
 
         pso_equirect_to_cube = ctx.make_pipeline_state(pr::compute_pass(cs_equirect_cube).arg(1, 1, 1));
         pso_specular_map_filter = ctx.make_pipeline_state(pr::compute_pass(cs_spec_filter).arg(1, 1, 1).enable_constants());
         pso_irradiance_map_gen = ctx.make_pipeline_state(pr::compute_pass(cs_irr_filter).arg(1, 1, 1));
-        pso_brdf_lut_gen = ctx.make_pipeline_state(pr::compute_pass(cs_lut_gen).arg(0, 1));
     }
 }
 
@@ -45,6 +79,8 @@ void inc::pre::texture_processing::free()
     pso_mipgen.free();
     pso_mipgen_gamma.free();
     pso_mipgen_array.free();
+    pso_mipgen_spd.free();
+    buf_spd_counters.free();
     pso_equirect_to_cube.free();
     pso_specular_map_filter.free();
     pso_irradiance_map_gen.free();
@@ -61,8 +97,10 @@ pr::auto_texture inc::pre::texture_processing::load_texture_from_memory(pr::raii
         img_data = inc::assets::load_image(data, img_size, int(num_components), is_hdr);
         CC_RUNTIME_ASSERT(inc::assets::is_valid(img_data) && "failed to load texture from memory");
     }
+    size_t const size_bytes = apply_budget(img_data, img_size, fmt, mips, gamma);
     auto res = load_texture(frame, img_data, img_size, fmt, mips, gamma);
     inc::assets::free(img_data);
+    add_resident_texture(res, size_bytes);
     return res;
 }
 
@@ -76,8 +114,10 @@ pr::auto_texture inc::pre::texture_processing::load_texture_from_file(pr::raii::
         img_data = inc::assets::load_image(path, img_size, int(num_components), is_hdr);
         CC_RUNTIME_ASSERT(inc::assets::is_valid(img_data) && "failed to load texture from file");
     }
+    size_t const size_bytes = apply_budget(img_data, img_size, fmt, mips, gamma);
     auto res = load_texture(frame, img_data, img_size, fmt, mips, gamma);
     inc::assets::free(img_data);
+    add_resident_texture(res, size_bytes);
     return res;
 }
 
@@ -97,9 +137,88 @@ pr::auto_texture inc::pre::texture_processing::load_texture(
     return res;
 }
 
+size_t inc::pre::texture_processing::apply_budget(inc::assets::image_data& inout_data, inc::assets::image_size& inout_size, pr::format fmt, bool mips, bool gamma)
+{
+    auto const f_get_size_bytes = [&](inc::assets::image_size const& size) -> size_t {
+        return phi::util::get_texture_size_bytes({int(size.width), int(size.height), 1}, fmt, mips ? int(size.num_mipmaps) : 1, false);
+    };
+
+    // the per-level mip path requires square power of two sizes, the single pass downsampler handles any size up to its mip limit
+    bool const has_npot_mips = enable_single_pass_mipgen && pso_mipgen_spd.data.handle.is_valid();
+    auto const f_uses_per_level_mips
+        = [&](inc::assets::image_size const& size) { return mips && (!has_npot_mips || size.num_mipmaps - 1 > inc::gc_spd_max_num_mips); };
+
+    size_t const original_size_bytes = f_get_size_bytes(inout_size);
+    auto target_size = inout_size;
+
+    // without a budget the image is never resized
+    if (budget.max_dimension > 0 || budget.max_resident_bytes > 0)
+    {
+        target_size = inc::assets::get_capped_image_size(inout_size, budget.max_dimension);
+
+        if (budget.max_resident_bytes > 0)
+        {
+            // halve until the texture fits into the remaining budget
+            while (load_stats.bytes_resident + f_get_size_bytes(target_size) > budget.max_resident_bytes && (target_size.width > 1 || target_size.height > 1))
+                target_size = inc::assets::get_capped_image_size(target_size, cc::max(target_size.width, target_size.height) / 2);
+        }
+
+        // a texture that is downscaled anyway is rounded down to a power of two if the per-level mip path will run
+        bool const is_downscaled = target_size.width != inout_size.width || target_size.height != inout_size.height;
+        if (is_downscaled && f_uses_per_level_mips(target_size))
+            target_size = inc::assets::get_capped_image_size(target_size, 0, true);
+    }
+
+    if (target_size.width != inout_size.width || target_size.height != inout_size.height)
+    {
+        inc::assets::image_size resized_size;
+        auto const resized = inc::assets::resize_image(inout_data, inout_size, target_size.width, target_size.height, resized_size,
+                                                       inc::assets::resample_filter::lanczos3, gamma, 0, inout_data.alloc);
+        CC_RUNTIME_ASSERT(inc::assets::is_valid(resized) && "failed to downscale texture");
+
+        inc::assets::free(inout_data);
+        inout_data = resized;
+        inout_size = resized_size;
+
+        ++load_stats.num_downscaled;
+    }
+
+    CC_ASSERT((!f_uses_per_level_mips(inout_size) || (inout_size.width == inout_size.height && cc::is_pow2(inout_size.width)))
+              && "mips of non-square or non-power of two textures require the single pass downsampler (mipgen_spd)");
+
+    size_t const final_size_bytes = f_get_size_bytes(inout_size);
+    ++load_stats.num_loaded;
+    load_stats.bytes_loaded += final_size_bytes;
+    load_stats.bytes_saved += original_size_bytes - final_size_bytes;
+    return final_size_bytes;
+}
+
+void inc::pre::texture_processing::add_resident_texture(const pr::texture& texture, size_t size_bytes)
+{
+    resident_textures.push_back({texture.handle, size_bytes});
+    load_stats.bytes_resident += size_bytes;
+}
+
+void inc::pre::texture_processing::release_texture(const pr::texture& texture)
+{
+    for (auto i = 0u; i < resident_textures.size(); ++i)
+    {
+        if (resident_textures[i].handle == texture.handle)
+        {
+            load_stats.bytes_resident -= resident_textures[i].size_bytes;
+            resident_textures[i] = resident_textures.back();
+            resident_textures.pop_back();
+            return;
+        }
+    }
+}
+
 void inc::pre::texture_processing::generate_mips(pr::raii::Frame& frame, const pr::texture& texture, bool apply_gamma)
 {
-    constexpr auto max_array_size = 16u;
+    constexpr auto max_array_size = gc_max_mip_array_size;
+
+    if (enable_single_pass_mipgen && pso_mipgen_spd.data.handle.is_valid() && generate_mips_single_pass(frame, texture, apply_gamma))
+        return;
 
     auto const& texInfo = frame.context().get_texture_info(texture);
     CC_ASSERT(texInfo.width == texInfo.height && "non-square textures unimplemented");
@@ -120,6 +239,7 @@ void inc::pre::texture_processing::generate_mips(pr::raii::Frame& frame, const p
     }
 
     frame.transition(texture, pr::state::shader_resource, phi::shader_stage_flags::compute);
+    ++mip_stats.num_barrier_commands;
 
     auto pass = frame.make_pass(matching_pso);
 
@@ -150,9 +270,80 @@ void inc::pre::texture_processing::generate_mips(pr::raii::Frame& frame, const p
         pass.bind(arg).dispatch(cc::max(1u, levelWidth / 8), cc::max(1u, levelHeight / 8), texInfo.depth_or_array_size);
 
         frame.transition_slices(post_dispatch);
+
+        ++mip_stats.num_dispatches;
+        mip_stats.num_barrier_commands += 2;
+        mip_stats.num_slice_transitions += unsigned(pre_dispatch.size() + post_dispatch.size());
     }
 }
 
+bool inc::pre::texture_processing::generate_mips_single_pass(pr::raii::Frame& frame, const pr::texture& texture, bool apply_gamma)
+{
+    using slice_transition_info = phi::cmd::transition_image_slices::slice_transition_info;
+
+    auto const& texInfo = frame.context().get_texture_info(texture);
+    unsigned const array_size = unsigned(texInfo.depth_or_array_size);
+    unsigned const num_mips = texInfo.num_mips > 0 ? texInfo.num_mips : phi::util::get_num_mips(texInfo.width, texInfo.height);
+
+    inc::spd_constants constants;
+    unsigned num_groups_x = 0;
+    unsigned num_groups_y = 0;
+    if (array_size > gc_max_mip_array_size || !inc::get_spd_setup(unsigned(texInfo.width), unsigned(texInfo.height), num_mips, apply_gamma, constants, num_groups_x, num_groups_y))
+        return false;
+
+    auto _label = frame.scoped_debug_label("texture_processing - generate mips (single pass)");
+
+    frame.transition(texture, pr::state::shader_resource, phi::shader_stage_flags::compute);
+    frame.transition(buf_spd_counters, pr::state::unordered_access, phi::shader_stage_flags::compute);
+    mip_stats.num_barrier_commands += 2;
+
+    // all mips below 0 are written in the same dispatch, transition them at once instead of per level
+    auto const f_transition_mips = [&](pr::state before, pr::state after) {
+        cc::capped_vector<slice_transition_info, phi::limits::max_resource_transitions> transitions;
+        for (auto level = 1u; level < num_mips; ++level)
+        {
+            for (auto arraySlice = 0u; arraySlice < array_size; ++arraySlice)
+            {
+                if (transitions.size() == phi::limits::max_resource_transitions)
+                {
+                    frame.transition_slices(transitions);
+                    transitions.clear();
+                    ++mip_stats.num_barrier_commands;
+                }
+
+                transitions.push_back(slice_transition_info{texture.handle, before, after, phi::shader_stage_flags::compute,
+                                                            phi::shader_stage_flags::compute, int(level), int(arraySlice)});
+                ++mip_stats.num_slice_transitions;
+            }
+        }
+
+        if (!transitions.empty())
+        {
+            frame.transition_slices(transitions);
+            ++mip_stats.num_barrier_commands;
+        }
+    };
+
+    pr::argument arg;
+    arg.add(pr::view::tex2d_array(texture, texInfo.fmt, 0, array_size, false, 0, 1));
+    for (auto level = 1u; level <= inc::gc_spd_max_num_mips; ++level)
+    {
+        // slots beyond the last mip are never written, they alias it to keep the argument shape fixed
+        arg.add_mutable(pr::view::tex2d_array(texture, texInfo.fmt, 0, array_size, false, cc::min(level, num_mips - 1), 1));
+    }
+    arg.add_mutable(buf_spd_counters);
+
+    f_transition_mips(pr::state::shader_resource, pr::state::unordered_access);
+
+    auto pass = frame.make_pass(pso_mipgen_spd).bind(arg);
+    pass.write_constants(constants);
+    pass.dispatch(num_groups_x, num_groups_y, array_size);
+    ++mip_stats.num_dispatches;
+
+    f_transition_mips(pr::state::unordered_access, pr::state::shader_resource);
+    return true;
+}
+
 inc::pre::filtered_specular_result inc::pre::texture_processing::load_filtered_specular_map_from_memory(pr::raii::Frame& frame,
                                                                                                         cc::span<const std::byte> data,
                                                                                                         int cube_width_height)
@@ -252,7 +443,14 @@ pr::auto_texture inc::pre::texture_processing::create_brdf_lut(pr::raii::Frame&
     CC_ASSERT(width % 32 == 0 && "BRDF LUT size must be divisible by 32");
     CC_ASSERT(height % 32 == 0 && "BRDF LUT size must be divisible by 32");
 
-    auto t_lut = frame.context().make_texture({width, height}, pr::format::rgba16un, 1, true);
+    if (!pso_brdf_lut_gen.data.handle.is_valid())
+    {
+        char const* const file_ending = shader_file_ending[0] != '\0' ? shader_file_ending : nullptr;
+        auto [cs_lut_gen, b7] = load_shader(frame.context(), "brdf_lut_gen", phi::shader_stage::compute, shader_path_prefix, file_ending);
+        pso_brdf_lut_gen = frame.context().make_pipeline_state(pr::compute_pass(cs_lut_gen).arg(0, 1));
+    }
+
+    auto t_lut = frame.context().make_texture({width, height}, pr::format::rg16f, 1, true);
 
     frame.transition(t_lut, pr::state::unordered_access, phi::shader_stage_flags::compute);
 
@@ -263,3 +461,19 @@ pr::auto_texture inc::pre::texture_processing::create_brdf_lut(pr::raii::Frame&
 
     return t_lut;
 }
+
+pr::auto_texture inc::pre::texture_processing::load_brdf_lut(pr::raii::Frame& frame, const char* cooked_path, int width_height)
+{
+    auto const lut = inc::assets::load_or_compute_brdf_lut(cooked_path, unsigned(width_height), unsigned(width_height));
+    return upload_brdf_lut(frame, lut);
+}
+
+pr::auto_texture inc::pre::texture_processing::upload_brdf_lut(pr::raii::Frame& frame, const inc::assets::brdf_lut_data& lut)
+{
+    auto _label = frame.scoped_debug_label("texture_processing - upload BRDF LUT");
+
+    auto t_lut = frame.context().make_texture({int(lut.width), int(lut.height)}, pr::format::rg16f, 1, false);
+    frame.auto_upload_texture_data(cc::span{reinterpret_cast<std::byte const*>(lut.texels.data()), lut.texels.size() * sizeof(uint16_t)}, t_lut);
+
+    return t_lut;
+}
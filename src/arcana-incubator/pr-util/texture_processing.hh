@@ -1,5 +1,9 @@
 #pragma once
 
+#include <cstddef>
+
+#include <clean-core/vector.hh>
+
 #include <phantasm-renderer/enums.hh>
 #include <phantasm-renderer/fwd.hh>
 #include <phantasm-renderer/resource_types.hh>
@@ -8,6 +12,7 @@ namespace inc::assets
 {
 struct image_size;
 struct image_data;
+struct brdf_lut_data;
 }
 
 namespace inc::pre
@@ -19,6 +24,31 @@ struct filtered_specular_result
     pr::auto_texture filtered_env;   // the filtered specular cubemap, likely what is desired
 };
 
+/// limits for textures loaded from memory or file, exceeding textures are downscaled on load
+/// loaded textures are resident until texture_processing::release_texture
+struct texture_budget
+{
+    unsigned max_dimension = 0;    // max width and height, 0: no limit
+    size_t max_resident_bytes = 0; // max combined size of all resident textures (including mips), 0: no limit
+};
+
+struct texture_load_stats
+{
+    size_t num_loaded = 0;
+    size_t num_downscaled = 0;
+    size_t bytes_loaded = 0;   // combined size of all textures ever loaded (including mips)
+    size_t bytes_resident = 0; // combined size of loaded textures not yet released
+    size_t bytes_saved = 0;    // by downscaling
+};
+
+/// commands recorded by generate_mips, each barrier command is one pipeline barrier (vkCmdPipelineBarrier / ResourceBarrier)
+struct mipgen_stats
+{
+    unsigned num_dispatches = 0;
+    unsigned num_barrier_commands = 0;
+    unsigned num_slice_transitions = 0;
+};
+
 struct texture_processing
 {
     void init(pr::Context& ctx, char const* path_prefix, char const* file_ending_override = nullptr);
@@ -32,8 +62,26 @@ struct texture_processing
 
     [[nodiscard]] pr::auto_texture load_texture(pr::raii::Frame& frame, assets::image_data const& data, assets::image_size const& size, pr::format fmt, bool mips, bool gamma);
 
+    /// applies to load_texture_from_memory and load_texture_from_file
+    void set_budget(texture_budget const& new_budget) { budget = new_budget; }
+    texture_load_stats const& get_load_stats() const { return load_stats; }
+
+    /// returns the memory of a texture from load_texture_from_memory or load_texture_from_file to the budget
+    /// call before freeing it, other textures are ignored
+    void release_texture(pr::texture const& texture);
+
+    /// generates all mips of the texture from mip 0
+    /// if the mipgen_spd shader is present, up to 12 mips are generated in a single dispatch (any size)
+    /// otherwise, one dispatch per mip is recorded (square power of two sizes only)
     void generate_mips(pr::raii::Frame& frame, pr::texture const& texture, bool apply_gamma = false);
 
+    /// if disabled, the per-level path is used even if the mipgen_spd shader is present (ie. for comparisons)
+    void set_single_pass_mipgen_enabled(bool enabled) { enable_single_pass_mipgen = enabled; }
+
+    /// accumulated across generate_mips calls
+    mipgen_stats const& get_mipgen_stats() const { return mip_stats; }
+    void reset_mipgen_stats() { mip_stats = {}; }
+
     //
     // IBL
 
@@ -44,17 +92,54 @@ struct texture_processing
 
     [[nodiscard]] pr::auto_texture create_diffuse_irradiance_map(pr::raii::Frame& frame, pr::texture const& unfiltered_env_cube, int cube_width_height = 32);
 
+    /// computes the BRDF LUT on the GPU (rg16f, like the cooked LUT), the brdf_lut_gen shader is only loaded on first use
     [[nodiscard]] pr::auto_texture create_brdf_lut(pr::raii::Frame& frame, int width, int height);
 
+    /// uploads the BRDF LUT from a cooked file (rg16f), computing it on the CPU and writing the file if missing
+    /// no shader is involved, see assets::load_or_compute_brdf_lut
+    [[nodiscard]] pr::auto_texture load_brdf_lut(pr::raii::Frame& frame, char const* cooked_path, int width_height = 256);
+
+    [[nodiscard]] pr::auto_texture upload_brdf_lut(pr::raii::Frame& frame, assets::brdf_lut_data const& lut);
+
+private:
+    // downscales the image if it exceeds the budget, replacing (and freeing) it, returns the size of the resulting texture
+    // without a budget the image is left as is, a downscaled image is also rounded down to a power of two if the per-level mip path runs
+    // the per-level mip path only supports square power of two textures, others with mips require the single pass downsampler
+    size_t apply_budget(assets::image_data& inout_data, assets::image_size& inout_size, pr::format fmt, bool mips, bool gamma);
+
+    void add_resident_texture(pr::texture const& texture, size_t size_bytes);
+
+    // returns false if the texture can't be handled by the single pass downsampler
+    bool generate_mips_single_pass(pr::raii::Frame& frame, pr::texture const& texture, bool apply_gamma);
+
 private:
     pr::auto_compute_pipeline_state pso_mipgen;
     pr::auto_compute_pipeline_state pso_mipgen_gamma;
     pr::auto_compute_pipeline_state pso_mipgen_array;
 
+    pr::auto_compute_pipeline_state pso_mipgen_spd; // optional
+    pr::auto_buffer buf_spd_counters;               // one atomic counter per array slice
+    bool enable_single_pass_mipgen = true;
+    mipgen_stats mip_stats;
+
+    texture_budget budget;
+    texture_load_stats load_stats;
+
+    struct resident_texture
+    {
+        phi::handle::resource handle;
+        size_t size_bytes;
+    };
+
+    cc::vector<resident_texture> resident_textures;
+
     pr::auto_compute_pipeline_state pso_equirect_to_cube;
     pr::auto_compute_pipeline_state pso_specular_map_filter;
     pr::auto_compute_pipeline_state pso_irradiance_map_gen;
-    pr::auto_compute_pipeline_state pso_brdf_lut_gen;
+    pr::auto_compute_pipeline_state pso_brdf_lut_gen; // lazy
+
+    char shader_path_prefix[256] = {};
+    char shader_file_ending[16] = {}; // empty: default
 };
 
 }
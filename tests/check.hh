@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdio>
+
+// minimal checks for the headless tests, a failed check is reported and counted, the test continues
+// CHECK expects a char const* test_name in scope
+namespace inc::test
+{
+inline int g_num_failures = 0;
+
+inline void check(bool condition, char const* test, char const* expr, int line)
+{
+    if (condition)
+        return;
+
+    std::fprintf(stderr, "%s: check failed (line %d): %s\n", test, line, expr);
+    ++g_num_failures;
+}
+
+// reports the result, returned from main
+inline int finish(char const* suite_name)
+{
+    if (g_num_failures > 0)
+    {
+        std::fprintf(stderr, "%d %s checks failed\n", g_num_failures, suite_name);
+        return 1;
+    }
+
+    std::printf("all %s checks passed\n", suite_name);
+    return 0;
+}
+}
+
+#define CHECK(_expr_) inc::test::check((_expr_), test_name, #_expr_, __LINE__)
@@ -0,0 +1,87 @@
+#include <cstdint>
+
+#include <clean-core/allocator.hh>
+
+#include <arcana-incubator/pr-util/framegraph/pass_arena.hh>
+
+#include "check.hh"
+
+// pass_arena over several recorded frames: no backing allocations once the largest frame was recorded,
+// alignment of regular and overaligned objects, destructors in bulk on reset and on destruction
+namespace
+{
+constexpr unsigned gc_num_frames = 4;
+constexpr unsigned gc_objects_per_frame = 64;
+constexpr size_t gc_chunk_size = 1024;
+
+int g_num_destroyed = 0;
+
+struct alignas(64) cacheline_data
+{
+    float values[16];
+};
+
+struct alignas(256) overaligned_data
+{
+    char bytes[300];
+};
+
+struct counted
+{
+    int value;
+    ~counted() { ++g_num_destroyed; }
+};
+
+bool is_aligned(void const* ptr, size_t alignment) { return reinterpret_cast<uintptr_t>(ptr) % alignment == 0; }
+
+void test_steady_state()
+{
+    char const* const test_name = "steady state";
+
+    g_num_destroyed = 0;
+    {
+        inc::frag::pass_arena arena;
+        arena.initialize(cc::system_allocator, gc_chunk_size);
+
+        for (auto f = 0u; f < gc_num_frames; ++f)
+        {
+            bool all_aligned = true;
+            for (auto i = 0u; i < gc_objects_per_frame; ++i)
+            {
+                auto* const small = arena.emplace<char>('x');
+                auto* const cacheline = arena.emplace<cacheline_data>();
+                auto* const overaligned = arena.emplace<overaligned_data>();
+                auto* const with_dtor = arena.emplace<counted>(int(i));
+
+                // written to the end, overruns are caught by the sanitizers
+                cacheline->values[15] = 1.f;
+                overaligned->bytes[299] = 1;
+
+                all_aligned = all_aligned && is_aligned(cacheline, alignof(cacheline_data)) && is_aligned(overaligned, alignof(overaligned_data))
+                              && is_aligned(with_dtor, alignof(counted)) && *small == 'x';
+            }
+            CHECK(all_aligned);
+
+            auto const& stats = arena.get_stats();
+            CHECK(stats.num_allocations == gc_objects_per_frame * 4);
+            CHECK(stats.bytes_used <= stats.bytes_reserved);
+            if (f > 0)
+                CHECK(stats.num_backing_allocations == 0);
+
+            arena.reset();
+            CHECK(g_num_destroyed == int((f + 1) * gc_objects_per_frame));
+        }
+
+        // destroyed with the arena
+        arena.emplace<counted>(0);
+    }
+    CHECK(g_num_destroyed == int(gc_num_frames * gc_objects_per_frame + 1));
+}
+}
+
+int main()
+{
+    test_steady_state();
+
+    return inc::test::finish("pass arena");
+}
@@ -0,0 +1,215 @@
+#include <cstdint>
+#include <initializer_list>
+
+#include <clean-core/allocator.hh>
+#include <clean-core/span.hh>
+#include <clean-core/vector.hh>
+
+#include <arcana-incubator/pr-util/framegraph/pass_reorder.hh>
+
+#include "check.hh"
+
+// run_pass_reorder on small graphs with known orders and stats, and on random graphs
+// where every dependency must be respected and repeated runs must give the same order
+// reorder_access entries are (pass, resource, is_write, required_state), in registration order
+namespace
+{
+using inc::frag::pass_idx;
+using inc::frag::reorder_access;
+using inc::frag::reorder_stats;
+using Q = phi::queue_type;
+using S = phi::resource_state;
+
+constexpr unsigned gc_num_random_graphs = 200;
+constexpr unsigned gc_max_random_passes = 40;
+
+struct lcg
+{
+    uint32_t state;
+    uint32_t next(uint32_t bound)
+    {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 8) % bound;
+    }
+};
+
+cc::vector<pass_idx> run_reorder(cc::span<Q const> queues, cc::span<bool const> culled, cc::span<reorder_access const> accesses, size_t num_resources, reorder_stats& out_stats)
+{
+    cc::vector<pass_idx> order;
+    order.resize(queues.size());
+    inc::frag::run_pass_reorder(order, out_stats, queues, culled, accesses, num_resources);
+    return order;
+}
+
+bool is_order(cc::vector<pass_idx> const& order, std::initializer_list<pass_idx> expected)
+{
+    if (order.size() != expected.size())
+        return false;
+
+    auto i = 0u;
+    for (pass_idx const pass : expected)
+    {
+        if (order[i++] != pass)
+            return false;
+    }
+    return true;
+}
+
+// p0 writes r0 as copy_dest, p1 to p4 only read it, alternating between copy_src and shader_resource
+// grouping the reads by state saves two transitions
+void test_transitions()
+{
+    char const* const test_name = "transitions";
+
+    Q const queues[] = {Q::direct, Q::direct, Q::direct, Q::direct, Q::direct};
+    bool const culled[5] = {};
+    reorder_access const accesses[] = {
+        {0, 0, true, S::copy_dest},        //
+        {1, 0, false, S::copy_src},        //
+        {2, 0, false, S::shader_resource}, //
+        {3, 0, false, S::copy_src},        //
+        {4, 0, false, S::shader_resource}, //
+    };
+
+    reorder_stats stats;
+    auto const order = run_reorder(queues, culled, accesses, 1, stats);
+
+    CHECK(is_order(order, {0, 1, 3, 2, 4}));
+    CHECK(stats.num_transitions_before == 5);
+    CHECK(stats.num_transitions_after == 3);
+    CHECK(stats.num_moved == 2);
+}
+
+// two independent direct -> compute chains, without states
+// the passes of the same queue are clustered, a write after read keeps p4 after the reads of r0
+void test_queue_clustering()
+{
+    char const* const test_name = "queue clustering";
+
+    Q const queues[] = {Q::direct, Q::compute, Q::direct, Q::compute, Q::direct};
+    bool const culled[5] = {};
+    reorder_access const accesses[] = {
+        {0, 0, true, S::undefined},  //
+        {1, 1, true, S::undefined},  //
+        {2, 0, false, S::undefined}, //
+        {3, 1, false, S::undefined}, //
+        {3, 0, false, S::undefined}, //
+        {4, 0, true, S::undefined},  //
+    };
+
+    reorder_stats stats;
+    auto const order = run_reorder(queues, culled, accesses, 2, stats);
+
+    CHECK(is_order(order, {0, 2, 1, 3, 4}));
+    CHECK(stats.num_queue_switches_before == 4);
+    CHECK(stats.num_queue_switches_after == 2);
+}
+
+// culled passes keep their relative order at the end and create no dependencies
+void test_culled()
+{
+    char const* const test_name = "culled";
+
+    Q const queues[] = {Q::direct, Q::direct, Q::direct, Q::direct};
+    bool const culled[] = {false, true, false, true};
+    reorder_access const accesses[] = {
+        {0, 0, true, S::render_target},   //
+        {1, 0, false, S::shader_resource}, //
+        {2, 0, true, S::render_target},   //
+        {3, 0, false, S::shader_resource}, //
+    };
+
+    reorder_stats stats;
+    auto const order = run_reorder(queues, culled, accesses, 1, stats);
+
+    CHECK(is_order(order, {0, 2, 1, 3}));
+    CHECK(stats.num_transitions_before == 1);
+    CHECK(stats.num_transitions_after == 1);
+}
+
+// every pair of accesses to the same resource with at least one write keeps its order
+void test_random_graphs()
+{
+    char const* const test_name = "random graphs";
+
+    Q const queue_types[] = {Q::direct, Q::compute, Q::copy};
+    S const states[] = {S::undefined, S::shader_resource, S::copy_src, S::render_target, S::unordered_access, S::copy_dest};
+
+    lcg rng{1};
+    for (auto g = 0u; g < gc_num_random_graphs; ++g)
+    {
+        unsigned const num_passes = 2 + rng.next(gc_max_random_passes - 1);
+        unsigned const num_resources = 1 + rng.next(num_passes);
+
+        Q queues[gc_max_random_passes];
+        bool culled[gc_max_random_passes];
+        cc::vector<reorder_access> accesses;
+        for (pass_idx p = 0; p < num_passes; ++p)
+        {
+            queues[p] = queue_types[rng.next(3)];
+            culled[p] = rng.next(8) == 0;
+
+            unsigned const num_accesses = 1 + rng.next(4);
+            for (auto a = 0u; a < num_accesses; ++a)
+                accesses.push_back({p, rng.next(num_resources), rng.next(3) == 0, states[rng.next(6)]});
+        }
+
+        reorder_stats stats;
+        auto const order = run_reorder({queues, num_passes}, {culled, num_passes}, accesses, num_resources, stats);
+
+        reorder_stats repeated_stats;
+        auto const repeated_order = run_reorder({queues, num_passes}, {culled, num_passes}, accesses, num_resources, repeated_stats);
+
+        bool is_deterministic = stats.num_transitions_after == repeated_stats.num_transitions_after;
+        for (auto i = 0u; i < num_passes; ++i)
+            is_deterministic = is_deterministic && order[i] == repeated_order[i];
+        CHECK(is_deterministic);
+
+        cc::vector<unsigned> positions;
+        positions.resize(num_passes, unsigned(-1));
+        for (auto i = 0u; i < num_passes; ++i)
+            positions[order[i]] = i;
+
+        bool is_permutation = true;
+        for (auto const pos : positions)
+            is_permutation = is_permutation && pos != unsigned(-1);
+        CHECK(is_permutation);
+        if (!is_permutation)
+            return;
+
+        bool respects_dependencies = true;
+        for (auto i = 0u; i < accesses.size(); ++i)
+        {
+            for (auto j = i + 1; j < accesses.size(); ++j)
+            {
+                auto const& a = accesses[i];
+                auto const& b = accesses[j];
+                if (a.pass == b.pass || a.resource != b.resource || culled[a.pass] || culled[b.pass] || !(a.is_write || b.is_write))
+                    continue;
+
+                respects_dependencies = respects_dependencies && positions[a.pass] < positions[b.pass];
+            }
+        }
+        CHECK(respects_dependencies);
+
+        bool culled_last = true;
+        bool seen_culled = false;
+        for (auto i = 0u; i < num_passes; ++i)
+        {
+            seen_culled = seen_culled || culled[order[i]];
+            culled_last = culled_last && (!seen_culled || culled[order[i]]);
+        }
+        CHECK(culled_last);
+    }
+}
+}
+
+int main()
+{
+    test_transitions();
+    test_queue_clustering();
+    test_culled();
+    test_random_graphs();
+
+    return inc::test::finish("pass reorder");
+}
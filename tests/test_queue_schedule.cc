@@ -0,0 +1,145 @@
+#include <cstdint>
+
+#include <clean-core/allocator.hh>
+#include <clean-core/assert.hh>
+#include <clean-core/span.hh>
+
+#include <arcana-incubator/pr-util/framegraph/queue_schedule.hh>
+
+#include "check.hh"
+
+// run_queue_schedule on small graphs with known results: batches, wait serials, signals and the amount of waits
+// the results are checked on a copy made with queue_schedule::assign, as restored by a reused compile
+// schedule_access entries are (pass, physical, is_write), in pass order
+namespace
+{
+using inc::frag::queue_schedule;
+using inc::frag::schedule_access;
+using Q = phi::queue_type;
+
+constexpr uint64_t D = 0; // index into queue_batch::wait_serials
+constexpr uint64_t C = 1;
+constexpr uint64_t X = 2; // copy
+
+struct expected_batch
+{
+    Q queue;
+    uint64_t serial;
+    bool needs_signal;
+    uint64_t wait_serials[inc::frag::gc_num_queue_types];
+};
+
+void run_case(char const* test_name,
+              cc::span<Q const> queues,
+              cc::span<schedule_access const> accesses,
+              size_t num_physicals,
+              cc::span<expected_batch const> expected,
+              unsigned expected_num_waits)
+{
+    bool culled[16] = {};
+    CC_ASSERT(queues.size() <= 16 && "too many passes");
+
+    queue_schedule schedule;
+    schedule.reset_reserve(cc::system_allocator, queues.size());
+    inc::frag::run_queue_schedule(schedule, queues, cc::span<bool const>(culled, queues.size()), accesses, num_physicals);
+
+    queue_schedule computed;
+    computed.reset_reserve(cc::system_allocator, queues.size());
+    computed.assign(schedule);
+    schedule.clear();
+    schedule.assign(computed);
+
+    CHECK(schedule.batches.size() == expected.size());
+    if (schedule.batches.size() != expected.size())
+        return;
+
+    for (auto i = 0u; i < expected.size(); ++i)
+    {
+        auto const& batch = schedule.batches[i];
+        auto const& exp = expected[i];
+
+        CHECK(batch.queue == exp.queue);
+        CHECK(batch.serial == exp.serial);
+        CHECK(batch.needs_signal == exp.needs_signal);
+        CHECK(batch.wait_serials[D] == exp.wait_serials[D]);
+        CHECK(batch.wait_serials[C] == exp.wait_serials[C]);
+        CHECK(batch.wait_serials[X] == exp.wait_serials[X]);
+    }
+
+    CHECK(schedule.num_waits == expected_num_waits);
+}
+
+// direct writes r0, compute reads r0 and writes r1, direct reads r1
+void test_chain()
+{
+    Q const queues[] = {Q::direct, Q::compute, Q::direct};
+    schedule_access const accesses[] = {{0, 0, true}, {1, 0, false}, {1, 1, true}, {2, 1, false}};
+
+    expected_batch const expected[] = {
+        {Q::direct, 1, true, {0, 0, 0}},  //
+        {Q::compute, 1, true, {1, 0, 0}}, //
+        {Q::direct, 2, false, {0, 1, 0}}, //
+    };
+
+    run_case("chain", queues, accesses, 2, expected, 2);
+}
+
+// direct writes r0, compute and copy both read r0 and write r1 and r2, direct reads r1 and r2
+void test_diamond()
+{
+    Q const queues[] = {Q::direct, Q::compute, Q::copy, Q::direct};
+    schedule_access const accesses[] = {{0, 0, true}, {1, 0, false}, {1, 1, true}, {2, 0, false}, {2, 2, true}, {3, 1, false}, {3, 2, false}};
+
+    expected_batch const expected[] = {
+        {Q::direct, 1, true, {0, 0, 0}},  //
+        {Q::compute, 1, true, {1, 0, 0}}, //
+        {Q::copy, 1, true, {1, 0, 0}},    //
+        {Q::direct, 2, false, {0, 1, 1}}, //
+    };
+
+    run_case("diamond", queues, accesses, 3, expected, 4);
+}
+
+// direct writes r0, compute reads r0 and writes r1, copy reads r1 and r0
+// the copy batch depends on direct 1 and compute 1, compute 1 already waited for direct 1
+void test_implied_wait()
+{
+    Q const queues[] = {Q::direct, Q::compute, Q::copy};
+    schedule_access const accesses[] = {{0, 0, true}, {1, 0, false}, {1, 1, true}, {2, 0, false}, {2, 1, false}};
+
+    expected_batch const expected[] = {
+        {Q::direct, 1, true, {0, 0, 0}},  //
+        {Q::compute, 1, true, {1, 0, 0}}, //
+        {Q::copy, 1, false, {0, 1, 0}},   //
+    };
+
+    run_case("implied wait", queues, accesses, 2, expected, 2);
+}
+
+// direct writes r0, compute reads it, direct writes r1, compute reads r0 again
+// the second compute batch is ordered after the first one, which waited for direct 1
+void test_queue_order()
+{
+    Q const queues[] = {Q::direct, Q::compute, Q::direct, Q::compute};
+    schedule_access const accesses[] = {{0, 0, true}, {1, 0, false}, {2, 1, true}, {3, 0, false}};
+
+    expected_batch const expected[] = {
+        {Q::direct, 1, true, {0, 0, 0}},   //
+        {Q::compute, 1, false, {1, 0, 0}}, //
+        {Q::direct, 2, false, {0, 0, 0}},  //
+        {Q::compute, 2, false, {0, 0, 0}}, //
+    };
+
+    run_case("queue order", queues, accesses, 2, expected, 1);
+}
+}
+
+int main()
+{
+    test_chain();
+    test_diamond();
+    test_implied_wait();
+    test_queue_order();
+
+    return inc::test::finish("queue schedule");
+}
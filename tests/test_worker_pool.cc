@@ -0,0 +1,129 @@
+#include <atomic>
+#include <thread>
+
+#include <arcana-incubator/pr-util/framegraph/worker_pool.hh>
+
+#include "check.hh"
+
+// worker_pool over many runs: every job runs exactly once, workers are started on demand and then reused,
+// destroy joins them and the pool can be used again
+namespace
+{
+constexpr unsigned gc_num_runs = 200;
+constexpr unsigned gc_max_jobs = 16;
+
+struct job_record
+{
+    std::atomic<unsigned> num_calls[gc_max_jobs];
+    std::thread::id thread_ids[gc_max_jobs];
+
+    void clear()
+    {
+        for (auto& n : num_calls)
+            n = 0;
+    }
+};
+
+// true if each of the first num_jobs jobs ran once and the others not at all
+bool ran_once(job_record const& record, unsigned num_jobs)
+{
+    for (auto i = 0u; i < gc_max_jobs; ++i)
+    {
+        if (record.num_calls[i] != (i < num_jobs ? 1u : 0u))
+            return false;
+    }
+    return true;
+}
+
+void test_runs()
+{
+    char const* const test_name = "runs";
+
+    inc::frag::worker_pool pool;
+    job_record record;
+
+    // nothing to do, no workers
+    pool.run(0, [&](unsigned) { CHECK(false); });
+    CHECK(pool.get_num_workers() == 0);
+
+    // a single job runs on the calling thread
+    record.clear();
+    pool.run(1, [&](unsigned i) {
+        ++record.num_calls[i];
+        record.thread_ids[i] = std::this_thread::get_id();
+    });
+    CHECK(ran_once(record, 1));
+    CHECK(record.thread_ids[0] == std::this_thread::get_id());
+    CHECK(pool.get_num_workers() == 0);
+
+    // varying amounts of jobs, the workers only grow to the largest run
+    bool all_ran_once = true;
+    bool no_new_threads = true;
+    for (auto r = 0u; r < gc_num_runs; ++r)
+    {
+        unsigned const num_jobs = 1 + (r * 7) % gc_max_jobs;
+        unsigned const num_workers_before = pool.get_num_workers();
+
+        record.clear();
+        pool.run(num_jobs, [&](unsigned i) { ++record.num_calls[i]; });
+
+        all_ran_once = all_ran_once && ran_once(record, num_jobs);
+        no_new_threads = no_new_threads && pool.get_num_workers() == (num_jobs - 1 > num_workers_before ? num_jobs - 1 : num_workers_before);
+    }
+    CHECK(all_ran_once);
+    CHECK(no_new_threads);
+    CHECK(pool.get_num_workers() == gc_max_jobs - 1);
+
+    // joined, then started again on the next run
+    pool.destroy();
+    CHECK(pool.get_num_workers() == 0);
+    pool.destroy();
+
+    record.clear();
+    pool.run(4, [&](unsigned i) { ++record.num_calls[i]; });
+    CHECK(ran_once(record, 4));
+    CHECK(pool.get_num_workers() == 3);
+}
+
+// jobs that block until all of them started, only completes if the workers run them concurrently
+void test_concurrency()
+{
+    char const* const test_name = "concurrency";
+
+    constexpr unsigned num_jobs = 4;
+
+    inc::frag::worker_pool pool;
+    std::atomic<unsigned> num_started = {0};
+    bool all_met = true;
+
+    for (auto r = 0u; r < 10; ++r)
+    {
+        num_started = 0;
+        std::atomic<bool> met = {true};
+        pool.run(num_jobs, [&](unsigned) {
+            ++num_started;
+
+            unsigned spins = 0;
+            while (num_started < num_jobs)
+            {
+                if (++spins > 100000000)
+                {
+                    met = false;
+                    return;
+                }
+                std::this_thread::yield();
+            }
+        });
+        all_met = all_met && met;
+    }
+    CHECK(all_met);
+}
+}
+
+int main()
+{
+    test_runs();
+    test_concurrency();
+
+    return inc::test::finish("worker pool");
+}